@@ -13,6 +13,34 @@ fn main() {
     println!("cargo:rerun-if-changed=src/cpp/MDKPlayer.h");
     println!("cargo:rerun-if-changed=src/cpp/VideoTextureNode.cpp");
     println!("cargo:rerun-if-changed=src/cpp/VideoTextureNode.h");
+    println!("cargo:rerun-if-changed=src/cpp/FrameConverter.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/FrameConverter.h");
+    println!("cargo:rerun-if-changed=src/cpp/FrameQueue.h");
+    println!("cargo:rerun-if-changed=src/cpp/PlaybackState.h");
+    println!("cargo:rerun-if-changed=src/cpp/ProcessingSession.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/ProcessingSession.h");
+    println!("cargo:rerun-if-changed=src/cpp/MediaCache.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/MediaCache.h");
+    println!("cargo:rerun-if-changed=src/cpp/ThumbnailGenerator.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/ThumbnailGenerator.h");
+    println!("cargo:rerun-if-changed=src/cpp/FrameCache.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/FrameCache.h");
+    println!("cargo:rerun-if-changed=src/cpp/FrameIndex.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/FrameIndex.h");
+    println!("cargo:rerun-if-changed=src/cpp/MediaProbe.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/MediaProbe.h");
+    println!("cargo:rerun-if-changed=src/cpp/PlayerPool.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/PlayerPool.h");
+    println!("cargo:rerun-if-changed=src/cpp/SharedSource.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/SharedSource.h");
+    println!("cargo:rerun-if-changed=src/cpp/DecodeScheduler.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/DecodeScheduler.h");
+    println!("cargo:rerun-if-changed=src/cpp/PlayerStats.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/PlayerStats.h");
+    println!("cargo:rerun-if-changed=src/cpp/ReversePlayback.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/ReversePlayback.h");
+    println!("cargo:rerun-if-changed=src/cpp/HeadlessRenderer.cpp");
+    println!("cargo:rerun-if-changed=src/cpp/HeadlessRenderer.h");
 
     let mut config = cpp_build::Config::new();
 
@@ -44,6 +44,7 @@ ApplicationWindow {
             id: slider;
             width: parent.width;
             property bool preventChange: false;
+            onPressedChanged: vid.setScrubbing(pressed);
             onValueChanged: {
                 if (!preventChange) {
                     vid.timestamp = value;
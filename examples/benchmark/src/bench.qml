@@ -0,0 +1,162 @@
+import QtQuick
+import MDKVideo
+
+// Driven by `bench` from main.rs: opens each clip, plays it for `bench.playSeconds`, then measures exact seeks
+// by frame and by timestamp, and reports one JSON object per clip
+Window {
+    id: window;
+    width: 1280;
+    height: 720;
+    visible: true;
+
+    property var clips: JSON.parse(bench.clipsJson);
+    property int clipIndex: -1;
+    property string phase: "";
+    property var result: ({});
+
+    property double phaseStart: 0;
+    property double updatesAtStart: 0;
+    property var targets: [];
+    property int targetIndex: 0;
+    property double target: 0;
+    property var latencies: [];
+    property int timeouts: 0;
+    property bool waiting: false;
+    property int seed: 1;
+
+    MDKVideo {
+        id: vid;
+        anchors.fill: parent;
+        backgroundColor: "black";
+
+        onMetadataChanged: {
+            if (window.phase === "load" && vid.frameCount > 0) {
+                window.result.openMs = bench.now() - window.phaseStart;
+                window.result.frameCount = vid.frameCount;
+                window.result.frameRate = vid.frameRate;
+                window.result.width = vid.videoWidth;
+                window.result.height = vid.videoHeight;
+                timeout.stop();
+                settle.next = window.startPlayback;
+                settle.start();
+            }
+        }
+        onCurrentFrameChanged: {
+            if (window.phase === "seekToFrame" && vid.currentFrame === window.target) {
+                window.seekDone();
+            }
+        }
+        onTimestampChanged: {
+            if (window.phase === "seekToTimestamp" && Math.abs(vid.timestamp - window.target) <= 1500.0 / Math.max(1, vid.frameRate)) {
+                window.seekDone();
+            }
+        }
+    }
+
+    // Lets the player settle between phases
+    Timer { id: settle; interval: 300; property var next: null; onTriggered: next(); }
+    Timer { id: playTimer; interval: bench.playSeconds * 1000; onTriggered: window.stopPlayback(); }
+    Timer { id: timeout; interval: 5000; onTriggered: window.phaseTimedOut(); }
+
+    // Same targets on every run
+    function random() {
+        seed = (seed * 48271) % 2147483647;
+        return seed / 2147483647;
+    }
+
+    function percentiles(values) {
+        const sorted = values.slice().sort((a, b) => a - b);
+        const at = (p) => sorted.length ? sorted[Math.min(sorted.length - 1, Math.ceil(sorted.length * p) - 1)] : 0;
+        return { count: sorted.length, p50Ms: at(0.5), p95Ms: at(0.95), p99Ms: at(0.99), maxMs: sorted.length ? sorted[sorted.length - 1] : 0, timeouts: timeouts };
+    }
+
+    function nextClip() {
+        if (++clipIndex >= clips.length) {
+            Qt.quit();
+            return;
+        }
+        result = {};
+        seed = 1;
+        phase = "load";
+        phaseStart = bench.now();
+        timeout.start();
+        vid.setUrl(clips[clipIndex], "");
+    }
+
+    function startPlayback() {
+        phase = "play";
+        // The item's notifications are coalesced, the player's own position updates count every rendered frame
+        updatesAtStart = vid.getPlaybackState().updates;
+        phaseStart = bench.now();
+        vid.play();
+        playTimer.start();
+    }
+    function stopPlayback() {
+        const elapsed = (bench.now() - phaseStart) / 1000.0;
+        const frames = vid.getPlaybackState().updates - updatesAtStart;
+        vid.pause();
+        result.playbackFps = elapsed > 0 ? frames / elapsed : 0;
+        result.pipeline = vid.getPipelineStats();
+        settle.next = () => startSeeks("seekToFrame");
+        settle.start();
+    }
+
+    function startSeeks(kind) {
+        phase = "";
+        targets = [];
+        for (let i = 0; i < bench.seekCount; ++i) {
+            if (kind === "seekToFrame") targets.push(Math.floor(random() * Math.max(1, vid.frameCount - 1)));
+            else                        targets.push(random() * vid.duration * 0.95);
+        }
+        targetIndex = -1;
+        latencies = [];
+        timeouts = 0;
+        phase = kind;
+        nextSeek();
+    }
+    function nextSeek() {
+        if (++targetIndex >= targets.length) {
+            result[phase] = percentiles(latencies);
+            if (phase === "seekToFrame") {
+                startSeeks("seekToTimestamp");
+            } else {
+                phase = "";
+                bench.report(clipIndex, JSON.stringify(result));
+                nextClip();
+            }
+            return;
+        }
+        target = targets[targetIndex];
+        if ((phase === "seekToFrame" && target === vid.currentFrame) || (phase === "seekToTimestamp" && Math.abs(target - vid.timestamp) < 1)) {
+            nextSeek(); // Wouldn't render anything
+            return;
+        }
+        waiting = true;
+        phaseStart = bench.now();
+        timeout.restart();
+        if (phase === "seekToFrame") vid.seekToFrame(target, true);
+        else                         vid.seekToTimestamp(target, true);
+    }
+    function seekDone() {
+        if (!waiting) return;
+        waiting = false;
+        timeout.stop();
+        latencies.push(bench.now() - phaseStart);
+        // Continue outside of the signal handler
+        Qt.callLater(nextSeek);
+    }
+    function phaseTimedOut() {
+        if (phase === "load") {
+            result.error = "timeout while opening";
+            phase = "";
+            bench.report(clipIndex, JSON.stringify(result));
+            nextClip();
+        } else if (phase === "seekToFrame" || phase === "seekToTimestamp") {
+            waiting = false;
+            timeouts++;
+            nextSeek();
+        }
+    }
+
+    Component.onCompleted: nextClip();
+}
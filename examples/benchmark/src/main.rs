@@ -0,0 +1,249 @@
+#![allow(non_snake_case)]
+
+use qmetaobject::*;
+use qml_video_rs::video_player::{ MDKPlayerWrapper, ProcessingOptions };
+use std::path::{ Path, PathBuf };
+use std::process::Command;
+use std::sync::mpsc;
+use std::time::Instant;
+
+// Usage: benchmark [--out results.json] [--seconds 5] [--seeks 30] [--size 1280x720] [--ffmpeg ffmpeg] [video files...]
+//
+// Without video files, synthetic clips are generated with ffmpeg into the temp directory (several codecs and GOP lengths, CFR and VFR).
+// Every clip is played in an offscreen window to measure the sustained playback fps and the exact seek latency,
+// then decoded through the processing player with each frame conversion path.
+// Results are written as JSON, so runs against different mdk-sdk builds can be compared.
+
+qrc!(bench_resource, "/" { "src/bench.qml" } );
+
+#[derive(Default, QObject)]
+struct Bench {
+    base: qt_base_class!(trait QObject),
+
+    clipsJson:   qt_property!(QString; CONST),
+    playSeconds: qt_property!(f64; CONST),
+    seekCount:   qt_property!(i32; CONST),
+
+    now:    qt_method!(fn(&self) -> f64),
+    report: qt_method!(fn(&mut self, index: i32, json: QString)),
+
+    started: Option<Instant>,
+    results: Vec<Option<String>>,
+}
+impl Bench {
+    fn now(&self) -> f64 {
+        self.started.map(|x| x.elapsed().as_secs_f64() * 1000.0).unwrap_or_default()
+    }
+    fn report(&mut self, index: i32, json: QString) {
+        if let Some(x) = self.results.get_mut(index as usize) {
+            *x = Some(json.to_string());
+        }
+    }
+}
+
+struct Clip {
+    name: String,
+    path: PathBuf,
+}
+
+// name, encoder arguments, variable frame rate
+const SYNTHETIC_CLIPS: &[(&str, &[&str], bool)] = &[
+    ("h264_gop1_cfr",   &["-c:v", "libx264", "-g", "1",   "-pix_fmt", "yuv420p"], false),
+    ("h264_gop12_cfr",  &["-c:v", "libx264", "-g", "12",  "-pix_fmt", "yuv420p"], false),
+    ("h264_gop250_cfr", &["-c:v", "libx264", "-g", "250", "-pix_fmt", "yuv420p"], false),
+    ("h264_gop12_vfr",  &["-c:v", "libx264", "-g", "12",  "-pix_fmt", "yuv420p"], true),
+    ("hevc_gop48_cfr",  &["-c:v", "libx265", "-g", "48",  "-pix_fmt", "yuv420p", "-tag:v", "hvc1"], false),
+    ("mpeg4_gop30_cfr", &["-c:v", "mpeg4",   "-g", "30",  "-q:v", "3"], false),
+];
+
+fn generate_clips(ffmpeg: &str, dir: &Path) -> Vec<Clip> {
+    let _ = std::fs::create_dir_all(dir);
+    let mut clips = Vec::new();
+    for (name, args, vfr) in SYNTHETIC_CLIPS {
+        let path = dir.join(format!("{}.mp4", name));
+        if !path.exists() {
+            let mut cmd = Command::new(ffmpeg);
+            cmd.args(["-y", "-loglevel", "error", "-f", "lavfi", "-i", "testsrc2=size=1920x1080:rate=30:duration=10"]);
+            if *vfr {
+                // Drops every 5th frame and keeps the original timestamps of the rest
+                cmd.args(["-vf", "select=not(eq(mod(n\\,5)\\,3))", "-fps_mode", "passthrough"]);
+            }
+            cmd.args(*args).arg(&path);
+            match cmd.status() {
+                Ok(status) if status.success() => { },
+                Ok(_) | Err(_) => {
+                    eprintln!("Skipping {}: ffmpeg couldn't encode it", name);
+                    let _ = std::fs::remove_file(&path);
+                    continue;
+                }
+            }
+        }
+        clips.push(Clip { name: name.to_string(), path });
+    }
+    clips
+}
+
+fn to_url(path: &Path) -> QUrl {
+    let path = std::fs::canonicalize(path).unwrap_or_else(|_| path.into()).to_string_lossy().replace('\\', "/");
+    let path = path.trim_start_matches("//?/");
+    QUrl::from(QString::from(if path.starts_with('/') { format!("file://{}", path) } else { format!("file:///{}", path) }))
+}
+
+fn json_string(s: &str) -> String {
+    format!("\"{}\"", s.replace('\\', "\\\\").replace('"', "\\\""))
+}
+
+fn run_processing(player: &mut MDKPlayerWrapper, id: usize, width: usize, height: usize, options: ProcessingOptions) -> (u32, f64) {
+    let (tx, rx) = mpsc::channel();
+    let mut frames = 0u32;
+    let started = Instant::now();
+    if options.output_format == 4 {
+        player.start_processing_native(id, "", Vec::new(), options, move |frame, _ts, _ow, _oh, _fps, _duration, _count, _planes| {
+            if frame < 0 {
+                let _ = tx.send((frames, started.elapsed().as_secs_f64()));
+            } else {
+                frames += 1;
+            }
+            true
+        });
+        let result = rx.recv().unwrap_or((0, 0.0));
+        player.stop_processing(id);
+        return result;
+    }
+    player.start_processing_with_options(id, width, height, "", false, Vec::new(), options, move |frame, _ts, _w, _h, _ow, _oh, _fps, _duration, _count, _pixels| {
+        if frame < 0 {
+            let _ = tx.send((frames, started.elapsed().as_secs_f64()));
+        } else {
+            frames += 1;
+        }
+        true
+    });
+    let result = rx.recv().unwrap_or((0, 0.0));
+    player.stop_processing(id);
+    result
+}
+
+// Playback and seeking, through MDKVideo in an offscreen window
+fn run_playback(clips: &[Clip], play_seconds: f64, seek_count: i32) -> Vec<Option<String>> {
+    bench_resource();
+    qml_video_rs::register_qml_types();
+
+    let urls: Vec<String> = clips.iter().map(|x| json_string(&to_url(&x.path).to_string())).collect();
+    let bench = QObjectBox::new(Bench {
+        clipsJson: QString::from(format!("[{}]", urls.join(","))),
+        playSeconds: play_seconds,
+        seekCount: seek_count,
+        started: Some(Instant::now()),
+        results: vec![None; clips.len()],
+        ..Default::default()
+    });
+    let mut engine = QmlEngine::new();
+    engine.set_object_property("bench".into(), bench.pinned());
+    engine.load_file("qrc:/src/bench.qml".into());
+    engine.exec();
+
+    let results = bench.pinned().borrow().results.clone();
+    results
+}
+
+fn main() {
+    let args: Vec<String> = std::env::args().collect();
+    let mut out: Option<String> = None;
+    let mut play_seconds = 5.0;
+    let mut seek_count = 30;
+    let (mut width, mut height) = (1280usize, 720usize);
+    let mut ffmpeg = "ffmpeg".to_string();
+    let mut files = Vec::new();
+
+    let mut it = args.iter().skip(1);
+    while let Some(arg) = it.next() {
+        match arg.as_str() {
+            "--out"     => out = it.next().cloned(),
+            "--seconds" => play_seconds = it.next().and_then(|x| x.parse().ok()).unwrap_or(play_seconds),
+            "--seeks"   => seek_count = it.next().and_then(|x| x.parse().ok()).unwrap_or(seek_count),
+            "--ffmpeg"  => ffmpeg = it.next().cloned().unwrap_or(ffmpeg),
+            "--size"    => {
+                if let Some((w, h)) = it.next().and_then(|x| x.split_once('x')) {
+                    width  = w.parse().unwrap_or(width);
+                    height = h.parse().unwrap_or(height);
+                }
+            },
+            _ => files.push(PathBuf::from(arg)),
+        }
+    }
+
+    // Offscreen window on software OpenGL, so results don't depend on the GPU and it runs on build machines. Can be overridden from the environment
+    for (key, value) in [("QT_QPA_PLATFORM", "offscreen"), ("QSG_RHI_BACKEND", "opengl"), ("QT_OPENGL", "software"), ("LIBGL_ALWAYS_SOFTWARE", "1")] {
+        if std::env::var_os(key).is_none() {
+            std::env::set_var(key, value);
+        }
+    }
+
+    let clips = if files.is_empty() {
+        generate_clips(&ffmpeg, &std::env::temp_dir().join("qml-video-rs-benchmark"))
+    } else {
+        files.into_iter().map(|path| Clip { name: path.file_stem().map(|x| x.to_string_lossy().to_string()).unwrap_or_default(), path }).collect()
+    };
+    if clips.is_empty() {
+        eprintln!("No clips to run, pass video files or make sure ffmpeg is in PATH");
+        std::process::exit(1);
+    }
+
+    let playback = run_playback(&clips, play_seconds, seek_count);
+
+    let cases = [
+        ("mdk_to_rgba",        ProcessingOptions::default()),
+        ("builtin_rgba",       ProcessingOptions { builtin_converter: true, ..Default::default() }),
+        ("builtin_rgba_area",  ProcessingOptions { builtin_converter: true, scale_filter: 1, ..Default::default() }),
+        ("builtin_gray8",      ProcessingOptions { builtin_converter: true, output_format: 3, ..Default::default() }),
+        ("builtin_vs_mdk",     ProcessingOptions { builtin_converter: true, compare_converter: true, ..Default::default() }),
+        ("native_planes",      ProcessingOptions { output_format: 4, ..Default::default() }),
+        ("stride3_lowres",     ProcessingOptions { builtin_converter: true, frame_stride: 3, decoder_scale: true, ..Default::default() }),
+        ("keyframes_only",     ProcessingOptions { builtin_converter: true, keyframes_only: true, ..Default::default() }),
+    ];
+
+    let mut entries = Vec::new();
+    for (i, clip) in clips.iter().enumerate() {
+        let mut player = MDKPlayerWrapper::default();
+        player.set_url(to_url(&clip.path), QString::default());
+
+        let mut processing = Vec::new();
+        for (j, (name, options)) in cases.iter().enumerate() {
+            let (frames, secs) = run_processing(&mut player, j + 1, width, height, *options);
+            let fps = if secs > 0.0 { frames as f64 / secs } else { 0.0 };
+            eprintln!("{:<18} {:<18} {:>6} frames in {:>7.2} s, {:>8.1} fps", clip.name, name, frames, secs, fps);
+            // Both converters timed on the same decoded frames, with the largest difference between their outputs
+            let comparison = match player.get_processing_converter_stats(j + 1) {
+                Some(s) if s.frames > 0 => {
+                    eprintln!("{:<18} {:<18} builtin {:>7.3} ms, mdk {:>7.3} ms per frame, max diff {}, mean diff {:.3}", clip.name, name,
+                        s.builtin_ms / s.frames as f64, s.mdk_ms / s.frames as f64, s.max_diff, s.mean_diff);
+                    format!(",\"builtinMsPerFrame\":{:.4},\"mdkMsPerFrame\":{:.4},\"maxDiff\":{},\"meanDiff\":{:.4}",
+                        s.builtin_ms / s.frames as f64, s.mdk_ms / s.frames as f64, s.max_diff, s.mean_diff)
+                },
+                _ => String::new(),
+            };
+            processing.push(format!("{}:{{\"frames\":{},\"seconds\":{:.4},\"fps\":{:.2}{}}}", json_string(name), frames, secs, fps, comparison));
+        }
+
+        entries.push(format!("{{\"name\":{},\"file\":{},\"playback\":{},\"processing\":{{{}}}}}",
+            json_string(&clip.name),
+            json_string(&clip.path.to_string_lossy()),
+            playback[i].clone().unwrap_or_else(|| "null".into()),
+            processing.join(",")
+        ));
+    }
+
+    let pool = MDKPlayerWrapper::get_player_pool_stats();
+    let json = format!("{{\"processingSize\":[{},{}],\"playSeconds\":{},\"seeks\":{},\"peakResidentBytes\":{},\"clips\":[{}]}}\n",
+        width, height, play_seconds, seek_count, pool.peak_resident_bytes, entries.join(","));
+
+    match out {
+        Some(path) => {
+            if let Err(e) = std::fs::write(&path, json) {
+                eprintln!("Failed to write {}: {}", path, e);
+                std::process::exit(1);
+            }
+        },
+        None => print!("{}", json),
+    }
+}
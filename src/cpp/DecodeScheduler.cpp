@@ -0,0 +1,126 @@
+#include "DecodeScheduler.h"
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <QtCore/QThread>
+#include <QtGui/QGuiApplication>
+#include <QtQuick/QQuickWindow>
+
+// Reduced items keep at least this part of their size in each dimension
+static constexpr double minSurfaceScale = 0.25;
+
+DecodeScheduler &DecodeScheduler::instance() {
+    static DecodeScheduler scheduler;
+    return scheduler;
+}
+
+uint64_t DecodeScheduler::add(Client &&client) {
+    const uint64_t id = m_nextId++;
+    // The timer is created here, so it belongs to the GUI thread and the passes run there
+    auto insert = [this, id, client]() {
+        if (m_removed.erase(id)) return;
+        if (!m_timer) {
+            m_timer = new QTimer();
+            m_timer->setInterval(250);
+            QObject::connect(m_timer, &QTimer::timeout, [this] { schedule(); });
+        }
+        m_clients.emplace(id, client);
+        if (!m_timer->isActive()) m_timer->start();
+    };
+    if (QThread::currentThread() == qApp->thread()) {
+        insert();
+    } else {
+        QMetaObject::invokeMethod(qApp, insert, Qt::QueuedConnection);
+    }
+    return id;
+}
+
+void DecodeScheduler::remove(uint64_t id) {
+    if (!m_clients.erase(id)) m_removed.insert(id);
+    if (m_clients.empty() && m_timer) m_timer->stop();
+}
+
+void DecodeScheduler::setPriority(uint64_t id, int priority) {
+    auto it = m_clients.find(id);
+    if (it != m_clients.end()) it->second.priority = priority;
+}
+
+void DecodeScheduler::setBudget(uint32_t maxActive, uint64_t pixelBudget) {
+    m_maxActive = maxActive;
+    m_pixelBudget = pixelBudget;
+    schedule();
+}
+
+// Device pixels of the item inside its window, 0 if it isn't shown
+uint64_t DecodeScheduler::visiblePixels(QQuickItem *item) {
+    if (!item || !item->isVisible() || item->opacity() <= 0.0) return 0;
+    auto window = item->window();
+    if (!window || !window->isVisible() || window->visibility() == QWindow::Minimized) return 0;
+
+    const QRectF rect = item->mapRectToScene(item->boundingRect()).intersected(QRectF(QPointF(0, 0), window->size()));
+    if (rect.isEmpty()) return 0;
+    const double dpr = window->effectiveDevicePixelRatio();
+    return uint64_t(rect.width() * dpr * rect.height() * dpr);
+}
+
+void DecodeScheduler::schedule() {
+    struct Entry { Client *client; uint64_t pixels; };
+    std::vector<Entry> visible;
+    DecodeSchedulerStats stats;
+
+    auto apply = [&stats](Client &client, DecodeLevel level, const QSize &cap) {
+        if (level == DecodeLevel::Paused && client.audible()) level = DecodeLevel::Full;
+        switch (level) {
+            case DecodeLevel::Full:    stats.full++; break;
+            case DecodeLevel::Reduced: stats.reduced++; break;
+            case DecodeLevel::Paused:  stats.paused++; break;
+        }
+        client.apply(level, cap);
+    };
+
+    const bool budget = m_maxActive || m_pixelBudget;
+    for (auto &x : m_clients) {
+        auto &client = x.second;
+        if (!client.item || !client.schedulable()) continue;
+        stats.players++;
+        if (!budget) {
+            apply(client, DecodeLevel::Full, QSize()); // Undoes what a previous budget applied
+            continue;
+        }
+        const uint64_t pixels = visiblePixels(client.item);
+        if (pixels) {
+            visible.push_back({ &client, pixels });
+        } else {
+            apply(client, DecodeLevel::Paused, QSize());
+        }
+    }
+
+    std::stable_sort(visible.begin(), visible.end(), [](const Entry &a, const Entry &b) {
+        if (a.client->priority != b.client->priority) return a.client->priority > b.client->priority;
+        return a.pixels > b.pixels;
+    });
+
+    uint64_t used = 0;
+    for (size_t i = 0; i < visible.size(); ++i) {
+        auto &client = *visible[i].client;
+        const uint64_t pixels = visible[i].pixels;
+        if (m_maxActive && i >= m_maxActive) {
+            apply(client, DecodeLevel::Paused, QSize());
+            continue;
+        }
+        if (!m_pixelBudget || used + pixels <= m_pixelBudget) {
+            used += pixels;
+            apply(client, DecodeLevel::Full, QSize());
+            continue;
+        }
+        // Whatever is left of the budget, scaled in both dimensions
+        const double remaining = double(m_pixelBudget > used? m_pixelBudget - used : 0);
+        const double scale = std::clamp(std::sqrt(remaining / double(pixels)), minSurfaceScale, 1.0);
+        used += uint64_t(pixels * scale * scale);
+
+        const QSizeF itemSize = client.item->size() * client.item->window()->effectiveDevicePixelRatio();
+        apply(client, DecodeLevel::Reduced, QSize(std::max(32, int(itemSize.width() * scale)), std::max(32, int(itemSize.height() * scale))));
+    }
+    stats.visiblePixels = used;
+    m_stats = stats;
+}
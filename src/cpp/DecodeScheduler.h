@@ -0,0 +1,69 @@
+#ifndef DECODE_SCHEDULER_H
+#define DECODE_SCHEDULER_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <atomic>
+#include <functional>
+#include <QtCore/QPointer>
+#include <QtCore/QSize>
+#include <QtCore/QTimer>
+#include <QtQuick/QQuickItem>
+
+enum class DecodeLevel {
+    Full,
+    Reduced, // Non-reference frames are skipped and the render surface is capped
+    Paused   // Hidden, offscreen, or over the maximum number of decoding items, never while playing audio
+};
+
+// Must match `DecodeSchedulerStats` in video_player.rs
+struct DecodeSchedulerStats {
+    uint64_t players{0};
+    uint64_t full{0};
+    uint64_t reduced{0};
+    uint64_t paused{0};
+    uint64_t visiblePixels{0}; // On-screen pixels of the items which decode
+};
+
+// Process-wide decode budget for the video items. Every 250 ms the visible part of each item is measured, then items get
+// the budget in order of priority and on-screen size: hidden and offscreen items are paused, items past `maxActive` are paused,
+// and items which don't fit in `pixelBudget` decode at reduced cost. Without a budget every item decodes in full.
+// Items which play audio are never paused, that would stop the sound and the clock with it. GUI thread only, except for add()
+class DecodeScheduler {
+public:
+    struct Client {
+        QPointer<QQuickItem> item;
+        int priority{0};
+        std::function<bool()> schedulable; // Loaded video with a player of its own
+        std::function<bool()> audible;     // Unmuted with an audio stream
+        std::function<void(DecodeLevel level, const QSize &surfaceCap)> apply; // Called on every pass, even if nothing changed
+    };
+
+    static DecodeScheduler &instance();
+
+    // May be called from the render thread, e.g. while the item sets up its node. The client is registered on the GUI thread,
+    // which is where the passes and the `apply` calls run
+    uint64_t add(Client &&client);
+    void remove(uint64_t id);
+    void setPriority(uint64_t id, int priority);
+
+    // 0 disables the limit. Both are disabled by default, then nothing is paused or reduced, not even hidden items
+    void setBudget(uint32_t maxActive, uint64_t pixelBudget);
+    DecodeSchedulerStats stats() const { return m_stats; }
+
+private:
+    DecodeScheduler() = default;
+    void schedule();
+    static uint64_t visiblePixels(QQuickItem *item);
+
+    std::map<uint64_t, Client> m_clients;
+    std::set<uint64_t> m_removed; // Removed before their queued add() arrived
+    std::atomic<uint64_t> m_nextId{1};
+    uint32_t m_maxActive{0};
+    uint64_t m_pixelBudget{0};
+    QTimer *m_timer{nullptr};
+    DecodeSchedulerStats m_stats;
+};
+
+#endif
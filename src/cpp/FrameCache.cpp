@@ -0,0 +1,175 @@
+#include "FrameCache.h"
+#include <algorithm>
+#include <cstdlib>
+
+static uint64_t textureBytes(const QRhiTexture *tex) {
+    const QSize size = tex->pixelSize();
+    return uint64_t(size.width()) * uint64_t(size.height()) * 4;
+}
+
+void FrameCache::setBudget(uint64_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_budget = bytes;
+        if (m_used <= m_budget) return;
+    }
+    clear();
+}
+
+void FrameCache::setRange(int64_t first, int64_t last) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_first = first;
+    m_last = last;
+}
+
+uint64_t FrameCache::evictionDistance(int64_t frame, int64_t playhead) const {
+    const int64_t length = m_last - m_first + 1;
+    if (length <= 0 || frame < m_first || frame > m_last) {
+        return uint64_t(std::abs(frame - playhead)) + uint64_t(std::max<int64_t>(length, 0)); // Outside of the range goes first
+    }
+    return uint64_t(((frame - playhead) % length + length) % length); // How long until the loop gets to this frame
+}
+
+// Requires m_mutex to be locked
+QRhiTexture *FrameCache::evict(int64_t playhead, int64_t keep) {
+    auto victim = m_entries.end();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->first == keep) continue;
+        if (victim == m_entries.end()) { victim = it; continue; }
+        const uint64_t d = evictionDistance(it->first, playhead), vd = evictionDistance(victim->first, playhead);
+        if (d > vd || (d == vd && it->second.lastUsed < victim->second.lastUsed)) {
+            victim = it;
+        }
+    }
+    if (victim == m_entries.end()) return nullptr;
+    QRhiTexture *tex = victim->second.texture;
+    m_used -= textureBytes(tex);
+    m_entries.erase(victim);
+    m_evictions++;
+    return tex;
+}
+
+bool FrameCache::store(QRhi *rhi, QRhiResourceUpdateBatch *u, QRhiTexture *src, int64_t frame, double timestamp, int64_t playhead) {
+    if (!rhi || !u || !src) return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_budget) return false;
+
+    const uint64_t bytes = textureBytes(src);
+    if (bytes > m_budget) return false;
+
+    QRhiTexture *tex = nullptr;
+    auto existing = m_entries.find(frame);
+    if (existing != m_entries.end()) {
+        tex = existing->second.texture;
+        m_used -= textureBytes(tex);
+        m_entries.erase(existing);
+    }
+    while (m_used + bytes > m_budget && !m_entries.empty()) {
+        // Don't evict the frame we're about to store to make room for itself
+        const uint64_t d = evictionDistance(frame, playhead);
+        bool worthIt = false;
+        for (const auto &x : m_entries) worthIt |= evictionDistance(x.first, playhead) >= d;
+        if (!worthIt) {
+            if (tex) tex->deleteLater();
+            return false;
+        }
+        QRhiTexture *evicted = evict(playhead, frame);
+        if (!tex && evicted && evicted->pixelSize() == src->pixelSize() && evicted->format() == src->format()) {
+            tex = evicted;
+        } else if (evicted) {
+            evicted->deleteLater();
+        }
+    }
+    if (tex && (tex->pixelSize() != src->pixelSize() || tex->format() != src->format())) {
+        tex->deleteLater();
+        tex = nullptr;
+    }
+    if (!tex) {
+        tex = rhi->newTexture(src->format(), src->pixelSize(), 1, QRhiTexture::UsedAsTransferSource);
+        if (!tex || !tex->create()) {
+            delete tex;
+            return false;
+        }
+    }
+    u->copyTexture(tex, src);
+
+    m_entries[frame] = Entry { tex, timestamp, ++m_useCounter };
+    m_used += bytes;
+    return true;
+}
+
+bool FrameCache::fetch(QRhiResourceUpdateBatch *u, QRhiTexture *dst, int64_t frame, bool orPrevious, int64_t *foundFrame, double *timestamp) {
+    if (!u || !dst) return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(frame);
+    if (it == m_entries.end() && orPrevious) {
+        it = m_entries.upper_bound(frame);
+        it = it == m_entries.begin()? m_entries.end() : std::prev(it);
+    }
+    if (it == m_entries.end()) {
+        m_misses++;
+        return false;
+    }
+    if (it->second.texture->pixelSize() != dst->pixelSize()) return false;
+
+    u->copyTexture(dst, it->second.texture);
+    it->second.lastUsed = ++m_useCounter;
+    m_hits++;
+    if (foundFrame) *foundFrame = it->first;
+    if (timestamp) *timestamp = it->second.timestamp;
+    return true;
+}
+
+bool FrameCache::contains(int64_t frame) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.count(frame) > 0;
+}
+
+bool FrameCache::bounds(int64_t &first, int64_t &last) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto from = m_entries.lower_bound(m_first);
+    auto to = m_entries.upper_bound(m_last);
+    if (from == m_entries.end() || from == to) return false;
+    first = from->first;
+    last = std::prev(to)->first;
+    return true;
+}
+
+uint64_t FrameCache::evictions() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_evictions;
+}
+
+void FrameCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &x : m_entries) {
+        m_retired.push_back(x.second.texture);
+    }
+    m_entries.clear();
+    m_used = 0;
+}
+
+void FrameCache::releaseRetired() {
+    for (auto tex : takeRetired()) {
+        tex->deleteLater();
+    }
+}
+
+std::vector<QRhiTexture *> FrameCache::takeRetired() {
+    std::vector<QRhiTexture *> ret;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ret.swap(m_retired);
+    return ret;
+}
+
+FrameCacheStats FrameCache::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FrameCacheStats ret;
+    ret.budgetBytes = m_budget;
+    ret.usedBytes   = m_used;
+    ret.frames      = m_entries.size();
+    ret.hits        = m_hits;
+    ret.misses      = m_misses;
+    ret.evictions   = m_evictions;
+    return ret;
+}
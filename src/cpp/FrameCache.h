@@ -0,0 +1,77 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "VideoTextureNode.h"
+
+// Must match `FrameCacheStats` in video_player.rs
+struct FrameCacheStats {
+    uint64_t budgetBytes{0};
+    uint64_t usedBytes{0};
+    uint64_t frames{0};
+    uint64_t hits{0};      // Frames shown from the cache
+    uint64_t misses{0};    // Frames looked up but not in the cache
+    uint64_t evictions{0};
+};
+
+// Rendered frames of the playback range kept as GPU textures, keyed by frame number.
+// Frames are copied on the GPU in both directions, nothing goes through the CPU.
+// When the budget is exceeded, the frames furthest ahead of the playhead in loop order are evicted first, frames outside of the range before any of those,
+// and the least recently used one among equally distant frames
+class FrameCache {
+public:
+    void setBudget(uint64_t bytes);
+    uint64_t budget() const { return m_budget; }
+    bool enabled() const { return m_budget > 0; }
+
+    // Inclusive frame range which is played in a loop
+    void setRange(int64_t first, int64_t last);
+
+    // Copies `src` into the entry for `frame`, reusing an evicted texture when possible. Must be called on the render thread
+    bool store(QRhi *rhi, QRhiResourceUpdateBatch *u, QRhiTexture *src, int64_t frame, double timestamp, int64_t playhead);
+    // Copies the entry for `frame` into `dst`. With `orPrevious` a missing frame is replaced by the closest earlier one, e.g. for gaps in the numbering of VFR files.
+    // Must be called on the render thread
+    bool fetch(QRhiResourceUpdateBatch *u, QRhiTexture *dst, int64_t frame, bool orPrevious, int64_t *foundFrame = nullptr, double *timestamp = nullptr);
+
+    bool contains(int64_t frame) const;
+    // First and last cached frame within the range
+    bool bounds(int64_t &first, int64_t &last) const;
+    uint64_t evictions() const;
+
+    // Can be called from any thread. The textures aren't released here, the rhi may be recording a frame on the render thread,
+    // they wait for releaseRetired() or takeRetired()
+    void clear();
+    // Render thread, releases the textures of cleared frames
+    void releaseRetired();
+    // For releasing them elsewhere on the render thread, e.g. when the owner goes away
+    std::vector<QRhiTexture *> takeRetired();
+    FrameCacheStats stats() const;
+
+private:
+    struct Entry {
+        QRhiTexture *texture{nullptr};
+        double timestamp{0.0};
+        uint64_t lastUsed{0};
+    };
+    // Larger is evicted first
+    uint64_t evictionDistance(int64_t frame, int64_t playhead) const;
+    QRhiTexture *evict(int64_t playhead, int64_t keep);
+
+    mutable std::mutex m_mutex;
+    std::map<int64_t, Entry> m_entries;
+    std::vector<QRhiTexture *> m_retired;
+    uint64_t m_budget{0};
+    uint64_t m_used{0};
+    uint64_t m_useCounter{0};
+    int64_t m_first{0};
+    int64_t m_last{-1};
+
+    uint64_t m_hits{0};
+    uint64_t m_misses{0};
+    uint64_t m_evictions{0};
+};
+
+#endif
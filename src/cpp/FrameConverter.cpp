@@ -0,0 +1,405 @@
+#include "FrameConverter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "mdk/VideoFrame.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#   define FC_X86 1
+#   include <immintrin.h>
+#   if defined(_MSC_VER) && !defined(__clang__)
+#       include <intrin.h>
+#       define FC_TARGET_AVX2
+#   else
+#       include <cpuid.h>
+#       define FC_TARGET_AVX2 __attribute__((target("avx2")))
+#   endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#   define FC_NEON 1
+#   include <arm_neon.h>
+#endif
+
+namespace {
+
+struct Coeffs {
+    float ys, yo; // Luma scale and offset to full range 0-255
+    float cs, co; // Chroma scale and offset to -128..127
+    float rv, gu, gv, bu;
+};
+
+typedef void (*LerpFn)(float *a, const float *b, float w, uint32_t n);
+typedef void (*AccumFn)(float *acc, const float *row, uint32_t n);
+typedef void (*ScaleFn)(float *a, float s, uint32_t n);
+typedef void (*ConvertFn)(const float *y, const float *u, const float *v, uint32_t n, const Coeffs &c, FrameConverter::Target target, uint8_t *out);
+
+struct Kernels {
+    const char *name;
+    LerpFn lerp;
+    AccumFn accum;
+    ScaleFn scale;
+    ConvertFn convert;
+};
+
+// ---------------------------------- Scalar ----------------------------------
+inline uint8_t clampByte(float v) {
+    return v <= 0.0f? 0 : v >= 255.0f? 255 : uint8_t(v + 0.5f);
+}
+
+void lerpScalar(float *a, const float *b, float w, uint32_t n) {
+    for (uint32_t i = 0; i < n; ++i) a[i] += (b[i] - a[i]) * w;
+}
+void accumScalar(float *acc, const float *row, uint32_t n) {
+    for (uint32_t i = 0; i < n; ++i) acc[i] += row[i];
+}
+void scaleScalar(float *a, float s, uint32_t n) {
+    for (uint32_t i = 0; i < n; ++i) a[i] *= s;
+}
+void convertScalar(const float *y, const float *u, const float *v, uint32_t n, const Coeffs &c, FrameConverter::Target target, uint8_t *out) {
+    if (target == FrameConverter::Target::GRAY8) {
+        for (uint32_t i = 0; i < n; ++i) out[i] = clampByte(y[i] * c.ys + c.yo);
+        return;
+    }
+    const bool bgra = target == FrameConverter::Target::BGRA;
+    for (uint32_t i = 0; i < n; ++i) {
+        const float Y = y[i] * c.ys + c.yo;
+        const float U = u[i] * c.cs + c.co;
+        const float V = v[i] * c.cs + c.co;
+        const uint8_t r = clampByte(Y + c.rv * V);
+        const uint8_t g = clampByte(Y - c.gu * U - c.gv * V);
+        const uint8_t b = clampByte(Y + c.bu * U);
+        out[i * 4 + 0] = bgra? b : r;
+        out[i * 4 + 1] = g;
+        out[i * 4 + 2] = bgra? r : b;
+        out[i * 4 + 3] = 255;
+    }
+}
+
+const Kernels scalarKernels { "scalar", lerpScalar, accumScalar, scaleScalar, convertScalar };
+
+// ----------------------------------- AVX2 -----------------------------------
+#ifdef FC_X86
+FC_TARGET_AVX2 void lerpAvx2(float *a, const float *b, float w, uint32_t n) {
+    const __m256 vw = _mm256_set1_ps(w);
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 va = _mm256_loadu_ps(a + i);
+        _mm256_storeu_ps(a + i, _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(b + i), va), vw)));
+    }
+    lerpScalar(a + i, b + i, w, n - i);
+}
+FC_TARGET_AVX2 void accumAvx2(float *acc, const float *row, uint32_t n) {
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_loadu_ps(row + i)));
+    }
+    accumScalar(acc + i, row + i, n - i);
+}
+FC_TARGET_AVX2 void scaleAvx2(float *a, float s, uint32_t n) {
+    const __m256 vs = _mm256_set1_ps(s);
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(a + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), vs));
+    }
+    scaleScalar(a + i, s, n - i);
+}
+FC_TARGET_AVX2 void convertAvx2(const float *y, const float *u, const float *v, uint32_t n, const Coeffs &c, FrameConverter::Target target, uint8_t *out) {
+    const __m256 ys = _mm256_set1_ps(c.ys), yo = _mm256_set1_ps(c.yo);
+    uint32_t i = 0;
+    if (target == FrameConverter::Target::GRAY8) {
+        for (; i + 8 <= n; i += 8) {
+            const __m256i yi = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(y + i), ys), yo));
+            // Saturating packs clamp to 0-255
+            const __m128i p16 = _mm_packus_epi32(_mm256_castsi256_si128(yi), _mm256_extracti128_si256(yi, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(p16, p16));
+        }
+        convertScalar(y + i, nullptr, nullptr, n - i, c, target, out + i);
+        return;
+    }
+    const __m256 cs = _mm256_set1_ps(c.cs), co = _mm256_set1_ps(c.co);
+    const __m256 rv = _mm256_set1_ps(c.rv), gu = _mm256_set1_ps(c.gu), gv = _mm256_set1_ps(c.gv), bu = _mm256_set1_ps(c.bu);
+    const __m256i zero = _mm256_setzero_si256(), max = _mm256_set1_epi32(255), alpha = _mm256_set1_epi32(int(0xff000000u));
+    const bool bgra = target == FrameConverter::Target::BGRA;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 Y = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(y + i), ys), yo);
+        const __m256 U = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(u + i), cs), co);
+        const __m256 V = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(v + i), cs), co);
+        const __m256 R = _mm256_add_ps(Y, _mm256_mul_ps(rv, V));
+        const __m256 G = _mm256_sub_ps(_mm256_sub_ps(Y, _mm256_mul_ps(gu, U)), _mm256_mul_ps(gv, V));
+        const __m256 B = _mm256_add_ps(Y, _mm256_mul_ps(bu, U));
+        const __m256i ri = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvtps_epi32(R), zero), max);
+        const __m256i gi = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvtps_epi32(G), zero), max);
+        const __m256i bi = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvtps_epi32(B), zero), max);
+        __m256i px = _mm256_or_si256(bgra? bi : ri, _mm256_slli_epi32(gi, 8));
+        px = _mm256_or_si256(px, _mm256_slli_epi32(bgra? ri : bi, 16));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i * 4), _mm256_or_si256(px, alpha));
+    }
+    convertScalar(y + i, u + i, v + i, n - i, c, target, out + i * 4);
+}
+
+const Kernels avx2Kernels { "avx2", lerpAvx2, accumAvx2, scaleAvx2, convertAvx2 };
+
+bool hasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28))) return false; // OSXSAVE and AVX
+    if ((_xgetbv(0) & 6) != 6) return false; // OS saves YMM state
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    unsigned a, b, c, d;
+    if (__get_cpuid_max(0, nullptr) < 7) return false;
+    __cpuid(1, a, b, c, d);
+    if (!(c & (1u << 27)) || !(c & (1u << 28))) return false; // OSXSAVE and AVX
+    unsigned xlo, xhi;
+    __asm__ volatile("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+    if ((xlo & 6) != 6) return false; // OS saves YMM state
+    __cpuid_count(7, 0, a, b, c, d);
+    return b & (1u << 5);
+#endif
+}
+#endif // FC_X86
+
+// ----------------------------------- NEON -----------------------------------
+#ifdef FC_NEON
+void lerpNeon(float *a, const float *b, float w, uint32_t n) {
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t va = vld1q_f32(a + i);
+        vst1q_f32(a + i, vaddq_f32(va, vmulq_n_f32(vsubq_f32(vld1q_f32(b + i), va), w)));
+    }
+    lerpScalar(a + i, b + i, w, n - i);
+}
+void accumNeon(float *acc, const float *row, uint32_t n) {
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(acc + i, vaddq_f32(vld1q_f32(acc + i), vld1q_f32(row + i)));
+    }
+    accumScalar(acc + i, row + i, n - i);
+}
+void scaleNeon(float *a, float s, uint32_t n) {
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(a + i, vmulq_n_f32(vld1q_f32(a + i), s));
+    }
+    scaleScalar(a + i, s, n - i);
+}
+void convertNeon(const float *y, const float *u, const float *v, uint32_t n, const Coeffs &c, FrameConverter::Target target, uint8_t *out) {
+    const float32x4_t yo = vdupq_n_f32(c.yo);
+    uint32_t i = 0;
+    if (target == FrameConverter::Target::GRAY8) {
+        for (; i + 8 <= n; i += 8) {
+            const int32x4_t lo = vcvtnq_s32_f32(vaddq_f32(vmulq_n_f32(vld1q_f32(y + i), c.ys), yo));
+            const int32x4_t hi = vcvtnq_s32_f32(vaddq_f32(vmulq_n_f32(vld1q_f32(y + i + 4), c.ys), yo));
+            // Saturating narrows clamp to 0-255
+            vst1_u8(out + i, vqmovn_u16(vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi))));
+        }
+        convertScalar(y + i, nullptr, nullptr, n - i, c, target, out + i);
+        return;
+    }
+    const float32x4_t co = vdupq_n_f32(c.co);
+    const int32x4_t zero = vdupq_n_s32(0), max = vdupq_n_s32(255);
+    const uint32x4_t alpha = vdupq_n_u32(0xff000000u);
+    const bool bgra = target == FrameConverter::Target::BGRA;
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t Y = vaddq_f32(vmulq_n_f32(vld1q_f32(y + i), c.ys), yo);
+        const float32x4_t U = vaddq_f32(vmulq_n_f32(vld1q_f32(u + i), c.cs), co);
+        const float32x4_t V = vaddq_f32(vmulq_n_f32(vld1q_f32(v + i), c.cs), co);
+        const float32x4_t R = vaddq_f32(Y, vmulq_n_f32(V, c.rv));
+        const float32x4_t G = vsubq_f32(vsubq_f32(Y, vmulq_n_f32(U, c.gu)), vmulq_n_f32(V, c.gv));
+        const float32x4_t B = vaddq_f32(Y, vmulq_n_f32(U, c.bu));
+        const uint32x4_t ri = vreinterpretq_u32_s32(vminq_s32(vmaxq_s32(vcvtnq_s32_f32(R), zero), max));
+        const uint32x4_t gi = vreinterpretq_u32_s32(vminq_s32(vmaxq_s32(vcvtnq_s32_f32(G), zero), max));
+        const uint32x4_t bi = vreinterpretq_u32_s32(vminq_s32(vmaxq_s32(vcvtnq_s32_f32(B), zero), max));
+        uint32x4_t px = vorrq_u32(bgra? bi : ri, vshlq_n_u32(gi, 8));
+        px = vorrq_u32(px, vshlq_n_u32(bgra? ri : bi, 16));
+        vst1q_u8(out + i * 4, vreinterpretq_u8_u32(vorrq_u32(px, alpha)));
+    }
+    convertScalar(y + i, u + i, v + i, n - i, c, target, out + i * 4);
+}
+
+const Kernels neonKernels { "neon", lerpNeon, accumNeon, scaleNeon, convertNeon };
+#endif // FC_NEON
+
+const Kernels &kernels() {
+    static const Kernels *k = [] {
+        if (getenv("FRAMECONVERTER_SCALAR")) return &scalarKernels;
+#ifdef FC_X86
+        if (hasAvx2()) return &avx2Kernels;
+#endif
+#ifdef FC_NEON
+        return &neonKernels;
+#endif
+        return &scalarKernels;
+    }();
+    return *k;
+}
+
+Coeffs coefficients(FrameConverter::Matrix matrix, bool fullRange) {
+    Coeffs c{};
+    if (fullRange) {
+        c.ys = 1.0f;            c.yo = 0.0f;
+        c.cs = 1.0f;            c.co = -128.0f;
+    } else {
+        c.ys = 255.0f / 219.0f; c.yo = -16.0f * c.ys;
+        c.cs = 255.0f / 224.0f; c.co = -128.0f * c.cs;
+    }
+    switch (matrix) {
+        case FrameConverter::Matrix::BT601:  c.rv = 1.402f;  c.gu = 0.344136f; c.gv = 0.714136f; c.bu = 1.772f;  break;
+        case FrameConverter::Matrix::BT2020: c.rv = 1.4746f; c.gu = 0.164553f; c.gv = 0.571353f; c.bu = 1.8814f; break;
+        default:                             c.rv = 1.5748f; c.gu = 0.187324f; c.gv = 0.468124f; c.bu = 1.8556f; break;
+    }
+    return c;
+}
+
+} // namespace
+
+const char *FrameConverter::kernelName() {
+    return kernels().name;
+}
+
+bool FrameConverter::planesFromFrame(const mdk::VideoFrame &v, Planes &planes) {
+    switch (mdk::PixelFormat(v.format())) {
+        case mdk::PixelFormat::NV12:    planes.format = Source::NV12; break;
+        case mdk::PixelFormat::YUV420P: planes.format = Source::YUV420P; break;
+        case mdk::PixelFormat::P010LE:  planes.format = Source::P010; break;
+        default: return false;
+    }
+    planes.width  = v.width();
+    planes.height = v.height();
+    for (int i = 0; i < (planes.format == Source::YUV420P? 3 : 2); ++i) {
+        planes.data[i]   = v.bufferData(i);
+        planes.stride[i] = v.bytesPerLine(i);
+        if (!planes.data[i]) return false; // Hardware frame
+    }
+    return true;
+}
+
+void FrameConverter::buildAxis(Axis &axis, uint32_t srcSize, uint32_t dstSize, Filter filter) {
+    axis.index.resize(dstSize);
+    axis.count.assign(dstSize, 1);
+    axis.weight.assign(dstSize, 0.0f);
+    const double ratio = double(srcSize) / double(dstSize);
+    for (uint32_t i = 0; i < dstSize; ++i) {
+        if (filter == Filter::Area) {
+            const uint32_t start = std::min<uint32_t>(srcSize - 1, uint32_t(std::floor(i * ratio)));
+            const uint32_t end   = std::min<uint32_t>(srcSize, uint32_t(std::ceil((i + 1) * ratio)));
+            axis.index[i] = start;
+            axis.count[i] = std::max<uint32_t>(1, end - start);
+        } else {
+            const double s = std::min<double>(std::max<double>((i + 0.5) * ratio - 0.5, 0.0), srcSize - 1);
+            const uint32_t s0 = uint32_t(s);
+            axis.index[i] = s0;
+            axis.weight[i] = s0 + 1 < srcSize? float(s - s0) : 0.0f;
+        }
+    }
+}
+
+void FrameConverter::prepare(const Planes &src, uint32_t dstWidth, uint32_t dstHeight, Filter filter) {
+    if (m_srcWidth == src.width && m_srcHeight == src.height && m_dstWidth == dstWidth && m_dstHeight == dstHeight && m_filter == filter)
+        return;
+
+    m_srcWidth = src.width; m_srcHeight = src.height;
+    m_dstWidth = dstWidth;  m_dstHeight = dstHeight;
+    m_filter = filter;
+
+    buildAxis(m_lumaX,   src.width,            dstWidth,  filter);
+    buildAxis(m_lumaY,   src.height,           dstHeight, filter);
+    buildAxis(m_chromaX, (src.width + 1) / 2,  dstWidth,  filter);
+    buildAxis(m_chromaY, (src.height + 1) / 2, dstHeight, filter);
+
+    m_y.resize(dstWidth);
+    m_u.resize(dstWidth);
+    m_v.resize(dstWidth);
+    m_tmp.resize(dstWidth);
+}
+
+template <typename T>
+void FrameConverter::sampleRow(const uint8_t *row, uint32_t step, uint32_t offset, const Axis &axis, float scale, float *out) const {
+    const T *p = reinterpret_cast<const T *>(row);
+    const uint32_t n = uint32_t(axis.index.size());
+    if (m_filter == Filter::Area) {
+        for (uint32_t x = 0; x < n; ++x) {
+            const T *s = p + size_t(axis.index[x]) * step + offset;
+            const uint32_t count = axis.count[x];
+            uint32_t sum = 0;
+            for (uint32_t i = 0; i < count; ++i) sum += s[size_t(i) * step];
+            out[x] = float(sum) * (scale / count);
+        }
+    } else {
+        for (uint32_t x = 0; x < n; ++x) {
+            const T *s = p + size_t(axis.index[x]) * step + offset;
+            const float a = s[0];
+            const float w = axis.weight[x];
+            out[x] = (w > 0.0f? a + (float(s[step]) - a) * w : a) * scale;
+        }
+    }
+}
+
+template <typename T>
+void FrameConverter::resampleRow(const uint8_t *plane, uint32_t stride, uint32_t step, uint32_t offset, const Axis &xAxis, const Axis &yAxis, uint32_t y, float scale, float *out) {
+    const auto &k = kernels();
+    const uint32_t n = uint32_t(xAxis.index.size());
+    const uint32_t sy = yAxis.index[y];
+    sampleRow<T>(plane + size_t(sy) * stride, step, offset, xAxis, scale, out);
+    if (m_filter == Filter::Area) {
+        const uint32_t rows = yAxis.count[y];
+        for (uint32_t r = 1; r < rows; ++r) {
+            sampleRow<T>(plane + size_t(sy + r) * stride, step, offset, xAxis, scale, m_tmp.data());
+            k.accum(out, m_tmp.data(), n);
+        }
+        if (rows > 1) k.scale(out, 1.0f / rows, n);
+    } else if (yAxis.weight[y] > 0.0f) {
+        sampleRow<T>(plane + size_t(sy + 1) * stride, step, offset, xAxis, scale, m_tmp.data());
+        k.lerp(out, m_tmp.data(), yAxis.weight[y], n);
+    }
+}
+
+bool FrameConverter::convert(const Planes &src, Target target, uint32_t dstWidth, uint32_t dstHeight, uint8_t *dst, size_t dstStride, Filter filter) {
+    if (!dst || !src.data[0] || !src.data[1] || (src.format == Source::YUV420P && !src.data[2])) return false;
+    if (src.width < 2 || src.height < 2 || dstWidth == 0 || dstHeight == 0) return false;
+    if (dstStride < size_t(dstWidth) * bytesPerPixel(target)) return false;
+
+    prepare(src, dstWidth, dstHeight, filter);
+
+    Matrix matrix = src.matrix;
+    if (matrix == Matrix::Auto) {
+        matrix = src.format == Source::P010? Matrix::BT2020 : src.height >= 720? Matrix::BT709 : Matrix::BT601;
+    }
+    const Coeffs c = coefficients(matrix, src.fullRange);
+    const auto &k = kernels();
+    const bool gray = target == Target::GRAY8;
+
+    for (uint32_t y = 0; y < dstHeight; ++y) {
+        switch (src.format) {
+            case Source::NV12:
+                resampleRow<uint8_t>(src.data[0], src.stride[0], 1, 0, m_lumaX, m_lumaY, y, 1.0f, m_y.data());
+                if (!gray) {
+                    resampleRow<uint8_t>(src.data[1], src.stride[1], 2, 0, m_chromaX, m_chromaY, y, 1.0f, m_u.data());
+                    resampleRow<uint8_t>(src.data[1], src.stride[1], 2, 1, m_chromaX, m_chromaY, y, 1.0f, m_v.data());
+                }
+                break;
+            case Source::YUV420P:
+                resampleRow<uint8_t>(src.data[0], src.stride[0], 1, 0, m_lumaX, m_lumaY, y, 1.0f, m_y.data());
+                if (!gray) {
+                    resampleRow<uint8_t>(src.data[1], src.stride[1], 1, 0, m_chromaX, m_chromaY, y, 1.0f, m_u.data());
+                    resampleRow<uint8_t>(src.data[2], src.stride[2], 1, 0, m_chromaX, m_chromaY, y, 1.0f, m_v.data());
+                }
+                break;
+            case Source::P010: {
+                // 10 bit samples in the high bits of 16 bit words
+                const float scale = 255.0f / 65535.0f;
+                resampleRow<uint16_t>(src.data[0], src.stride[0], 1, 0, m_lumaX, m_lumaY, y, scale, m_y.data());
+                if (!gray) {
+                    resampleRow<uint16_t>(src.data[1], src.stride[1], 2, 0, m_chromaX, m_chromaY, y, scale, m_u.data());
+                    resampleRow<uint16_t>(src.data[1], src.stride[1], 2, 1, m_chromaX, m_chromaY, y, scale, m_v.data());
+                }
+            } break;
+        }
+        k.convert(m_y.data(), m_u.data(), m_v.data(), dstWidth, c, target, dst + size_t(y) * dstStride);
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef FRAME_CONVERTER_H
+#define FRAME_CONVERTER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace mdk { class VideoFrame; }
+
+// Fused colour conversion and downscale of 4:2:0 frames into a caller provided buffer.
+// Every output row is produced from its source rows in one go, there is no intermediate full size frame.
+// The per-row kernels have AVX2 and NEON versions, picked at runtime, with a scalar fallback.
+class FrameConverter {
+public:
+    enum class Source { NV12, YUV420P, P010 };
+    enum class Target { RGBA, BGRA, GRAY8 };
+    enum class Filter { Bilinear, Area };
+    enum class Matrix { Auto, BT601, BT709, BT2020 };
+
+    struct Planes {
+        Source format{Source::NV12};
+        uint32_t width{0};  // Luma size
+        uint32_t height{0};
+        const uint8_t *data[3]{};
+        uint32_t stride[3]{}; // In bytes
+        Matrix matrix{Matrix::Auto};
+        bool fullRange{false};
+    };
+
+    static uint32_t bytesPerPixel(Target target) { return target == Target::GRAY8? 1 : 4; }
+
+    // Returns false for hardware frames and pixel formats the converter doesn't handle
+    static bool planesFromFrame(const mdk::VideoFrame &v, Planes &planes);
+
+    // Returns false if the input can't be handled, dst is left untouched in that case
+    bool convert(const Planes &src, Target target, uint32_t dstWidth, uint32_t dstHeight, uint8_t *dst, size_t dstStride, Filter filter = Filter::Bilinear);
+
+    // "avx2", "neon" or "scalar"
+    static const char *kernelName();
+
+private:
+    struct Axis {
+        std::vector<uint32_t> index;  // First source sample
+        std::vector<uint32_t> count;  // Area: number of samples
+        std::vector<float> weight;    // Bilinear: weight of the second sample
+    };
+    static void buildAxis(Axis &axis, uint32_t srcSize, uint32_t dstSize, Filter filter);
+
+    template <typename T>
+    void sampleRow(const uint8_t *row, uint32_t step, uint32_t offset, const Axis &axis, float scale, float *out) const;
+    template <typename T>
+    void resampleRow(const uint8_t *plane, uint32_t stride, uint32_t step, uint32_t offset, const Axis &xAxis, const Axis &yAxis, uint32_t y, float scale, float *out);
+
+    void prepare(const Planes &src, uint32_t dstWidth, uint32_t dstHeight, Filter filter);
+
+    // Cached geometry, rebuilt only when the sizes or the filter change
+    uint32_t m_srcWidth{0}, m_srcHeight{0}, m_dstWidth{0}, m_dstHeight{0};
+    Filter m_filter{Filter::Bilinear};
+    Axis m_lumaX, m_lumaY, m_chromaX, m_chromaY;
+
+    std::vector<float> m_y, m_u, m_v, m_tmp;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "FrameIndex.h"
+#include "MediaCache.h"
+#include <cfloat>
+#include <cmath>
+#include <mutex>
+#include <future>
+#include <algorithm>
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+#include <QtCore/QUrl>
+
+#include "mdk/Player.h"
+#include "mdk/VideoFrame.h"
+
+static constexpr quint32 indexMagic = 0x51564649; // QVFI
+static constexpr quint32 indexVersion = 1;
+
+// Decoded frame timestamps are identical between passes, this only absorbs the ms conversion
+static constexpr double timestampTolerance = 0.5;
+
+struct FrameIndex::Pass {
+    std::vector<double> timestamps; // ms, in output order
+
+    std::mutex mutex;
+    bool finished{false};
+    bool ok{false};
+    std::promise<void> done;
+
+    // Requires mutex to be locked
+    void finish(bool success) {
+        if (finished) return;
+        finished = true;
+        ok = success;
+        done.set_value();
+    }
+
+    mdk::Player player; // Last, so it's destroyed before anything its callbacks use
+};
+
+FrameIndex::FrameIndex(const std::string &url) : m_url(url) { }
+
+FrameIndex::~FrameIndex() {
+    stop();
+}
+
+void FrameIndex::start(bool allowScan, std::function<void(bool ok)> &&onReady) {
+    m_onReady = std::move(onReady);
+    m_thread = std::thread([this, allowScan] { run(allowScan); });
+}
+
+void FrameIndex::stop() {
+    m_stopped = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void FrameIndex::run(bool allowScan) {
+    // Only local files can be identified without reading them, and scanning a stream would download it
+    const QString path = QString::fromStdString(m_url);
+    const QUrl url(path);
+    if (url.isLocalFile() || url.scheme().size() <= 1) {
+        const QString key = MediaCache::fileKey(path);
+        const QString dir = key.isEmpty()? QString() : MediaCache::directory("frameindex");
+        if (!dir.isEmpty()) m_file = dir + "/" + key + ".idx";
+    }
+
+    bool ok = false;
+    if (!m_file.isEmpty()) {
+        ok = load();
+        if (!ok && allowScan && scan()) {
+            save();
+            ok = true;
+        }
+    }
+    if (m_stopped) return;
+    m_ready = ok;
+    if (m_onReady) m_onReady(ok);
+}
+
+// Two decoders run over the whole file at the same time: one outputs every frame, the other only keyframes.
+// Neither needs full resolution or the deblocking filter, only the timestamps are used
+bool FrameIndex::scan() {
+    Pass frames, keyframes;
+    const bool started = runPass(frames, "FFmpeg:lowres=3:skip_loop_filter=all")
+                      && runPass(keyframes, "FFmpeg:lowres=3:skip_loop_filter=all:skip_frame=nokey");
+
+    auto wait = [this](Pass &pass) {
+        auto future = pass.done.get_future();
+        while (future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+            if (m_stopped) break;
+        }
+        pass.player.set(mdk::State::Stopped);
+        pass.player.waitFor(mdk::State::Stopped);
+        std::lock_guard<std::mutex> lock(pass.mutex);
+        pass.finished = true;
+        return pass.ok;
+    };
+    const bool framesOk = wait(frames);
+    wait(keyframes); // Without keyframes only the first frame is marked, so seekCost() errs on the high side
+    if (!started || !framesOk || m_stopped || frames.timestamps.empty()) return false;
+
+    m_timestamps = std::move(frames.timestamps);
+    std::sort(m_timestamps.begin(), m_timestamps.end());
+    m_timestamps.erase(std::unique(m_timestamps.begin(), m_timestamps.end(), [](double a, double b) { return b - a < timestampTolerance; }), m_timestamps.end());
+
+    m_keyframe.assign(m_timestamps.size(), 0);
+    m_keyframe[0] = 1;
+    for (double ts : keyframes.timestamps) {
+        const int64_t frame = frameAt(ts);
+        if (frame >= 0 && std::abs(m_timestamps[frame] - ts) < timestampTolerance) {
+            m_keyframe[frame] = 1;
+        }
+    }
+    m_keyframes.clear();
+    for (size_t i = 0; i < m_keyframe.size(); ++i) {
+        if (m_keyframe[i]) m_keyframes.push_back(int64_t(i));
+    }
+    return true;
+}
+
+bool FrameIndex::runPass(Pass &pass, const std::string &decoder) {
+    auto player = &pass.player;
+    player->setDecoders(mdk::MediaType::Video, { decoder, "FFmpeg", "BRAW:gpu=auto", "R3D:gpu=auto" });
+    player->setDecoders(mdk::MediaType::Audio, { });
+    player->setMedia(m_url.c_str());
+    player->setMute(true);
+    player->onSync([] { return DBL_MAX; });
+    player->onFrame<mdk::VideoFrame>([&pass](mdk::VideoFrame &v, int) -> int {
+        std::lock_guard<std::mutex> lock(pass.mutex);
+        if (pass.finished) return 0;
+        if (v.timestamp() == mdk::TimestampEOS || !v.format()) { // eof frame format is invalid
+            pass.finish(true);
+            return 0;
+        }
+        if (!v) return 0; // AOT frame(1st frame, seek end 1st frame) is not valid, but format is valid
+        pass.timestamps.push_back(v.timestamp() * 1000.0);
+        return 0;
+    });
+    player->setVideoSurfaceSize(64, 64);
+
+    player->prepare(0, [&pass](int64_t position, bool *) {
+        if (position < 0) { // Can't open the file
+            std::lock_guard<std::mutex> lock(pass.mutex);
+            pass.finish(false);
+        }
+        return true;
+    }, mdk::SeekFlag::FromStart);
+    player->set(mdk::State::Running);
+    return !m_stopped;
+}
+
+bool FrameIndex::load() {
+    QFile file(m_file);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream stream(&file);
+    quint32 magic = 0, version = 0;
+    quint64 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != indexMagic || version != indexVersion || !count || count > quint64(file.size()) / 9) return false;
+
+    std::vector<double> timestamps(count);
+    std::vector<uint8_t> keyframe(count);
+    for (quint64 i = 0; i < count; ++i) {
+        quint8 key = 0;
+        stream >> timestamps[i] >> key;
+        keyframe[i] = key;
+    }
+    if (stream.status() != QDataStream::Ok || !std::is_sorted(timestamps.begin(), timestamps.end())) return false;
+
+    m_timestamps = std::move(timestamps);
+    m_keyframe = std::move(keyframe);
+    m_keyframe[0] = 1;
+    m_keyframes.clear();
+    for (size_t i = 0; i < m_keyframe.size(); ++i) {
+        if (m_keyframe[i]) m_keyframes.push_back(int64_t(i));
+    }
+    return true;
+}
+
+bool FrameIndex::save() const {
+    QSaveFile file(m_file);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    QDataStream stream(&file);
+    stream << indexMagic << indexVersion << quint64(m_timestamps.size());
+    for (size_t i = 0; i < m_timestamps.size(); ++i) {
+        stream << m_timestamps[i] << quint8(m_keyframe[i]);
+    }
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+double FrameIndex::timestamp(int64_t frame) const {
+    if (frame < 0 || frame >= frameCount()) return -1.0;
+    return m_timestamps[frame];
+}
+
+int64_t FrameIndex::frameAt(double timestampMs) const {
+    if (m_timestamps.empty()) return -1;
+    const auto it = std::upper_bound(m_timestamps.begin(), m_timestamps.end(), timestampMs + timestampTolerance);
+    return std::max<int64_t>(0, int64_t(it - m_timestamps.begin()) - 1);
+}
+
+bool FrameIndex::isKeyframe(int64_t frame) const {
+    return frame >= 0 && frame < frameCount() && m_keyframe[frame];
+}
+
+int64_t FrameIndex::keyframeBefore(int64_t frame) const {
+    if (m_keyframes.empty() || frame < 0) return 0;
+    const auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), frame);
+    return it == m_keyframes.begin()? 0 : *(it - 1);
+}
+
+int64_t FrameIndex::seekCost(int64_t frame) const {
+    frame = std::clamp<int64_t>(frame, 0, std::max<int64_t>(0, frameCount() - 1));
+    return frame - keyframeBefore(frame) + 1;
+}
@@ -0,0 +1,63 @@
+#ifndef FRAME_INDEX_H
+#define FRAME_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <QtCore/QString>
+
+namespace mdk { class VideoFrame; }
+
+// Presentation timestamp and keyframe flag of every video frame of a file, so frame numbers stay exact with variable frame rate
+// and the decoding cost of a seek is known. Scanned once in the background and stored in the cache directory,
+// keyed by the file identity, so opening the same file again only reads that file.
+// Lookups are only valid once ready() returns true, the index doesn't change after that
+class FrameIndex {
+public:
+    explicit FrameIndex(const std::string &url);
+    ~FrameIndex();
+
+    // Loads the stored index of the file, or scans the file if there's none and `allowScan` is set.
+    // `onReady` is called once from a background thread, with false if there's no index
+    void start(bool allowScan, std::function<void(bool ok)> &&onReady);
+    void stop();
+
+    bool ready() const { return m_ready; }
+
+    int64_t frameCount() const { return int64_t(m_timestamps.size()); }
+    // Presentation timestamp of `frame` in ms, or -1 if there's no such frame
+    double timestamp(int64_t frame) const;
+    // Frame displayed at `timestampMs`, i.e. the last one which starts at or before it
+    int64_t frameAt(double timestampMs) const;
+    bool isKeyframe(int64_t frame) const;
+    // Nearest keyframe at or before `frame`
+    int64_t keyframeBefore(int64_t frame) const;
+    // Number of frames decoded by an exact seek to `frame`, starting from the preceding keyframe
+    int64_t seekCost(int64_t frame) const;
+
+private:
+    struct Pass;
+
+    void run(bool allowScan);
+    bool scan();
+    bool runPass(Pass &pass, const std::string &decoder);
+    bool load();
+    bool save() const;
+
+    std::string m_url;
+    QString m_file; // Sidecar in the cache directory, empty if the file can't be identified
+
+    std::vector<double> m_timestamps; // ms, ascending
+    std::vector<uint8_t> m_keyframe;
+    std::vector<int64_t> m_keyframes; // Frame numbers, ascending
+
+    std::function<void(bool)> m_onReady;
+    std::thread m_thread;
+    std::atomic<bool> m_ready{false};
+    std::atomic<bool> m_stopped{false};
+};
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <cstdint>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// Must match `ProcessingQueueStats` in video_player.rs
+struct FrameQueueStats {
+    uint64_t capacity{0};
+    uint64_t occupancy{0};      // Frames currently waiting for the consumer
+    uint64_t maxOccupancy{0};
+    uint64_t pushed{0};         // Frames accepted into the queue
+    uint64_t popped{0};         // Frames handed to the consumer
+    uint64_t droppedOldest{0};  // Queued frames discarded to make room (DropOldest)
+    uint64_t droppedNewest{0};  // Incoming frames discarded because the queue was full (DropNewest)
+    double averageOccupancy{0.0}; // Sampled on every push
+    double producerWaitMs{0.0};   // Total time the decoder spent blocked on a full queue (Block)
+    double consumerWaitMs{0.0};   // Total time the consumer spent waiting for frames
+};
+
+// Bounded single consumer queue between the decoder threads and the processing callback
+template <typename T>
+class FrameQueue {
+public:
+    enum class Policy { Block, DropOldest, DropNewest };
+
+    FrameQueue(size_t capacity, Policy policy) : m_capacity(capacity? capacity : 1), m_policy(policy) { m_stats.capacity = m_capacity; }
+
+    // Block only: waits until there's room or the queue is closed, so a producer can wait without holding its own locks
+    void waitForRoom() {
+        if (m_policy != Policy::Block) return;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_closed || m_items.size() < m_capacity) return;
+        const auto start = std::chrono::steady_clock::now();
+        m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+        m_stats.producerWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Returns false if the item was not queued, either dropped or the queue is closed.
+    // With `wait` false a full Block queue takes the item anyway, for producers which called waitForRoom() before
+    bool push(T &&item, bool wait = true) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_closed) return false;
+        if (m_items.size() >= m_capacity) {
+            switch (m_policy) {
+                case Policy::DropNewest:
+                    m_stats.droppedNewest++;
+                    return false;
+                case Policy::DropOldest:
+                    m_items.pop_front();
+                    m_stats.droppedOldest++;
+                    break;
+                case Policy::Block: {
+                    if (!wait) break;
+                    const auto start = std::chrono::steady_clock::now();
+                    m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+                    m_stats.producerWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    if (m_closed) return false;
+                } break;
+            }
+        }
+        m_items.push_back(std::move(item));
+        m_stats.pushed++;
+        m_occupancySum += m_items.size();
+        m_stats.maxOccupancy = std::max<uint64_t>(m_stats.maxOccupancy, m_items.size());
+        lock.unlock();
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks until an item is available. Returns false once the queue is closed and drained, or aborted
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_items.empty() && !m_closed) {
+            const auto start = std::chrono::steady_clock::now();
+            m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+            m_stats.consumerWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (m_items.empty()) return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_stats.popped++;
+        lock.unlock();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    // No more items will be accepted, the consumer still gets the queued ones
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+    // Like close(), but also discards the queued items
+    void abort() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_items.clear();
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+    FrameQueueStats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        FrameQueueStats ret = m_stats;
+        ret.occupancy = m_items.size();
+        ret.averageOccupancy = m_stats.pushed? double(m_occupancySum) / m_stats.pushed : 0.0;
+        return ret;
+    }
+
+private:
+    const size_t m_capacity;
+    const Policy m_policy;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::deque<T> m_items;
+    bool m_closed{false};
+
+    FrameQueueStats m_stats;
+    uint64_t m_occupancySum{0};
+};
+
+#endif
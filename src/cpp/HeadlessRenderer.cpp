@@ -0,0 +1,290 @@
+#include "HeadlessRenderer.h"
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <QOffscreenSurface>
+
+#include "mdk/Player.h"
+#include "mdk/RenderAPI.h"
+
+HeadlessRenderer::HeadlessRenderer() { }
+
+HeadlessRenderer::~HeadlessRenderer() {
+    stop();
+}
+
+bool HeadlessRenderer::start(const std::string &url, const QSize &size, bool stepping) {
+    stop();
+#if QT_CONFIG(opengl)
+    m_size = QSize(std::max(2, size.width()), std::max(2, size.height()));
+    m_stepping = stepping;
+    m_surface.reset(QRhiGles2InitParams::newFallbackSurface());
+    if (!m_surface) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_dirty = false;
+        m_stopping = false;
+        m_created = -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats = HeadlessStats();
+    }
+    m_playing = false;
+    m_ended = false;
+    m_fps = 0.0;
+
+    // No hardware decoders, their interop depends on the GPU and these jobs often run on software GL
+    m_player = PlayerPool::instance().acquire({ "BRAW:gpu=auto:copy=1", "R3D:gpu=auto", "FFmpeg" }, { });
+    m_player->setMute(true);
+    m_thread = std::thread([this, url] { run(url); });
+
+    bool created = false;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_created >= 0; });
+        created = m_created > 0;
+    }
+    if (!created) stop();
+    return created;
+#else
+    qDebug2("HeadlessRenderer::start") << "OpenGL support not compiled";
+    return false;
+#endif
+}
+
+// Must be called on the thread which called start(), the offscreen surface is destroyed here
+void HeadlessRenderer::stop() {
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+    m_playing = false;
+    m_player.reset(); // Goes back to the pool
+    m_surface.reset();
+}
+
+void HeadlessRenderer::run(std::string url) {
+    const bool created = createResources();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_created = created? 1 : 0;
+    }
+    m_cv.notify_all();
+    if (!created) {
+        releaseResources();
+        return;
+    }
+
+    auto player = m_player.get();
+    player->setRenderCallback([this](void *) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_dirty = true;
+        }
+        m_cv.notify_all();
+    });
+    player->onMediaStatusChanged([this](mdk::MediaStatus status) -> bool {
+        if (status & mdk::MediaStatus::End) {
+            m_ended = true;
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_stats.ended = true;
+        }
+        return true;
+    });
+    player->setMedia(url.c_str());
+    player->prepare(); // Renders the first frame
+    if (m_stepping) player->set(mdk::State::Paused); // Frames only advance through step()
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this] { return m_dirty || m_stopping; });
+        if (m_stopping) break;
+        m_dirty = false;
+        lock.unlock();
+        renderFrame();
+        lock.lock();
+    }
+    lock.unlock();
+
+    player->setRenderCallback([](void *) {});
+    player->onMediaStatusChanged(nullptr); // Removes the listener, the player outlives this renderer in the pool
+    player->set(mdk::State::Stopped);
+    player->waitFor(mdk::State::Stopped);
+    // The renderer's GL resources belong to our context, so they are released here and not on the pool thread
+    m_rhi->makeThreadLocalNativeContextCurrent();
+    player->setVideoSurfaceSize(-1, -1);
+    releaseResources();
+}
+
+// Render thread
+bool HeadlessRenderer::createResources() {
+#if QT_CONFIG(opengl)
+    QRhiGles2InitParams params;
+    params.fallbackSurface = m_surface.get();
+    m_rhi.reset(QRhi::create(QRhi::OpenGLES2, &params));
+    if (!m_rhi) {
+        qDebug2("HeadlessRenderer::createResources") << "Failed to create the OpenGL rhi";
+        return false;
+    }
+
+    m_texture.reset(m_rhi->newTexture(QRhiTexture::RGBA8, m_size, 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource));
+    if (!m_texture->create()) return false;
+
+    m_rt.reset(m_rhi->newTextureRenderTarget({ QRhiColorAttachment(m_texture.get()) }));
+    m_rtRp.reset(m_rt->newCompatibleRenderPassDescriptor());
+    m_rt->setRenderPassDescriptor(m_rtRp.get());
+    if (!m_rt->create()) return false;
+
+    m_rhi->makeThreadLocalNativeContextCurrent();
+    mdk::GLRenderAPI ra;
+    ra.fbo = static_cast<QGles2TextureRenderTarget *>(m_rt.get())->framebuffer;
+    m_player->setRenderAPI(&ra);
+    m_player->setVideoSurfaceSize(m_size.width(), m_size.height());
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Render thread. The rhi goes last, the other resources need it for their destruction
+void HeadlessRenderer::releaseResources() {
+    m_rt.reset();
+    m_rtRp.reset();
+    m_texture.reset();
+    m_rhi.reset();
+    m_readback = QRhiReadbackResult();
+}
+
+// Render thread
+void HeadlessRenderer::renderFrame() {
+    const auto started = std::chrono::steady_clock::now();
+
+    QRhiCommandBuffer *cb = nullptr;
+    if (m_rhi->beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess) return;
+
+    cb->beginPass(m_rt.get(), QColor(Qt::black), { 1.0f, 0 }, nullptr, QRhiCommandBuffer::ExternalContent);
+    cb->beginExternal();
+    const double timestamp = m_player->renderVideo();
+    cb->endExternal();
+    cb->endPass();
+
+    if (m_fps <= 0.0) {
+        const auto &info = m_player->mediaInfo();
+        if (!info.video.empty()) m_fps = info.video[0].codec.frame_rate;
+    }
+
+    const double timestampMs = timestamp * 1000.0;
+    double lastMs = -1.0;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        lastMs = m_stats.lastTimestampMs;
+    }
+    // The same frame is rendered again e.g. after a redraw request while paused, it's only processed once
+    const bool newFrame = timestamp >= 0 && timestampMs != lastMs;
+    const uint32_t frame = uint32_t(std::max(0.0, std::ceil(std::round(timestamp * m_fps * 100.0) / 100.0)));
+
+    ProcessTextureCb processTexture;
+    ProcessPixelsInPlaceCb processPixelsInPlace;
+    {
+        std::lock_guard<std::mutex> lock(m_cbMutex);
+        processTexture = m_processTexture;
+        processPixelsInPlace = m_processPixelsInPlace;
+    }
+
+    bool processed = false;
+    if (newFrame && processTexture) {
+#if QT_CONFIG(opengl)
+        auto handles = static_cast<const QRhiGles2NativeHandles *>(m_rhi->nativeHandles());
+        processed = processTexture(nullptr, frame, timestampMs, m_size.width(), m_size.height(), 1, m_texture->nativeTexture().object, uint64_t(handles->context), 0, 0, 0);
+#endif
+    }
+    bool readback = false;
+    if (newFrame && !processed && processPixelsInPlace) {
+        QRhiResourceUpdateBatch *u = m_rhi->nextResourceUpdateBatch();
+        u->readBackTexture({ m_texture.get() }, &m_readback);
+        cb->resourceUpdate(u);
+        readback = true;
+    }
+    m_rhi->endOffscreenFrame(); // Waits for the GPU, the readback is complete after this
+
+    if (readback && !m_readback.data.isEmpty()) {
+        const QSize size = m_readback.pixelSize;
+        const size_t stride = size_t(size.width()) * 4;
+        auto bits = reinterpret_cast<uint8_t *>(m_readback.data.data());
+        if (m_rhi->isYUpInFramebuffer()) {
+            for (int y = 0; y < size.height() / 2; ++y) {
+                std::swap_ranges(bits + y * stride, bits + (y + 1) * stride, bits + (size.height() - 1 - y) * stride);
+            }
+        }
+        processPixelsInPlace(nullptr, frame, timestampMs, size.width(), size.height(), uint32_t(stride), bits, m_readback.data.size());
+        processed = true;
+    }
+
+    if (timestamp >= 0 && !newFrame && m_stepping && m_playing && m_fps > 0.0) {
+        // Stepping didn't produce another frame
+        const double durationMs = double(m_player->mediaInfo().duration);
+        if (durationMs > 0.0 && timestampMs + 1000.0 / m_fps >= durationMs) m_ended = true;
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        if (newFrame) {
+            m_stats.renderedFrames++;
+            m_stats.lastTimestampMs = timestampMs;
+            m_stats.frameMs = m_stats.renderedFrames == 1? ms : 0.9 * m_stats.frameMs + 0.1 * ms;
+        }
+        if (processed) m_stats.processedFrames++;
+        m_stats.ended = m_ended;
+    }
+
+    if (newFrame && m_stepping && m_playing && !m_ended) step();
+}
+
+// The next frame is decoded only now, so the decoder never gets ahead of the renderer
+void HeadlessRenderer::step() {
+    if (m_player) m_player->seek(1, mdk::SeekFlag::FromNow | mdk::SeekFlag::Frame);
+}
+
+void HeadlessRenderer::play() {
+    if (!m_player) return;
+    m_playing = true;
+    if (!m_stepping) {
+        m_player->set(mdk::State::Playing);
+        return;
+    }
+    // Before the first frame, the render thread starts stepping once it's there
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    if (m_stats.renderedFrames > 0 && !m_ended) step();
+}
+
+void HeadlessRenderer::pause() {
+    m_playing = false;
+    if (m_player && !m_stepping) m_player->set(mdk::State::Paused);
+}
+
+void HeadlessRenderer::seek(double timestampMs) {
+    if (!m_player) return;
+    m_ended = false;
+    m_player->seek(int64_t(timestampMs), mdk::SeekFlag::FromStart);
+}
+
+void HeadlessRenderer::setProcessTextureCallback(ProcessTextureCb &&cb) {
+    std::lock_guard<std::mutex> lock(m_cbMutex);
+    m_processTexture = cb;
+}
+void HeadlessRenderer::setProcessPixelsInPlaceCallback(ProcessPixelsInPlaceCb &&cb) {
+    std::lock_guard<std::mutex> lock(m_cbMutex);
+    m_processPixelsInPlace = cb;
+}
+
+HeadlessStats HeadlessRenderer::stats() const {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+}
@@ -0,0 +1,94 @@
+#ifndef HEADLESS_RENDERER_H
+#define HEADLESS_RENDERER_H
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <QtCore/QSize>
+#include "MDKPlayer.h"
+
+class QOffscreenSurface;
+
+// Must match `HeadlessStats` in video_player.rs
+struct HeadlessStats {
+    uint64_t renderedFrames{0};
+    uint64_t processedFrames{0}; // Delivered to the texture or pixels callback
+    double lastTimestampMs{-1.0};
+    double frameMs{0.0};         // Moving average of render and processing time per frame
+    bool ended{false};           // End of the file
+};
+
+// Renders a file into an offscreen texture without any window, item or scene graph, e.g. for exports on a render farm or CI jobs.
+// The renderer owns its QRhi on an offscreen OpenGL surface (works on llvmpipe) and a thread which renders every frame mdk hands out,
+// then calls the same processTexture and processPixelsInPlace hooks as the items, with a null item.
+// In stepping mode the decoder waits for the renderer, so every frame of the file is rendered exactly once regardless of how long processing takes
+class HeadlessRenderer {
+public:
+    HeadlessRenderer();
+    ~HeadlessRenderer();
+
+    // Creates the offscreen surface, so it has to be called on the GUI thread of a QGuiApplication. The rhi and the GL context live on the render thread.
+    // Returns false if the rhi or the render target can't be created
+    bool start(const std::string &url, const QSize &size, bool stepping);
+    void stop();
+
+    void play();
+    void pause();
+    void seek(double timestampMs);
+
+    // `item` is always null. On OpenGL `backend_id` is 1, `ptr1` the texture and `ptr2` the QOpenGLContext, which is current during the call
+    void setProcessTextureCallback(ProcessTextureCb &&cb);
+    // The pixels are RGBA with the top row first, valid only during the call. The return value is ignored, nothing is displayed
+    void setProcessPixelsInPlaceCallback(ProcessPixelsInPlaceCb &&cb);
+
+    HeadlessStats stats() const;
+
+private:
+    void run(std::string url);
+    bool createResources();
+    void releaseResources();
+    void renderFrame();
+    void step();
+
+    std::shared_ptr<mdk::Player> m_player;
+    std::unique_ptr<QOffscreenSurface> m_surface;
+    QSize m_size;
+    bool m_stepping{false};
+
+    // Render thread only
+    std::unique_ptr<QRhi> m_rhi;
+    std::unique_ptr<QRhiTexture> m_texture;
+    std::unique_ptr<QRhiTextureRenderTarget> m_rt;
+    std::unique_ptr<QRhiRenderPassDescriptor> m_rtRp;
+    QRhiReadbackResult m_readback;
+    double m_fps{0.0};
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_dirty{false};
+    bool m_stopping{false};
+    int m_created{-1}; // -1 while the render thread sets up, then 0 or 1
+
+    std::mutex m_cbMutex;
+    ProcessTextureCb m_processTexture;
+    ProcessPixelsInPlaceCb m_processPixelsInPlace;
+
+    std::atomic<bool> m_playing{false};
+    std::atomic<bool> m_ended{false};
+    mutable std::mutex m_statsMutex;
+    HeadlessStats m_stats;
+};
+
+class HeadlessRendererWrapper {
+public:
+    HeadlessRendererWrapper() { renderer = new HeadlessRenderer(); }
+    ~HeadlessRendererWrapper() { delete renderer; }
+    HeadlessRenderer *renderer{nullptr};
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <string>
 #include <thread>
 #include <QTimer>
+#include <QRunnable>
 #include <QJsonArray>
 #include <QGuiApplication>
 #if __has_include(<QX11Info>)
@@ -35,20 +36,29 @@ MDKPlayer::MDKPlayer() {
 }
 
 void MDKPlayer::initPlayer() {
-    m_player = std::make_unique<mdk::Player>();
     m_metadata = QJsonObject();
     m_shuttingDown = false;
 
+    std::atomic_store(&m_player, acquirePlayer());
+
+    if (m_item && m_node && m_window) {
+        setupPlayer();
+        if (m_size.width() > 0 && m_size.height() > 0) {
+            m_syncNext = true;
+        }
+    }
+}
+
+std::shared_ptr<mdk::Player> MDKPlayer::acquirePlayer() {
     QString overrideDecoders = QString(qgetenv("MDK_DECODERS")).trimmed();
 
+    std::vector<std::string> decoders;
     if (!overrideDecoders.isEmpty()) {
-        std::vector<std::string> vec;
         for (const auto &x : overrideDecoders.split(",")) {
-            vec.push_back(toStdString(x));
+            decoders.push_back(toStdString(x));
         }
-        m_player->setDecoders(mdk::MediaType::Video, vec);
     } else {
-        m_player->setDecoders(mdk::MediaType::Video, {
+        decoders = {
     #if (__APPLE__+0)
         "VT:duration=0",
     #elif (__ANDROID__+0)
@@ -67,33 +77,91 @@ void MDKPlayer::initPlayer() {
     #endif
         "BRAW:gpu=auto:copy=1:scale=1920x1080",
         "R3D:gpu=auto:scale=1920x1080",
-        "FFmpeg"});
+        "FFmpeg"};
     }
 
-    if (m_item && m_node && m_window) {
-        setupPlayer();
-        if (m_size.width() > 0 && m_size.height() > 0) {
-            m_syncNext = true;
-        }
+    std::vector<std::pair<std::string, std::string>> properties;
+    for (auto it = m_defaultProperties.constBegin(); it != m_defaultProperties.constEnd(); ++it) {
+        properties.emplace_back(toStdString(it.key()), toStdString(it.value()));
+    }
+    return PlayerPool::instance().acquire(decoders, properties);
+}
+
+// The renderer's graphics resources belong to the window's context, so they are released on the render thread with the context current.
+// The job holds the last reference, the player goes back to the pool after it ran. Without a window the player isn't reused
+void MDKPlayer::releaseRenderer(std::shared_ptr<mdk::Player> player) {
+    struct ReleaseJob : QRunnable {
+        std::shared_ptr<mdk::Player> player;
+        void *vo{nullptr};
+        void run() override { player->setVideoSurfaceSize(-1, -1, vo); }
+    };
+    if (!m_window) {
+        PlayerPool::markDirty(player);
+        return;
     }
+    auto job = new ReleaseJob();
+    job->player = std::move(player);
+    job->vo = vo();
+    m_window->scheduleRenderJob(job, QQuickWindow::NoStage);
 }
+
+// The windowBeforeRendering connection is gone, so the textures of the cleared frame cache are handed to a render job.
+// Without a window nothing renders with them anymore
+void MDKPlayer::releaseFrameCacheTextures() {
+    struct ReleaseJob : QRunnable {
+        std::vector<QRhiTexture *> textures;
+        void run() override { for (auto tex : textures) tex->deleteLater(); }
+    };
+    auto textures = m_frameCache.takeRetired();
+    if (textures.empty()) return;
+    if (!m_window) {
+        for (auto tex : textures) tex->deleteLater();
+        return;
+    }
+    auto job = new ReleaseJob();
+    job->textures = std::move(textures);
+    m_window->scheduleRenderJob(job, QQuickWindow::NoStage);
+}
+
 void MDKPlayer::destroyPlayer() {
     m_shuttingDown = true; // Signal render thread to stop before any cleanup
     m_videoLoaded = false;
+    m_loadHandled = false;
     m_firstFrameLoaded = false;
+    m_schedulerPaused = false;
+    m_decodeLevel = DecodeLevel::Full;
+    m_surfaceCap = QSize();
     if (m_connectionBeforeRendering) QObject::disconnect(m_connectionBeforeRendering);
     if (m_connectionScreenChanged) QObject::disconnect(m_connectionScreenChanged);
 
-    if (m_player) {
+    resetFrameCache();
+    releaseFrameCacheTextures();
+    leaveReverse(false);
+    // A seek of the old player may never call back, it must not keep the next one's scrub seeks waiting
+    std::atomic_store(&m_seekState, std::make_shared<SeekState>());
+    m_scrubPending = false;
+    m_scrubTarget = -1.0;
+    std::atomic_store(&m_frameIndex, std::shared_ptr<FrameIndex>());
+    std::atomic_store(&m_mediaInfo, std::shared_ptr<const MediaInfoSnapshot>());
+
+    if (m_source) {
+        // Only this view goes away, the player keeps its callbacks and state for the other items
+        m_source->detach(this);
+        releaseRenderer(std::atomic_exchange(&m_player, std::shared_ptr<mdk::Player>())); // Our output only
+        m_source.reset();
+        m_sourceCreated = false;
+    } else if (m_player) {
         stop();
         m_player->setRenderCallback([](void *) {});
-        m_player->onMediaStatusChanged([](mdk::MediaStatus) -> bool { return false; });
         m_player->onStateChanged([](mdk::State) {});
-        m_player->onEvent([](const mdk::MediaEvent &) -> bool { return false; });
         m_player->onFrame<mdk::VideoFrame>([](mdk::VideoFrame&, int) -> int { return 0; });
-        auto ptr = m_player.release();
-        QTimer::singleShot(1000, [ptr] { delete ptr; }); // delete later
+        // These add listeners, null removes them. A no-op callback would leave ours registered on the pooled player
+        m_player->onMediaStatusChanged(nullptr);
+        m_player->onEvent(nullptr);
+        // Goes back to the pool once the render thread is done with it, see windowBeforeRendering()
+        releaseRenderer(std::atomic_exchange(&m_player, std::shared_ptr<mdk::Player>()));
     }
+    m_bufferedRanges.clear();
 }
 
 MDKPlayer::~MDKPlayer() {
@@ -101,25 +169,29 @@ MDKPlayer::~MDKPlayer() {
     m_videoLoaded = false;
     m_firstFrameLoaded = false;
     m_processPixels = nullptr;
+    m_processPixelsInPlace = nullptr;
     m_processTexture = nullptr;
     m_readyForProcessing = nullptr;
     m_item = nullptr;
-    m_window = nullptr;
+    if (m_decodeClient) DecodeScheduler::instance().remove(m_decodeClient);
 
     if (m_userDataDestructor && m_userData) { m_userDataDestructor(m_userData); m_userData = nullptr; }
     if (m_userData2Destructor && m_userData2) { m_userData2Destructor(m_userData2); m_userData2 = nullptr; }
 
-    destroyPlayer();
+    destroyPlayer(); // Still needs the window to release the renderer
+    m_window = nullptr;
 }
 
 void MDKPlayer::setProperty(const QString &key, const QString &value) {
     if (m_player) {
+        PlayerPool::markDirty(m_player);
         m_player->setProperty(toStdString(key), toStdString(value));
     }
 }
 
 void MDKPlayer::setDefaultProperty(const QString &key, const QString &value) {
     if (m_player) {
+        PlayerPool::markDirty(m_player); // Not part of the configuration it was acquired with
         m_player->setProperty(toStdString(key), toStdString(value));
     }
     m_defaultProperties.insert(key, value);
@@ -135,9 +207,22 @@ void MDKPlayer::setUrl(const QUrl &url, const QString &customDecoder) {
     if (url.toString().contains("http://") || url.toString().contains("https://")) {
         m_isHttp = true;
     }
+
+    if (m_shareSource) {
+        attachSharedSource(url, customDecoder);
+        return;
+    }
+    if (m_nextPlayer && url == m_nextUrl && customDecoder == m_nextCustomDecoder) {
+        takeNextPlayer();
+        return;
+    }
+
     destroyPlayer();
     initPlayer();
+    openMedia(m_player, url, customDecoder);
+}
 
+void MDKPlayer::openMedia(const std::shared_ptr<mdk::Player> &player, const QUrl &url, const QString &customDecoder) {
     QString additionalUrl;
     if (!customDecoder.isEmpty()) {
         qDebug2("setUrl") << "MDK decoder:" << customDecoder;
@@ -145,7 +230,8 @@ void MDKPlayer::setUrl(const QUrl &url, const QString &customDecoder) {
             additionalUrl = "?mdkopt=avformat&" + customDecoder.mid(24);
         } else if (customDecoder.startsWith("headers:")) {
             qDebug2("setUrl") << "Setting custom HTTP headers:" << customDecoder.mid(8);
-            m_player->setProperty("avio.headers", customDecoder.mid(8).toStdString());
+            PlayerPool::markDirty(player);
+            player->setProperty("avio.headers", customDecoder.mid(8).toStdString());
         }
     }
 
@@ -162,14 +248,122 @@ void MDKPlayer::setUrl(const QUrl &url, const QString &customDecoder) {
         }
     }
     qDebug2("setUrl") << "Final url:" << path;
-    m_player->setMedia(qUtf8Printable(path));
-    m_player->prepare();
+    player->setMedia(qUtf8Printable(path));
+    player->prepare();
+}
+
+void MDKPlayer::setNextUrl(const QUrl &url, const QString &customDecoder) {
+    if (m_nextPlayer && url == m_nextUrl && customDecoder == m_nextCustomDecoder) return;
+
+    m_nextPlayer.reset();
+    m_nextUrl = url;
+    m_nextCustomDecoder = customDecoder;
+    if (url.isEmpty()) return;
+
+    // Opened and prepared up to the first frame now, it only gets callbacks and a render target when setUrl() takes it
+    m_nextPlayer = acquirePlayer();
+    m_nextPlayer->setMute(true);
+    openMedia(m_nextPlayer, url, customDecoder);
+}
+
+// Swaps in the preloaded player. The texture is kept and the render API is pointed at it in the next sync(),
+// so the previous clip stays on screen until the first frame of the new one replaces it
+void MDKPlayer::takeNextPlayer() {
+    const bool muted = m_player? m_player->isMute() : false;
+    const float volume = m_player? m_player->volume() : 1.0f;
+
+    destroyPlayer();
+    m_metadata = QJsonObject();
+    m_shuttingDown = false;
+    m_nextUrl = QUrl();
+    std::atomic_store(&m_player, std::move(m_nextPlayer));
+    m_player->setMute(muted);
+    m_player->setVolume(volume);
+
+    if (!m_item || !m_node || !m_window) return;
+    setupPlayer();
+    m_syncNext = false;
+    m_rebindNext = true;
+
+    catchUpLoadedMedia();
+}
+
+// The player was prepared before our callbacks were set, so the events which load the media may have been missed
+void MDKPlayer::catchUpLoadedMedia() {
+    const auto status = m_player->mediaStatus();
+    if ((status & mdk::MediaStatus::Loaded) && (status & mdk::MediaStatus::Prepared)) {
+        onMediaLoaded();
+        const auto info = mediaInfo();
+        if (info && info->summary.hasVideo) {
+            m_metadata = metadataJson(*info);
+            QMetaObject::invokeMethod(m_item, "metadataLoaded", Qt::QueuedConnection, Q_ARG(QJsonObject, m_metadata));
+            m_firstFrameLoaded = true;
+        }
+    }
+    QMetaObject::invokeMethod(m_item, "update");
+}
+
+void MDKPlayer::setDecodePriority(int priority) {
+    m_decodePriority = priority;
+    if (m_decodeClient) DecodeScheduler::instance().setPriority(m_decodeClient, priority);
+}
+
+void MDKPlayer::applyDecodeLevel(DecodeLevel level, const QSize &surfaceCap) {
+    if (!m_player) return;
+
+    if ((level == DecodeLevel::Reduced) != (m_decodeLevel == DecodeLevel::Reduced)) {
+        // FFmpeg decoder option, applied to the running decoder
+        PlayerPool::markDirty(m_player);
+        m_player->setProperty("video.decoder", level == DecodeLevel::Reduced? "skip_frame=noref" : "skip_frame=default");
+    }
+    if (level == DecodeLevel::Paused && m_decodeLevel != DecodeLevel::Paused && m_userPlaying && !m_cacheServing) {
+        m_schedulerPaused = true;
+        m_player->set(mdk::PlaybackState::Paused);
+    } else if (level != DecodeLevel::Paused && m_schedulerPaused) {
+        m_schedulerPaused = false;
+        if (m_userPlaying) m_player->set(mdk::PlaybackState::Playing);
+        forceRedraw();
+    }
+    m_decodeLevel = level;
+
+    if (surfaceCap != m_surfaceCap) {
+        m_surfaceCap = surfaceCap;
+        m_syncNext = true; // Reallocates the texture at the new size
+        QMetaObject::invokeMethod(m_item, "update");
+    }
+}
+
+void MDKPlayer::setSourceSharing(bool enabled) {
+    m_shareSource = enabled;
+}
+
+void MDKPlayer::attachSharedSource(const QUrl &url, const QString &customDecoder) {
+    destroyPlayer();
+    m_metadata = QJsonObject();
+    m_shuttingDown = false;
+
+    bool created = false;
+    m_source = SharedSource::attach(toStdString(url.toString() + "\n" + customDecoder), this, [&] {
+        auto player = acquirePlayer();
+        openMedia(player, url, customDecoder);
+        return player;
+    }, created);
+    m_sourceCreated = created;
+    std::atomic_store(&m_player, m_source->player());
+    if (!created) {
+        const float rate = m_player->playbackRate();
+        if (m_playbackRate >= 0.0f) m_playbackRate = rate; // Follow the playback of the other views
+    }
+
+    if (!m_item || !m_node || !m_window) return;
+    setupPlayer();
+    if (!created) catchUpLoadedMedia();
 }
 
 void MDKPlayer::setBackgroundColor(const QColor &color) {
     m_bgColor = color;
     if (m_player)
-        m_player->setBackgroundColor(m_bgColor.redF(), m_bgColor.greenF(), m_bgColor.blueF(), m_bgColor.alphaF());
+        m_player->setBackgroundColor(m_bgColor.redF(), m_bgColor.greenF(), m_bgColor.blueF(), m_bgColor.alphaF(), vo());
     forceRedraw();
 }
 
@@ -188,6 +382,24 @@ void MDKPlayer::setupNode(QSGImageNode *node, QQuickItem *item) {
     m_window = item? item->window() : nullptr;
     if (!m_window) return;
     node->setOwnsTexture(true);
+    if (!m_itemMethods.frameRendered.isValid()) {
+        const QMetaObject *mo = item->metaObject();
+        m_itemMethods.frameRendered     = mo->method(mo->indexOfMethod("frameRendered(double,int)"));
+        m_itemMethods.stateChanged      = mo->method(mo->indexOfMethod("stateChanged(int)"));
+        m_itemMethods.setBuffering      = mo->method(mo->indexOfMethod("setBuffering(bool)"));
+        m_itemMethods.setBufferedRanges = mo->method(mo->indexOfMethod("setBufferedRanges(QJsonArray)"));
+    }
+    if (!m_decodeClient) {
+        m_decodeClient = DecodeScheduler::instance().add({
+            item, m_decodePriority,
+            [this] { return m_videoLoaded && m_player && !m_source && m_fps > 0.0; },
+            [this] {
+                const auto info = mediaInfo();
+                return m_player && info && info->summary.hasAudio && !m_player->isMute() && m_player->volume() > 0.0f;
+            },
+            [this](DecodeLevel level, const QSize &surfaceCap) { applyDecodeLevel(level, surfaceCap); }
+        });
+    }
     if (!m_pendingUrl.isEmpty()) {
         setUrl(m_pendingUrl, m_pendingCustomDecoder);
         m_pendingUrl = QUrl();
@@ -199,6 +411,9 @@ void MDKPlayer::setupNode(QSGImageNode *node, QQuickItem *item) {
 void MDKPlayer::setProcessPixelsCallback(ProcessPixelsCb &&cb) {
     m_processPixels = cb;
 }
+void MDKPlayer::setProcessPixelsInPlaceCallback(ProcessPixelsInPlaceCb &&cb) {
+    m_processPixelsInPlace = cb;
+}
 void MDKPlayer::setProcessTextureCallback(ProcessTextureCb &&cb) {
     m_processTexture = cb;
 }
@@ -206,8 +421,13 @@ void MDKPlayer::setReadyForProcessingCallback(ReadyForProcessingCb &&cb) {
     m_readyForProcessing = cb;
 }
 
+void MDKPlayer::setReadbackDepth(int depth) {
+    m_readbackDepth = std::max(0, depth);
+    m_readbackLatencyFrames = 0;
+    m_readbackLatencyMs = 0.0;
+}
+
 void MDKPlayer::setupPlayer() {
-    m_player->setRenderCallback([this](void *) { QMetaObject::invokeMethod(m_item, "update"); });
     m_player->setProperty("continue_at_end", "1");
     if (!m_isHttp) {
         m_player->setBufferRange(0);
@@ -215,181 +435,240 @@ void MDKPlayer::setupPlayer() {
     for (auto it = m_defaultProperties.constBegin(); it != m_defaultProperties.constEnd(); ++it) {
         m_player->setProperty(toStdString(it.key()), toStdString(it.value()));
     }
-    m_player->onEvent([this](const mdk::MediaEvent &evt) -> bool {
-        if (evt.category == "metadata") {
-            auto md = m_player->mediaInfo();
-            QJsonObject obj;
-            for (const auto &x : getMediaInfo(md)) {
-                obj.insert(QString::fromUtf8(x.first.c_str(), x.first.size()), QString::fromUtf8(x.second.c_str(), x.second.size()));
-            }
-            m_metadata = obj;
-        }
-        if (evt.detail == "size") {
-            QMetaObject::invokeMethod(m_item, "metadataLoaded", Qt::QueuedConnection, Q_ARG(QJsonObject, m_metadata));
 
-            m_firstFrameLoaded = true;
-        }
-        qDebug2("m_player->onEvent") << QString::fromUtf8(evt.category.c_str(), evt.category.size()) << QString::fromUtf8(evt.detail.c_str(), evt.detail.size());
-        return true;
-    });
+    m_player->setBackgroundColor(m_bgColor.redF(), m_bgColor.greenF(), m_bgColor.blueF(), m_bgColor.alphaF(), vo());
+    if (!m_source || m_sourceCreated) {
+        m_player->setPlaybackRate(m_playbackRate >= 0.0f? m_playbackRate : 1.0f); // Reverse playback starts with play()
+    }
 
-    m_player->setBackgroundColor(m_bgColor.redF(), m_bgColor.greenF(), m_bgColor.blueF(), m_bgColor.alphaF());
-    m_player->setPlaybackRate(m_playbackRate);
+    if (m_source) {
+        m_source->setCallbacks(this, {
+            [this] { onRenderRequested(); },
+            [this](const mdk::MediaEvent &evt) { return onPlayerEvent(evt); },
+            [this](mdk::State state) { onPlayerStateChanged(state); },
+            [this](mdk::MediaStatus status) { return onPlayerMediaStatus(status); }
+        });
+    } else {
+        m_player->setRenderCallback([this](void *) { onRenderRequested(); });
+        m_player->onEvent([this](const mdk::MediaEvent &evt) -> bool { return onPlayerEvent(evt); });
+        m_player->onStateChanged([this](mdk::State state) { onPlayerStateChanged(state); });
+        m_player->onMediaStatusChanged([this](mdk::MediaStatus status) -> bool { return onPlayerMediaStatus(status); });
+    }
 
-    m_player->onStateChanged([this](mdk::State state) {
-        // qDebug2("m_player->onStateChanged") <<
-        //     QString(state == mdk::State::NotRunning?  "NotRunning"  : "") +
-        //     QString(state == mdk::State::Running?     "Running"     : "") +
-        //     QString(state == mdk::State::Paused?      "Paused"      : "");
+    /*m_player->onFrame<mdk::VideoFrame>([this](mdk::VideoFrame &frame, int track) -> int {
+        //QMetaObject::invokeMethod(m_item, "frameRendered", Q_ARG(double, frame.timestamp() * 1000.0));
+        // qDebug2("m_player->onFrame") << "frame" << track << frame.timestamp() << (int)frame.format() << frame.planeCount() << frame.bufferData(0);
+        return 0;
+    });*/
 
-        QMetaObject::invokeMethod(m_item, "stateChanged", Q_ARG(int, int(state)));
-    });
+    if (m_size.width() > 0 && m_size.height() > 0) {
+        m_player->setVideoSurfaceSize(m_size.width(), m_size.height(), vo());
+        m_syncNext = true;
+    }
+    forceRedraw();
+}
 
-    m_player->onMediaStatusChanged([this](mdk::MediaStatus status) -> bool {
-        if (!m_player) return false;
+void MDKPlayer::onRenderRequested() {
+    m_renderDirty = true;
+    QMetaObject::invokeMethod(m_item, "update");
+}
 
-        if (status & mdk::MediaStatus::Buffering) {
-            QMetaObject::invokeMethod(m_item, "setBuffering", Q_ARG(bool, true));
-        } else if ((status & mdk::MediaStatus::Buffered) && !(status & mdk::MediaStatus::Seeking)) {
-            QJsonArray ranges;
-            auto br = m_player->bufferedTimeRanges();
-            for (const auto &r : br) {
-                QJsonObject obj;
-                obj.insert("start", QJsonValue(double(r.start)));
-                obj.insert("end",   QJsonValue(double(r.end)));
-                ranges.append(obj);
-            }
-            QMetaObject::invokeMethod(m_item, "setBufferedRanges", Q_ARG(QJsonArray, ranges));
-            QMetaObject::invokeMethod(m_item, "setBuffering", Q_ARG(bool, false));
-        }
-        // qDebug2("m_player->onMediaStatusChanged") <<
-        //     QString(status & mdk::MediaStatus::Unloaded?  "Unloaded | "  : "") +
-        //     QString(status & mdk::MediaStatus::Loading?   "Loading | "   : "") +
-        //     QString(status & mdk::MediaStatus::Loaded?    "Loaded | "    : "") +
-        //     QString(status & mdk::MediaStatus::Prepared?  "Prepared | "  : "") +
-        //     QString(status & mdk::MediaStatus::Stalled?   "Stalled | "   : "") +
-        //     QString(status & mdk::MediaStatus::Buffering? "Buffering | " : "") +
-        //     QString(status & mdk::MediaStatus::Buffered?  "Buffered | "  : "") +
-        //     QString(status & mdk::MediaStatus::End?       "End | "       : "") +
-        //     QString(status & mdk::MediaStatus::Seeking?   "Seeking | "   : "") +
-        //     QString(status & mdk::MediaStatus::Invalid?   "Invalid | "   : "");
-
-        if (!m_videoLoaded && (status & mdk::MediaStatus::Loaded) && (status & mdk::MediaStatus::Prepared)) {
-            auto md = m_player->mediaInfo();
-
-            /*QJsonObject obj;
-            for (const auto &x : getMediaInfo(md)) {
-                obj.insert(QString::fromStdString(x.first), QString::fromStdString(x.second));
-            }
-            QMetaObject::invokeMethod(m_item, "metadataLoaded", Q_ARG(QJsonObject, obj));*/
+bool MDKPlayer::onPlayerEvent(const mdk::MediaEvent &evt) {
+    if (evt.category == "metadata") {
+        refreshMediaInfo();
+        if (const auto info = mediaInfo()) m_metadata = metadataJson(*info);
+    }
+    if (evt.detail == "size") {
+        QMetaObject::invokeMethod(m_item, "metadataLoaded", Qt::QueuedConnection, Q_ARG(QJsonObject, m_metadata));
 
-            if (!md.video.empty()) {
-                auto v = md.video[0];
-                if (!v.frames && v.duration > 0 && v.codec.frame_rate > 0) {
-                    v.frames = (double(v.duration) / 1000.0) * v.codec.frame_rate;
-                }
-                m_fps = v.codec.frame_rate;
-                double fps = m_fps;
-                m_duration = v.duration;
-                if (m_overrideFps > 0.0) {
-                    m_duration *= m_fps / m_overrideFps;
-                    fps = m_overrideFps;
-                }
+        m_firstFrameLoaded = true;
+    }
+    qDebug2("m_player->onEvent") << QString::fromUtf8(evt.category.c_str(), evt.category.size()) << QString::fromUtf8(evt.detail.c_str(), evt.detail.size());
+    return true;
+}
 
-                QMetaObject::invokeMethod(m_item, "videoLoaded", Q_ARG(double, m_duration), Q_ARG(qlonglong, v.frames), Q_ARG(double, fps), Q_ARG(uint, v.codec.width), Q_ARG(uint, v.codec.height));
-            } else if (!md.audio.empty()) {
-                auto a = md.audio[0];
-                m_duration = a.duration;
-                m_fps = 0;
+void MDKPlayer::onPlayerStateChanged(mdk::State state) {
+    // qDebug2("m_player->onStateChanged") <<
+    //     QString(state == mdk::State::NotRunning?  "NotRunning"  : "") +
+    //     QString(state == mdk::State::Running?     "Running"     : "") +
+    //     QString(state == mdk::State::Paused?      "Paused"      : "");
 
-                QMetaObject::invokeMethod(m_item, "videoLoaded", Q_ARG(double, m_duration), Q_ARG(qlonglong, 0), Q_ARG(double, 0), Q_ARG(uint, 0), Q_ARG(uint, 0));
-                QMetaObject::invokeMethod(m_item, "metadataLoaded", Qt::QueuedConnection, Q_ARG(QJsonObject, m_metadata));
-                QMetaObject::invokeMethod(m_item, "update");
-                m_firstFrameLoaded = true;
-            }
-            m_player->setLoop(9999999);
-            m_videoLoaded = true;
+    if (m_cacheServing || m_schedulerPaused) return; // Paused by us, the item still shows the user's state
 
-            if (!m_connectionBeforeRendering)
-                m_connectionBeforeRendering = QObject::connect(m_window, &QQuickWindow::beforeRendering, [this] { this->windowBeforeRendering(); });
-            if (!m_connectionScreenChanged)
-                m_connectionScreenChanged = QObject::connect(m_window, &QQuickWindow::screenChanged, [this](QScreen *) { m_item->update(); });
+    notifyState(state);
+}
+
+bool MDKPlayer::onPlayerMediaStatus(mdk::MediaStatus status) {
+    const auto player = std::atomic_load(&m_player);
+    if (!player) return false;
+
+    QQuickItem *item = m_item;
+    if (status & mdk::MediaStatus::Buffering) {
+        if (m_playbackState.setBuffering(true) && item) m_itemMethods.setBuffering.invoke(item, Qt::QueuedConnection, Q_ARG(bool, true));
+    } else if ((status & mdk::MediaStatus::Buffered) && !(status & mdk::MediaStatus::Seeking)) {
+        std::vector<std::pair<int64_t, int64_t>> ranges;
+        for (const auto &r : player->bufferedTimeRanges()) {
+            ranges.emplace_back(r.start, r.end);
         }
-        if (status & mdk::MediaStatus::Invalid) {
-            QMetaObject::invokeMethod(m_item, "videoLoaded", Q_ARG(double, 0), Q_ARG(qlonglong, 0), Q_ARG(double, 0), Q_ARG(uint, 0), Q_ARG(uint, 0));
-            QMetaObject::invokeMethod(m_item, "metadataLoaded", Q_ARG(QJsonObject, QJsonObject()));
+        // The item only hears about ranges which changed, the json is built for those alone
+        if (ranges != m_bufferedRanges && item) {
+            m_bufferedRanges = ranges;
+            QJsonArray json;
+            for (const auto &r : ranges) {
+                QJsonObject obj;
+                obj.insert("start", QJsonValue(double(r.first)));
+                obj.insert("end",   QJsonValue(double(r.second)));
+                json.append(obj);
+            }
+            m_itemMethods.setBufferedRanges.invoke(item, Qt::QueuedConnection, Q_ARG(QJsonArray, json));
         }
+        if (m_playbackState.setBuffering(false) && item) m_itemMethods.setBuffering.invoke(item, Qt::QueuedConnection, Q_ARG(bool, false));
+    }
+    // qDebug2("m_player->onMediaStatusChanged") <<
+    //     QString(status & mdk::MediaStatus::Unloaded?  "Unloaded | "  : "") +
+    //     QString(status & mdk::MediaStatus::Loading?   "Loading | "   : "") +
+    //     QString(status & mdk::MediaStatus::Loaded?    "Loaded | "    : "") +
+    //     QString(status & mdk::MediaStatus::Prepared?  "Prepared | "  : "") +
+    //     QString(status & mdk::MediaStatus::Stalled?   "Stalled | "   : "") +
+    //     QString(status & mdk::MediaStatus::Buffering? "Buffering | " : "") +
+    //     QString(status & mdk::MediaStatus::Buffered?  "Buffered | "  : "") +
+    //     QString(status & mdk::MediaStatus::End?       "End | "       : "") +
+    //     QString(status & mdk::MediaStatus::Seeking?   "Seeking | "   : "") +
+    //     QString(status & mdk::MediaStatus::Invalid?   "Invalid | "   : "");
+
+    if (!m_videoLoaded && (status & mdk::MediaStatus::Loaded) && (status & mdk::MediaStatus::Prepared)) {
+        onMediaLoaded();
+    }
+    if (status & mdk::MediaStatus::Invalid) {
+        QMetaObject::invokeMethod(m_item, "videoLoaded", Q_ARG(double, 0), Q_ARG(qlonglong, 0), Q_ARG(double, 0), Q_ARG(uint, 0), Q_ARG(uint, 0));
+        QMetaObject::invokeMethod(m_item, "metadataLoaded", Q_ARG(QJsonObject, QJsonObject()));
+    }
 
-        return true;
-    });
+    return true;
+}
 
-    /*m_player->onFrame<mdk::VideoFrame>([this](mdk::VideoFrame &frame, int track) -> int {
-        //QMetaObject::invokeMethod(m_item, "frameRendered", Q_ARG(double, frame.timestamp() * 1000.0));
-        // qDebug2("m_player->onFrame") << "frame" << track << frame.timestamp() << (int)frame.format() << frame.planeCount() << frame.bufferData(0);
-        return 0;
-    });*/
+// Runs once per media, from the media status callback or from setUrl() when a preloaded player takes over
+void MDKPlayer::onMediaLoaded() {
+    if (m_loadHandled.exchange(true)) return;
+
+    refreshMediaInfo();
+    const auto info = mediaInfo();
+    const MediaSummary &md = info->summary;
+    MediaProbe::store(std::string(m_player->url()), info);
+
+    if (md.hasVideo) {
+        m_fps = md.frameRate;
+        double fps = m_fps;
+        m_duration = md.videoDurationMs;
+        if (m_overrideFps > 0.0) {
+            m_duration *= m_fps / m_overrideFps;
+            fps = m_overrideFps;
+        }
 
-    if (m_size.width() > 0 && m_size.height() > 0) {
-        m_player->setVideoSurfaceSize(m_size.width(), m_size.height());
-        m_syncNext = true;
+        QMetaObject::invokeMethod(m_item, "videoLoaded", Q_ARG(double, m_duration), Q_ARG(qlonglong, md.frames), Q_ARG(double, fps), Q_ARG(uint, md.width), Q_ARG(uint, md.height));
+    } else if (md.hasAudio) {
+        m_duration = md.audioDurationMs;
+        m_fps = 0;
+
+        QMetaObject::invokeMethod(m_item, "videoLoaded", Q_ARG(double, m_duration), Q_ARG(qlonglong, 0), Q_ARG(double, 0), Q_ARG(uint, 0), Q_ARG(uint, 0));
+        QMetaObject::invokeMethod(m_item, "metadataLoaded", Qt::QueuedConnection, Q_ARG(QJsonObject, m_metadata));
+        QMetaObject::invokeMethod(m_item, "update");
+        m_firstFrameLoaded = true;
     }
+    m_player->setLoop(9999999);
+    m_videoLoaded = true;
     forceRedraw();
+    updateFrameCacheRange();
+    startFrameIndex();
+
+    if (!m_connectionBeforeRendering)
+        m_connectionBeforeRendering = QObject::connect(m_window, &QQuickWindow::beforeRendering, [this] { this->windowBeforeRendering(); });
+    if (!m_connectionScreenChanged)
+        m_connectionScreenChanged = QObject::connect(m_window, &QQuickWindow::screenChanged, [this](QScreen *) { m_item->update(); });
 }
 
 void MDKPlayer::windowBeforeRendering() {
-    // QElapsedTimer t; t.start();
     if (m_shuttingDown.load()) return;
     if (!m_item || !m_window) return;
+    // Cleared on the GUI thread e.g. by setRotation() or setFrameCacheBudget()
+    m_frameCache.releaseRetired();
     if (!m_videoLoaded.load()) return;
 
-    // Capture player pointer locally to avoid TOCTOU race with destroyPlayer() on GUI thread.
-    // destroyPlayer() may call m_player.release() concurrently, making m_player null.
-    // The released player is kept alive for 1 second via QTimer, so our local pointer remains valid.
-    auto player = m_player.get();
+    // Hold a reference for the whole frame, destroyPlayer() on the GUI thread may drop m_player concurrently.
+    // The player is only reset and returned to the pool when the last reference goes away
+    const auto playerRef = std::atomic_load(&m_player);
+    auto player = playerRef.get();
     if (!player) return;
 
     // Audio-only file: no video frames to render, just report position
     if (m_fps == 0) {
         double ts_ms = double(player->position());
-        QMetaObject::invokeMethod(m_item, "frameRendered", Q_ARG(double, ts_ms), Q_ARG(int, 0));
+        publishPosition(ts_ms, 0);
         return;
     }
 
     // Don't render if sync() hasn't set up the render API for the current player yet
-    if (m_syncNext) return;
-
-    if (m_renderedPosition == m_playerPosition && m_renderedReturnCount++ > 100) {
+    if (m_syncNext || m_rebindNext) return;
+
+    const auto reverse = std::atomic_load(&m_reverse);
+
+    // Only render when there's a new frame: the decoder produced one (render callback), something called forceRedraw(),
+    // or the cached range or reverse playback is playing on its own clock. Other repaints of the window keep the last frame in the texture
+    if (!m_renderDirty.load() && !(m_cacheServing && m_cacheClockRunning) && !(reverse && m_userPlaying)) {
+        m_stats->addSkippedPass();
+        // Readbacks of the last frames are otherwise only collected when the next frame is queued
+        if (m_readbackDelivered != m_readbackQueued && m_firstFrameLoaded.load()) {
+            while (deliverCompletedReadback()) { }
+            QMetaObject::invokeMethod(m_item, "update");
+        }
         return;
     }
     if (m_readyForProcessing && !m_readyForProcessing(m_item)) return;
+    m_renderDirty = false;
+    ++m_renderedPasses;
 
     auto context = static_cast<QSGDefaultRenderContext *>(QQuickItemPrivate::get(m_item)->sceneGraphRenderContext());
     auto cb = context->currentFrameCommandBuffer();
 
-    bool doRenderPass = m_rt && m_window->rendererInterface()->graphicsApi() != QSGRendererInterface::MetalRhi
-#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
-        && m_window->rendererInterface()->graphicsApi() != QSGRendererInterface::Direct3D12
-#endif
-    ;
-
-    if (doRenderPass) {
-        QRhiResourceUpdateBatch *u = context->rhi()->nextResourceUpdateBatch();
-        cb->beginPass(m_rt.get(), QColor(Qt::black), { 1.0f, 0 }, u, QRhiCommandBuffer::ExternalContent);
+    if (!m_cacheServing && m_cacheComplete && m_userPlaying && m_frameCache.enabled() && !m_source && !reverse) {
+        // The whole range is cached, pause the decoder and loop over the cache
+        m_cacheFrame = m_lastFrameKey.load();
+        m_cacheClockReset = true;
+        m_cacheClockRunning = true;
+        m_cacheServing = true;
+        player->set(mdk::PlaybackState::Paused);
     }
 
-    cb->beginExternal();
-    double timestamp = player->renderVideo();
-    cb->endExternal();
-
-    if (doRenderPass) {
-        cb->endPass();
+    double timestamp = -1.0;
+    if (reverse) {
+        PlayerStats::Scope scope(*m_stats, PlayerStats::Render);
+        timestamp = renderReverseFrame(*reverse);
+    } else if (m_cacheServing) {
+        PlayerStats::Scope scope(*m_stats, PlayerStats::Render);
+        timestamp = renderFromFrameCache(cb);
+        if (timestamp < 0) {
+            leaveFrameCache(true);
+            return;
+        }
+    } else {
+        PlayerStats::Scope scope(*m_stats, PlayerStats::Render);
+        timestamp = renderDecodedFrame(player, context, cb);
     }
 
     if (timestamp < 0) {
         return;
     }
+    m_lastFrameKey = frameKey(timestamp);
+
+    const auto seekState = std::atomic_load(&m_seekState);
+    if (seekState->landed.exchange(false)) {
+        const auto now = PlayerStats::Clock::now();
+        m_stats->record(PlayerStats::Seek, seekState->started, now);
+        const double ms = std::chrono::duration<double, std::milli>(now - seekState->started).count();
+        m_seekLatencyMs = 0.8 * m_seekLatencyMs.load() + 0.2 * ms;
+    }
 
-    m_playerPosition = timestamp * 1000;
+    const double sourceTimestampMs = timestamp * 1000.0;
 
     double fps = m_fps;
     if (m_overrideFps > 0.0) {
@@ -398,6 +677,9 @@ void MDKPlayer::windowBeforeRendering() {
     }
 
     int frame = std::ceil(std::round(timestamp * fps * 100.0) / 100.0);
+    if (auto index = frameIndex()) {
+        frame = int(index->frameAt(sourceTimestampMs));
+    }
 
     bool processed = false;
     if (m_firstFrameLoaded.load()) {
@@ -427,7 +709,6 @@ void MDKPlayer::windowBeforeRendering() {
                     ptr3 = uint64_t(rif->getResource(m_window, QSGRendererInterface::DeviceContextResource));
                 } break;
                 case QSGRendererInterface::VulkanRhi: {
-                    context->rhi()->finish();
                     backend_id = 4;
                     ptr2 = uint64_t(rif->getResource(m_window, QSGRendererInterface::DeviceResource));
                     ptr3 = uint64_t(rif->getResource(m_window, QSGRendererInterface::CommandListResource));
@@ -436,8 +717,35 @@ void MDKPlayer::windowBeforeRendering() {
 #  if QT_CONFIG(vulkan)
                     auto inst = reinterpret_cast<QVulkanInstance *>(rif->getResource(m_window, QSGRendererInterface::VulkanInstanceResource));
                     ptr5 = inst? uint64_t(inst->vkInstance()) : 0;
+
+                    if (m_vulkanExplicitSync) {
+                        // No GPU wait, the callback's commands go into this frame after the video's render pass
+                        // The resources are pointers to the handles
+                        auto handle = [&](QSGRendererInterface::Resource resource) -> uint64_t {
+                            auto ptr = static_cast<const uint64_t *>(rif->getResource(m_window, resource));
+                            return ptr? *ptr : 0;
+                        };
+                        auto rhi = context->rhi();
+                        auto handles = static_cast<const QRhiVulkanNativeHandles *>(rhi->nativeHandles());
+                        const auto tf = m_texture->format();
+                        auto &info = m_vulkanFrameInfo;
+                        info.instance = ptr5;
+                        info.queue = handle(QSGRendererInterface::CommandQueueResource);
+                        info.frameNumber++;
+                        info.queueFamilyIndex = handles? uint32_t(handles->gfxQueueFamilyIdx) : 0;
+                        info.format = tf == QRhiTexture::RGBA16F ? VK_FORMAT_R16G16B16A16_SFLOAT : tf == QRhiTexture::RGB10A2 ? VK_FORMAT_A2B10G10R10_UNORM_PACK32 : VK_FORMAT_R8G8B8A8_UNORM;
+                        info.layout = uint32_t(m_texture->nativeTexture().layout);
+                        info.frameSlot = uint32_t(rhi->currentFrameSlot());
+                        info.framesInFlight = uint32_t(rhi->resourceLimit(QRhi::FramesInFlight));
+                        backend_id = 5;
+                        ptr2 = handle(QSGRendererInterface::DeviceResource);
+                        ptr3 = handle(QSGRendererInterface::CommandListResource);
+                        ptr4 = handle(QSGRendererInterface::PhysicalDeviceResource);
+                        ptr5 = uint64_t(&info);
+                    }
 #  endif
 #endif
+                    if (backend_id == 4) context->rhi()->finish();
                 } break;
                 default: break;
             }
@@ -466,7 +774,18 @@ void MDKPlayer::windowBeforeRendering() {
         }
     }
 #endif
-            processed = m_processTexture(m_item, frame, timestamp * 1000.0, m_size.width(), m_size.height(), backend_id, ptr1, ptr2, ptr3, ptr4, ptr5);
+            {
+                PlayerStats::Scope scope(*m_stats, PlayerStats::ProcessTexture);
+                if (backend_id == 5) {
+                    // The rhi flushes its own commands first and tracks the layout the callback leaves the texture in
+                    cb->beginExternal();
+                    processed = m_processTexture(m_item, frame, timestamp * 1000.0, m_size.width(), m_size.height(), backend_id, ptr1, ptr2, ptr3, ptr4, ptr5);
+                    cb->endExternal();
+                    m_texture->setNativeLayout(int(m_vulkanFrameInfo.layout));
+                } else {
+                    processed = m_processTexture(m_item, frame, timestamp * 1000.0, m_size.width(), m_size.height(), backend_id, ptr1, ptr2, ptr3, ptr4, ptr5);
+                }
+            }
 
             // -------------- Readback workaround --------------
             // if (processed && rif->graphicsApi() == QSGRendererInterface::Direct3D11Rhi) {
@@ -481,29 +800,280 @@ void MDKPlayer::windowBeforeRendering() {
             else           m_renderFailCounter++;
         }
 
-        if (!processed && m_processPixels) {
+        if (!processed && (m_processPixels || m_processPixelsInPlace)) {
             if (!m_processTexture || m_renderFailCounter > 10) {
-                auto img = toImage();
-                if (!m_videoLoaded.load() || m_shuttingDown.load()) return;
-
-                const auto img2 = m_processPixels(m_item, frame, timestamp * 1000.0, img);
-                if (!img2.isNull() && img2.constBits()) {
-                    fromImage(img2);
+                if (m_readbackDepth > 1) {
+                    processPixelsAsync(frame, timestamp * 1000.0);
+                } else {
+                    QRhiReadbackResult *result = nullptr;
+                    {
+                        PlayerStats::Scope scope(*m_stats, PlayerStats::Readback);
+                        result = readback();
+                    }
+                    if (result) deliverPixels(*result, frame, timestamp * 1000.0);
                 }
             }
         }
+        if (!m_processPixels || processed)
+            showUploadTexture(false);
+    }
+
+    m_stats->addRendered(uint32_t(std::max(0, frame)), m_userPlaying);
+
+    publishPosition(timestamp * 1000.0, frame);
+}
+
+// Render thread. The snapshot is always current, the item gets one queued dispatch at a time which picks up the latest position
+void MDKPlayer::publishPosition(double timestampMs, int frame) {
+    m_playbackState.setPosition(timestampMs, frame);
+    if (m_notifyPending.exchange(true)) return;
+
+    QQuickItem *item = m_item;
+    if (!item) {
+        m_notifyPending = false;
+        return;
+    }
+    // Called through a functor to measure how long the event waits in the GUI thread's queue
+    m_notifyQueuedAt = PlayerStats::Clock::now();
+    QMetaObject::invokeMethod(item, [this] {
+        m_stats->record(PlayerStats::EventLatency, m_notifyQueuedAt, PlayerStats::Clock::now());
+        dispatchPosition();
+    }, Qt::QueuedConnection);
+}
+
+// GUI thread. Waits out the rest of the notify interval, then hands the latest position to the item if it changed
+void MDKPlayer::dispatchPosition() {
+    QQuickItem *item = m_item;
+    if (!item) {
+        m_notifyPending = false;
+        return;
+    }
+    const auto now = PlayerStats::Clock::now();
+    const auto interval = std::chrono::milliseconds(m_notifyIntervalMs.load());
+    if (now - m_lastNotify < interval) {
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(interval - (now - m_lastNotify)) + std::chrono::milliseconds(1);
+        QTimer::singleShot(wait, item, [this] { dispatchPosition(); });
+        return;
+    }
+    m_lastNotify = now;
+    m_notifyPending = false; // Positions published from here on queue the next dispatch
+
+    const auto snapshot = m_playbackState.load();
+    if (snapshot.updates == m_notifiedUpdates) return;
+    m_notifiedUpdates = snapshot.updates;
+    m_itemMethods.frameRendered.invoke(item, Qt::DirectConnection, Q_ARG(double, snapshot.timestampMs), Q_ARG(int, int(snapshot.frame)));
+}
+
+// Only changes reach the item, the playing flag of the snapshot is updated right away
+void MDKPlayer::notifyState(mdk::State state, Qt::ConnectionType type) {
+    if (!m_playbackState.setPlaying(state == mdk::State::Running)) return;
+    if (QQuickItem *item = m_item) m_itemMethods.stateChanged.invoke(item, type, Q_ARG(int, int(state)));
+}
+
+double MDKPlayer::renderDecodedFrame(mdk::Player *player, QSGDefaultRenderContext *context, QRhiCommandBuffer *cb) {
+    bool doRenderPass = m_rt && m_window->rendererInterface()->graphicsApi() != QSGRendererInterface::MetalRhi
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+        && m_window->rendererInterface()->graphicsApi() != QSGRendererInterface::Direct3D12
+#endif
+    ;
+
+    if (doRenderPass) {
+        QRhiResourceUpdateBatch *u = context->rhi()->nextResourceUpdateBatch();
+        cb->beginPass(m_rt.get(), QColor(Qt::black), { 1.0f, 0 }, u, QRhiCommandBuffer::ExternalContent);
+    }
+
+    cb->beginExternal();
+    double timestamp = player->renderVideo(vo());
+    cb->endExternal();
+
+    if (doRenderPass) {
+        cb->endPass();
+    }
+
+    if (timestamp >= 0) {
+        storeInFrameCache(cb, timestamp);
     }
+    return timestamp;
+}
 
-    if (m_renderedPosition != m_playerPosition)
-        m_renderedReturnCount = 0;
+void MDKPlayer::setFrameCacheBudget(uint64_t bytes) {
+    if (!bytes) leaveFrameCache(true);
+    m_frameCache.setBudget(bytes);
+    m_cacheComplete = false;
+    m_cachePrevFrame = -1;
+}
 
-    m_renderedPosition = m_playerPosition;
-    // printf("render: %.3f\n", double(t.nsecsElapsed()) / 1000000.0);
+void MDKPlayer::resetFrameCache() {
+    leaveFrameCache(true);
+    m_cacheComplete = false;
+    m_cachePrevFrame = -1;
+    m_lastFrameKey = -1;
+    m_frameCache.clear();
+}
 
-    QMetaObject::invokeMethod(m_item, "frameRendered", Q_ARG(double, timestamp * 1000.0), Q_ARG(int, frame));
+// The playback range in decoder frame numbers, or the whole video without a range
+void MDKPlayer::updateFrameCacheRange() {
+    if (m_fps <= 0.0) return;
+    double toMs = double(m_rangeToMs);
+    if (m_rangeToMs <= m_rangeFromMs) {
+        const auto info = mediaInfo();
+        toMs = info? info->summary.videoDurationMs : 0.0;
+    }
+    m_cacheRangeFirst = frameKey(m_rangeFromMs / 1000.0);
+    m_cacheRangeLast = frameKey(toMs / 1000.0);
+    m_frameCache.setRange(m_cacheRangeFirst, m_cacheRangeLast);
+    m_cacheComplete = false;
+    m_cachePrevFrame = -1;
 }
 
-void MDKPlayer::sync(QSGImageNode *node, QSize newSize, QQuickItem *item, bool force) {
+// Called on the render thread right after mdk rendered a decoded frame into m_texture
+void MDKPlayer::storeInFrameCache(QRhiCommandBuffer *cb, double timestamp) {
+    if (!m_frameCache.enabled() || !m_texture || !rhi() || m_fps <= 0.0) return;
+
+    const int64_t key = frameKey(timestamp);
+    const int64_t first = m_cacheRangeFirst, last = m_cacheRangeLast;
+    const int64_t prev = m_cachePrevFrame;
+    m_cachePrevFrame = key;
+    if (key < first || key > last) return;
+
+    // The range is complete once a pass which started at its beginning wrapped around without evicting anything
+    if (prev < 0 || key < prev) {
+        if (prev >= 0 && m_cachePassFromStart && m_frameCache.evictions() == m_cachePassEvictions) {
+            m_cacheComplete = true;
+        }
+        m_cachePassFromStart = key <= first + 1;
+        m_cachePassEvictions = m_frameCache.evictions();
+    }
+    if (m_frameCache.contains(key)) return;
+
+    QRhiResourceUpdateBatch *u = rhi()->nextResourceUpdateBatch();
+    if (m_frameCache.store(rhi(), u, m_texture, key, timestamp, key)) {
+        cb->resourceUpdate(u);
+    } else {
+        u->release();
+    }
+}
+
+// Copies the current cached frame into m_texture. Returns its timestamp in seconds, or -1 if it's not cached
+double MDKPlayer::renderFromFrameCache(QRhiCommandBuffer *cb) {
+    if (!m_texture || !rhi()) return -1.0;
+
+    int64_t frame = m_cacheFrame;
+    if (m_cacheClockRunning) {
+        int64_t first, last;
+        if (!m_frameCache.bounds(first, last)) return -1.0;
+        const auto now = std::chrono::steady_clock::now();
+        if (m_cacheClockReset.exchange(false)) {
+            m_cacheClockStart = now;
+            m_cacheClockStartFrame = std::clamp(frame, first, last);
+        }
+        const int64_t length = last - first + 1;
+        const int64_t advanced = int64_t(std::chrono::duration<double>(now - m_cacheClockStart).count() * m_fps * m_playbackRate);
+        frame = first + ((m_cacheClockStartFrame - first + advanced) % length + length) % length;
+        m_cacheFrame = frame;
+        QMetaObject::invokeMethod(m_item, "update"); // The paused decoder no longer requests new frames
+    }
+
+    QRhiResourceUpdateBatch *u = rhi()->nextResourceUpdateBatch();
+    double timestamp = -1.0;
+    // The clock may land on a frame number the file doesn't have, the one shown until then stays up
+    if (!m_frameCache.fetch(u, m_texture, frame, m_cacheClockRunning, nullptr, &timestamp)) {
+        u->release();
+        return -1.0;
+    }
+    cb->resourceUpdate(u);
+    return timestamp;
+}
+
+// Shows a cached frame without involving the decoder. Only while paused, playback goes through the decoder until the range is complete
+bool MDKPlayer::showCachedFrame(int64_t frame) {
+    if (!m_frameCache.enabled() || m_userPlaying || !m_frameCache.contains(frame)) return false;
+    m_cacheClockRunning = false;
+    m_cacheFrame = frame;
+    if (!m_cacheServing.exchange(true) && m_player) {
+        m_player->set(mdk::PlaybackState::Paused);
+    }
+    forceRedraw();
+    QMetaObject::invokeMethod(m_item, "update");
+    return true;
+}
+
+// Hands the playback back to the decoder, optionally continuing from the frame last shown from the cache
+void MDKPlayer::leaveFrameCache(bool seekToCachedFrame) {
+    if (!m_cacheServing.exchange(false)) return;
+    m_cacheClockRunning = false;
+    m_cachePrevFrame = -1;
+    if (!m_player) return;
+    if (seekToCachedFrame && m_fps > 0.0 && m_cacheFrame >= 0) {
+        m_player->seek(int64_t(std::round(m_cacheFrame * 1000.0 / m_fps)), mdk::SeekFlag::FromStart | mdk::SeekFlag::InCache);
+    }
+    if (m_userPlaying) {
+        m_player->set(mdk::PlaybackState::Playing);
+    }
+    forceRedraw();
+}
+
+// Pixels of frame K are delivered while frames K+1..K+N are still being read back, so the callback never waits for the GPU.
+// The processed image is uploaded over the current frame, which means the displayed output lags by the reported latency.
+void MDKPlayer::processPixelsAsync(uint32_t frame, double timestamp) {
+    if (!queueReadback(frame, timestamp)) {
+        m_readbackDropped++;
+        m_stats->addDropped(1);
+    }
+
+    deliverCompletedReadback();
+}
+
+bool MDKPlayer::deliverCompletedReadback() {
+    auto slot = takeCompletedReadback();
+    if (!slot) return false;
+
+    m_readbackLatencyFrames = uint32_t(m_readbackQueued - slot->sequence - 1);
+    m_readbackLatencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - slot->queuedAt).count();
+    m_stats->record(PlayerStats::ReadbackLatency, slot->queuedAt, std::chrono::steady_clock::now());
+
+    deliverPixels(slot->result, slot->frame, slot->timestamp);
+    return true;
+}
+
+// The readback buffers are the frame pool: in-place callbacks modify them directly and the same buffer is uploaded back,
+// so there is no per-frame allocation once the ring is warmed up
+void MDKPlayer::deliverPixels(QRhiReadbackResult &result, uint32_t frame, double timestamp) {
+    if (result.data.isEmpty() || !m_videoLoaded.load() || m_shuttingDown.load()) return;
+
+    if (m_processPixelsInPlace) {
+        const QSize size = result.pixelSize;
+        auto bits = reinterpret_cast<uint8_t *>(result.data.data());
+        bool ok = false;
+        {
+            PlayerStats::Scope scope(*m_stats, PlayerStats::ProcessPixels);
+            ok = m_processPixelsInPlace(m_item, frame, timestamp, size.width(), size.height(), size.width() * 4, bits, result.data.size());
+        }
+        if (ok) {
+            PlayerStats::Scope scope(*m_stats, PlayerStats::Upload);
+            uploadPixels(result.data, size);
+        }
+    } else if (m_processPixels) {
+        QImage img;
+        {
+            PlayerStats::Scope scope(*m_stats, PlayerStats::ProcessPixels);
+            img = m_processPixels(m_item, frame, timestamp, readbackToImage(result));
+        }
+        PlayerStats::Scope scope(*m_stats, PlayerStats::Upload);
+        uploadProcessedImage(img);
+    }
+}
+
+void MDKPlayer::uploadProcessedImage(const QImage &img) {
+    const QRect dirty = m_processedDirtyRect;
+    m_processedDirtyRect = QRect();
+    // Without a processed image the freshly rendered frame is shown, not the last processed one
+    if (img.isNull() || !img.constBits() || !fromImage(img, false, dirty)) {
+        showUploadTexture(false);
+    }
+}
+
+void MDKPlayer::sync(QSGImageNode *node, QSize newSize, QQuickItem *item, bool force, bool deferrable) {
     if (m_shuttingDown.load()) return;
     if (!m_item || !m_window || !item || m_item != item) return;
     if (!node) return;
@@ -512,40 +1082,158 @@ void MDKPlayer::sync(QSGImageNode *node, QSize newSize, QQuickItem *item, bool f
         m_syncNext = false;
     }
     if (!m_player) { m_size = newSize; return; }
-    if (!force && node->texture() && newSize == m_size)
-        return;
-
+    if (m_rebindNext) {
+        m_rebindNext = false;
+        if (m_texture && node->texture() && newSize == m_size) {
+            // A preloaded player took over, it renders into the current texture
+            setupRenderAPI(m_player.get(), m_size, vo());
+            m_player->setVideoSurfaceSize(m_size.width(), m_size.height(), vo());
+            forceRedraw();
+            return;
+        }
+        force = true;
+    }
     if (newSize.width() < 32 || newSize.height() < 32)
         newSize = QSize(32, 32);
+    if (m_surfaceCap.isValid() && (newSize.width() > m_surfaceCap.width() || newSize.height() > m_surfaceCap.height()))
+        newSize = newSize.scaled(m_surfaceCap, Qt::KeepAspectRatio);
+
+    if (!force && node->texture() && newSize == m_size)
+        return;
+    if (!force && deferrable && m_texture && node->texture() && deferResize(newSize))
+        return;
 
     m_size = newSize;
+    ++m_surfaceReallocations;
+
+    // Cached frames have the previous size
+    resetFrameCache();
+    m_frameCache.releaseRetired();
+    m_reverseFrame = ReversePlayback::Frame();
 
     releaseResources();
-    auto tex = createTexture(m_player.get(), m_size);
+    auto tex = createTexture(m_player.get(), m_size, vo());
     if (!tex)
         return;
     qDebug2("MDKPlayer::sync") << "created texture" << tex << m_size;
+    m_sgTexture = tex;
+    m_showingUploadTexture = false;
     QMetaObject::invokeMethod(m_item, "surfaceSizeUpdated", Q_ARG(uint, m_size.width()), Q_ARG(uint, m_size.height()));
     node->setTexture(tex);
     node->setOwnsTexture(true);
     node->setTextureCoordinatesTransform(m_tx); // MUST set when texture() is available
     node->setFiltering(QSGTexture::Linear);
     node->setRect(0, 0, m_item->width(), m_item->height());
-    m_player->setVideoSurfaceSize(m_size.width(), m_size.height());
+    m_player->setVideoSurfaceSize(m_size.width(), m_size.height(), vo());
+    forceRedraw();
+}
+
+bool MDKPlayer::deferResize(const QSize &newSize) {
+    auto bucketDistance = [](int a, int b) { return std::abs((a + m_resizeBucket - 1) / m_resizeBucket - (b + m_resizeBucket - 1) / m_resizeBucket); };
+    if (bucketDistance(newSize.width(), m_size.width()) > 1 || bucketDistance(newSize.height(), m_size.height()) > 1) {
+        m_pendingSize = QSize();
+        return false;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (newSize != m_pendingSize) {
+        m_pendingSize = newSize;
+        m_lastResize = now;
+    } else if (now - m_lastResize >= std::chrono::milliseconds(m_resizeSettleMs)) {
+        m_pendingSize = QSize();
+        return false;
+    }
+    ++m_deferredResizes;
+
+    // sync() only runs on updates, make sure there's one after the size settles. Timers have to be started on the item's thread
+    if (!m_resizeTimerPending.exchange(true)) {
+        QQuickItem *item = m_item;
+        QMetaObject::invokeMethod(item, [this, item] {
+            QTimer::singleShot(m_resizeSettleMs, item, [this, item] {
+                m_resizeTimerPending = false;
+                item->update();
+            });
+        }, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+SurfaceStats MDKPlayer::surfaceStats() const {
+    SurfaceStats ret;
+    ret.reallocations = m_surfaceReallocations;
+    ret.deferredResizes = m_deferredResizes;
+    ret.width = uint32_t(m_size.width());
+    ret.height = uint32_t(m_size.height());
+    return ret;
 }
 
 void MDKPlayer::play() {
     if (!m_videoLoaded || !m_player) return;
+    m_userPlaying = true;
+    if (m_decodeLevel == DecodeLevel::Paused) {
+        // Not shown, starts when the scheduler resumes it
+        m_schedulerPaused = true;
+        notifyState(mdk::State::Running);
+        return;
+    }
+    if (m_playbackRate < 0.0f && !std::atomic_load(&m_reverse)) {
+        if (!startReverse(m_cacheServing? m_cacheFrame * 1000.0 / m_fps : double(m_player->position()))) {
+            qDebug2("play") << "Reverse playback isn't available for this video, playing forward at rate 1";
+            m_playbackRate = 1.0f;
+            m_player->setPlaybackRate(1.0f);
+        }
+    }
+    if (std::atomic_load(&m_reverse)) {
+        m_reverseOriginMs = m_reverseShownMs.load();
+        m_reverseClockReset = true;
+        notifyState(mdk::State::Running);
+        forceRedraw();
+        QMetaObject::invokeMethod(m_item, "update");
+        return;
+    }
+    if (m_cacheServing) {
+        if (m_cacheComplete) {
+            m_cacheClockReset = true;
+            m_cacheClockRunning = true;
+            notifyState(mdk::State::Running);
+            forceRedraw();
+            QMetaObject::invokeMethod(m_item, "update");
+            return;
+        }
+        leaveFrameCache(true);
+    }
     m_player->set(mdk::PlaybackState::Playing);
     forceRedraw();
 }
 void MDKPlayer::pause() {
     if (!m_videoLoaded || !m_player) return;
+    m_userPlaying = false;
+    if (m_schedulerPaused) {
+        m_schedulerPaused = false;
+        notifyState(mdk::State::Paused);
+        return;
+    }
+    if (std::atomic_load(&m_reverse)) {
+        m_reverseOriginMs = m_reverseShownMs.load();
+        notifyState(mdk::State::Paused);
+        forceRedraw();
+        return;
+    }
+    if (m_cacheServing) {
+        m_cacheClockRunning = false;
+        notifyState(mdk::State::Paused);
+        forceRedraw();
+        return;
+    }
     m_player->set(mdk::PlaybackState::Paused);
     forceRedraw();
 }
 void MDKPlayer::stop() {
     if (!m_videoLoaded || !m_player) return;
+    m_userPlaying = false;
+    m_schedulerPaused = false;
+    leaveReverse(false);
+    leaveFrameCache(false);
     m_player->set(mdk::PlaybackState::Stopped);
     m_player->waitFor(mdk::PlaybackState::Stopped);
 }
@@ -558,13 +1246,128 @@ void MDKPlayer::setFrameRate(float fps) {
 void MDKPlayer::seekToTimestamp(float timestampMs, bool exact) {
     if (!m_videoLoaded || !m_player) return;
 
-    m_player->seek(timestampMs, (exact? mdk::SeekFlag::FromStart : mdk::SeekFlag::FromStart | mdk::SeekFlag::KeyFrame) | mdk::SeekFlag::InCache);
+    if (auto reverse = std::atomic_load(&m_reverse)) {
+        // Continues backwards from there, on the same decoder
+        reverse->seek(timestampMs);
+        m_reverseOriginMs = timestampMs;
+        m_reverseShownMs = timestampMs;
+        m_reverseClockReset = true;
+        forceRedraw();
+        return;
+    }
+
+    if (m_scrubbing) {
+        scrubTo(timestampMs);
+        return;
+    }
+    m_scrubTarget = -1.0;
+    m_scrubPending = false;
+
+    if (exact && m_fps > 0.0 && showCachedFrame(frameKey(timestampMs / 1000.0))) return;
+    leaveFrameCache(false);
+
+    issueSeek(timestampMs, (exact? mdk::SeekFlag::FromStart : mdk::SeekFlag::FromStart | mdk::SeekFlag::KeyFrame) | mdk::SeekFlag::InCache);
+    forceRedraw();
+}
+
+// Returns false if mdk didn't accept the seek
+bool MDKPlayer::issueSeek(int64_t position, mdk::SeekFlag flags) {
+    auto state = m_seekState;
+    state->started = PlayerStats::Clock::now();
+    state->landed = false;
+    state->inFlight = true;
+    QPointer<QQuickItem> item = m_item;
+    const bool ok = m_player->seek(position, flags, [this, state, item](int64_t ret) {
+        state->inFlight = false;
+        state->landed = ret >= 0; // Negative if the seek failed or was cancelled by a newer one
+        if (item) QMetaObject::invokeMethod(item, [this] { issuePendingScrubSeek(); }, Qt::QueuedConnection);
+    });
+    if (!ok) state->inFlight = false;
+    return ok;
+}
+
+void MDKPlayer::setScrubbing(bool scrubbing) {
+    if (m_scrubbing == scrubbing) return;
+    m_scrubbing = scrubbing;
+    m_scrubVelocity = 0.0;
+    m_scrubLastTime = { };
+    if (scrubbing) {
+        // A target left from an earlier drag must not be mistaken for this one's previous position
+        m_scrubTarget = -1.0;
+        m_scrubPending = false;
+    } else if (m_scrubTarget >= 0.0) {
+        // Where the drag ended, exactly
+        if (m_fps > 0.0 && showCachedFrame(frameKey(m_scrubTarget / 1000.0))) {
+            m_scrubPending = false;
+            m_scrubTarget = -1.0;
+            return;
+        }
+        m_scrubPending = true;
+        issuePendingScrubSeek();
+    }
+}
+
+void MDKPlayer::scrubTo(double timestampMs) {
+    const auto now = PlayerStats::Clock::now();
+    const double dt = std::chrono::duration<double, std::milli>(now - m_scrubLastTime).count();
+    if (m_scrubTarget >= 0.0 && m_scrubLastTime.time_since_epoch().count() && dt > 0.0 && dt < 250.0) {
+        m_scrubVelocity = 0.7 * m_scrubVelocity + 0.3 * (timestampMs - m_scrubTarget) / dt;
+    } else {
+        m_scrubVelocity = 0.0;
+    }
+    m_scrubLastTime = now;
+    m_scrubTarget = timestampMs;
+
+    if (m_fps > 0.0 && showCachedFrame(frameKey(timestampMs / 1000.0))) {
+        m_scrubPending = false;
+        return;
+    }
+    m_scrubPending = true;
+    issuePendingScrubSeek();
+}
+
+// Latest wins: called for every new target and when a seek finishes, only issues when nothing is in flight
+void MDKPlayer::issuePendingScrubSeek() {
+    if (!m_player || !m_videoLoaded || !m_scrubPending || m_seekState->inFlight) return;
+    if (!m_scrubbing && m_scrubTarget < 0.0) {
+        m_scrubPending = false;
+        return;
+    }
+    m_scrubPending = false;
+    leaveFrameCache(false);
+
+    if (m_scrubbing) {
+        double target = m_scrubTarget + m_scrubVelocity * m_seekLatencyMs.load();
+        if (const auto info = mediaInfo()) {
+            target = std::clamp(target, 0.0, std::max(0.0, info->summary.videoDurationMs));
+        }
+        issueSeek(int64_t(target), mdk::SeekFlag::FromStart | mdk::SeekFlag::KeyFrame | mdk::SeekFlag::InCache);
+    } else if (issueSeek(int64_t(m_scrubTarget), mdk::SeekFlag::FromStart | mdk::SeekFlag::InCache)) {
+        m_scrubTarget = -1.0; // The final seek, nothing is left to follow up
+    }
     forceRedraw();
 }
 
 void MDKPlayer::seekToFrameDelta(int64_t frameDelta) {
     if (!m_videoLoaded || !m_player) return;
 
+    if (std::atomic_load(&m_reverse) && m_fps > 0.0) {
+        seekToTimestamp(m_reverseShownMs + frameDelta * 1000.0 / m_fps);
+        return;
+    }
+
+    const int64_t current = m_cacheServing? m_cacheFrame.load() : m_lastFrameKey.load();
+    if (current >= 0 && m_fps > 0.0) {
+        if (showCachedFrame(current + frameDelta)) return;
+        if (m_cacheServing) {
+            // The decoder is still where the cache took over, so step relative to the frame on screen
+            leaveFrameCache(false);
+            m_player->seek(int64_t(std::round((current + frameDelta) * 1000.0 / m_fps)), mdk::SeekFlag::FromStart | mdk::SeekFlag::InCache);
+            forceRedraw();
+            return;
+        }
+    }
+
     m_player->seek(frameDelta, mdk::SeekFlag::FromNow | mdk::SeekFlag::Frame | mdk::SeekFlag::InCache);
     forceRedraw();
 }
@@ -572,16 +1375,151 @@ void MDKPlayer::seekToFrameDelta(int64_t frameDelta) {
 void MDKPlayer::seekToFrame(int64_t frame, int64_t currentFrame, bool exact) {
     if (!m_videoLoaded || !m_player) return;
 
-    auto md = m_player->mediaInfo();
-    if (!md.video.empty()) {
-        auto v = md.video[0];
-        seekToTimestamp((frame / v.codec.frame_rate) * 1000.0, exact);
+    if (auto index = frameIndex()) {
+        const double timestampMs = index->timestamp(frame);
+        if (timestampMs >= 0.0) {
+            // Exact position of the frame, also with variable frame rate
+            seekToTimestamp(std::floor(timestampMs), exact);
+            return;
+        }
+    }
+
+    const auto info = mediaInfo();
+    if (info && info->summary.hasVideo) {
+        seekToTimestamp((frame / info->summary.frameRate) * 1000.0, exact);
     }
     forceRedraw();
 }
 
-void MDKPlayer::setPlaybackRate(float rate) { m_playbackRate = rate; if (m_player) m_player->setPlaybackRate(rate); }
-float MDKPlayer::playbackRate() { return m_player? m_player->playbackRate() : m_playbackRate; }
+void MDKPlayer::setPlaybackRate(float rate) {
+    if (rate < 0.0f && !canPlayReverse()) {
+        qDebug2("setPlaybackRate") << "Reverse playback isn't available for this video, the rate stays at" << m_playbackRate;
+        return;
+    }
+    const float previous = m_playbackRate;
+    m_playbackRate = rate;
+    if (rate < 0.0f) {
+        if (std::atomic_load(&m_reverse)) {
+            // Same position, new speed
+            m_reverseOriginMs = m_reverseShownMs.load();
+            m_reverseClockReset = true;
+            forceRedraw();
+            return;
+        }
+        if (!m_userPlaying || !m_player) return; // Starts with play()
+        if (startReverse(m_cacheServing? m_cacheFrame * 1000.0 / m_fps : double(m_player->position()))) {
+            QMetaObject::invokeMethod(m_item, "update");
+        } else {
+            qDebug2("setPlaybackRate") << "Reverse playback failed to start, the rate stays at" << previous;
+            m_playbackRate = previous;
+        }
+        return;
+    }
+    leaveReverse(true);
+    if (m_player) m_player->setPlaybackRate(rate);
+}
+float MDKPlayer::playbackRate() { return (m_player && m_playbackRate >= 0.0f)? m_player->playbackRate() : m_playbackRate; }
+
+// Before the video is loaded a negative rate is accepted, play() falls back to forward if it turns out to be unsupported
+bool MDKPlayer::canPlayReverse() const {
+    if (m_source) return false; // The shared player can't be paused for one of its views
+    return !m_videoLoaded || m_fps > 0.0;
+}
+
+// Replaces a running reverse playback
+bool MDKPlayer::startReverse(double fromMs) {
+    if (!m_videoLoaded || !m_player || !canPlayReverse()) return false;
+    // Before the first sync there's no texture size yet, the frames are then converted at the video size
+    QSize size = m_size;
+    if (size.isEmpty()) {
+        if (const auto info = mediaInfo()) size = QSize(int(info->summary.width), int(info->summary.height));
+    }
+    if (size.isEmpty()) return false;
+
+    if (auto previous = std::atomic_load(&m_reverse)) {
+        previous->stop();
+    }
+    leaveFrameCache(false);
+    m_player->set(mdk::PlaybackState::Paused);
+
+    auto reverse = std::make_shared<ReversePlayback>(std::string(m_player->url()), frameIndex());
+    reverse->start(fromMs, uint32_t(size.width()), uint32_t(size.height()), m_tx.testFlag(QSGImageNode::TextureCoordinatesTransformFlag::MirrorVertically), m_reverseBudget);
+    m_reverseOriginMs = fromMs;
+    m_reverseShownMs = fromMs;
+    m_reverseClockReset = true;
+    std::atomic_store(&m_reverse, reverse);
+    return true;
+}
+
+// Hands the playback back to m_player, optionally continuing from the frame last shown in reverse
+void MDKPlayer::leaveReverse(bool seekToShownFrame) {
+    auto reverse = std::atomic_load(&m_reverse);
+    if (!reverse) return;
+    std::atomic_store(&m_reverse, std::shared_ptr<ReversePlayback>());
+    reverse->stop();
+    if (!m_player || !m_videoLoaded) return;
+    if (seekToShownFrame && m_reverseShownMs >= 0.0) {
+        issueSeek(std::llround(m_reverseShownMs.load()), mdk::SeekFlag::FromStart | mdk::SeekFlag::InCache);
+    }
+    if (m_userPlaying) {
+        m_player->set(mdk::PlaybackState::Playing);
+    }
+    forceRedraw();
+}
+
+// Uploads the frame for the reverse clock position. Returns its timestamp in seconds, or -1 if there's no new frame to show
+double MDKPlayer::renderReverseFrame(ReversePlayback &reverse) {
+    const auto now = std::chrono::steady_clock::now();
+    double target = m_reverseOriginMs;
+    if (m_userPlaying && !m_reverseClockReset) {
+        target += std::chrono::duration<double, std::milli>(now - m_reverseClockStart).count() * m_playbackRate;
+    }
+
+    ReversePlayback::Frame frame;
+    if (!reverse.take(target, frame)) {
+        // The clock starts once there is a frame and stops while the decoder is behind, so a late GOP doesn't turn into skipped frames
+        if (m_userPlaying) {
+            m_reverseOriginMs = target;
+            m_reverseClockReset = true;
+        }
+        if (!reverse.atStart()) {
+            forceRedraw();
+            QMetaObject::invokeMethod(m_item, "update");
+        }
+        return -1.0;
+    }
+    if (m_userPlaying) {
+        if (m_reverseClockReset.exchange(false)) {
+            m_reverseClockStart = now;
+        }
+        if (reverse.atStart() && target < frame.timestamp) {
+            // Reached the first frame
+            m_userPlaying = false;
+            m_reverseOriginMs = frame.timestamp;
+            notifyState(mdk::State::Paused, Qt::QueuedConnection);
+        } else {
+            QMetaObject::invokeMethod(m_item, "update"); // Nothing else requests the next frame
+        }
+    }
+    if (!m_texture || frame.pixels.constData() == m_reverseFrame.pixels.constData()) return -1.0;
+
+    m_reverseFrame = frame;
+    m_reverseShownMs = frame.timestamp;
+    if (frame.size == m_size) {
+        uploadPixels(m_reverseFrame.pixels, frame.size);
+    } else {
+        // Texture was resized since reverse playback started, the upload texture is scaled
+        fromImage(QImage(reinterpret_cast<const uchar *>(m_reverseFrame.pixels.constData()), frame.size.width(), frame.size.height(), QImage::Format_RGBA8888));
+    }
+    return frame.timestamp / 1000.0;
+}
+
+ReversePlaybackStats MDKPlayer::reversePlaybackStats() const {
+    if (const auto reverse = std::atomic_load(&m_reverse)) return reverse->stats();
+    ReversePlaybackStats ret;
+    ret.budgetBytes = m_reverseBudget;
+    return ret;
+}
 
 void MDKPlayer::setPlaybackRange(int64_t from_ms, int64_t to_ms) {
     if (m_overrideFps > 0.0) {
@@ -589,213 +1527,163 @@ void MDKPlayer::setPlaybackRange(int64_t from_ms, int64_t to_ms) {
         to_ms   /= m_fps / m_overrideFps;
     }
     if (m_player) m_player->setRange(from_ms, to_ms);
+
+    leaveFrameCache(true);
+    m_rangeFromMs = from_ms;
+    m_rangeToMs = to_ms;
+    updateFrameCacheRange();
 }
 
 void MDKPlayer::setRotation(int v) {
     if (!m_videoLoaded || !m_player) return;
 
-    m_player->rotate(v);
+    resetFrameCache(); // Cached frames have the previous rotation
+
+    m_player->rotate(v, vo());
     forceRedraw();
 }
 int MDKPlayer::getRotation() {
     if (!m_videoLoaded || !m_player) return 0;
 
-    auto md = m_player->mediaInfo();
-    if (!md.video.empty()) {
-        return md.video[0].rotation;
-    }
-    return 0;
+    const auto info = mediaInfo();
+    return info? info->summary.rotation : 0;
 }
 
 void MDKPlayer::stopProcessingPlayer(uint64_t id) {
-    if (m_processingPlayers.find(id) == m_processingPlayers.end()) return;
-    m_processingPlayers[id]->set(mdk::PlaybackState::Stopped);
-    m_processingPlayers[id]->waitFor(mdk::PlaybackState::Stopped);
-    //m_processingPlayers.erase(id);
+    auto it = m_processingSessions.find(id);
+    if (it == m_processingSessions.end()) return;
+    it->second->stop();
+    //m_processingSessions.erase(id);
 }
 
-void MDKPlayer::initProcessingPlayer(uint64_t id, uint64_t width, uint64_t height, bool yuv, std::string custom_decoder, const std::vector<std::pair<uint64_t, uint64_t>> &ranges, VideoProcessCb &&cb) { // ms
-    m_processingPlayers[id] = std::make_unique<mdk::Player>();
-    auto player = m_processingPlayers[id].get();
-    if (!custom_decoder.empty()) {
-        player->setDecoders(MediaType::Video, { custom_decoder });
-    } else {
-        player->setDecoders(MediaType::Video, { "FFmpeg", "BRAW:gpu=auto", "R3D:gpu=auto" });
-    }
-
-
-    player->setMedia(m_player? m_player->url() : qUtf8Printable(m_pendingUrl.toLocalFile()));
-
-    player->setDecoders(MediaType::Audio, { });
-    player->setMute(true);
-    player->onSync([] { return DBL_MAX; });
-
-    if (ranges.empty()) {
-        const_cast<std::vector<std::pair<uint64_t, uint64_t>> &>(ranges).push_back({ 0, UINT64_MAX });
-    }
-
-    auto range_id = std::make_shared<uint>(0);
-    auto finished = std::make_shared<bool>(false);
-
-    player->onFrame<mdk::VideoFrame>([cb, width, height, id, range_id = std::move(range_id), finished = std::move(finished), yuv, ranges, this](mdk::VideoFrame &v, int) -> int {
-        if (*finished) return 0;
-        if (!v || v.timestamp() == mdk::TimestampEOS) { // AOT frame(1st frame, seek end 1st frame) is not valid, but format is valid. eof frame format is invalid
-            cb(-1, -1.0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
-            *finished = true;
-            return 0;
-        }
-        if (!v.format()) {
-            printf("error occured!\n");
-            return 0;
-        }
-
-        auto timestamp_ms = v.timestamp() * 1000.0;
-
-        auto md = m_processingPlayers[id]->mediaInfo();
-        if (!md.video.empty()) {
-            auto vmd = md.video[0];
-
-            auto frame_num = std::ceil(std::round(v.timestamp() * vmd.codec.frame_rate * 100) / 100.0);
-
-            if (width == 0) const_cast<uint64_t&>(width) = v.width();
-            if (height == 0) const_cast<uint64_t&>(height) = v.height();
-
-            auto format = yuv? mdk::PixelFormat::YUV420P : mdk::PixelFormat::RGBA;
-            if (!strcmp(md.format, "r3d")) format = mdk::PixelFormat::BGRA;
-
-            /*switch (v.format()) {
-                case mdk::PixelFormat::YUV420P:     qDebug() << "YUV420P";     break;
-                case mdk::PixelFormat::NV12:        qDebug() << "NV12";        break;
-                case mdk::PixelFormat::YUV422P:     qDebug() << "YUV422P";     break;
-                case mdk::PixelFormat::YUV444P:     qDebug() << "YUV444P";     break;
-                case mdk::PixelFormat::P010LE:      qDebug() << "P010LE";      break;
-                case mdk::PixelFormat::P016LE:      qDebug() << "P016LE";      break;
-                case mdk::PixelFormat::YUV420P10LE: qDebug() << "YUV420P10LE"; break;
-                case mdk::PixelFormat::UYVY422:     qDebug() << "UYVY422";     break;
-                case mdk::PixelFormat::RGB24:       qDebug() << "RGB24";       break;
-                case mdk::PixelFormat::RGBA:        qDebug() << "RGBA";        break;
-                case mdk::PixelFormat::RGBX:        qDebug() << "RGBX";        break;
-                case mdk::PixelFormat::BGRA:        qDebug() << "BGRA";        break;
-                case mdk::PixelFormat::BGRX:        qDebug() << "BGRX";        break;
-                case mdk::PixelFormat::RGB565LE:    qDebug() << "RGB565LE";    break;
-                case mdk::PixelFormat::RGB48LE:     qDebug() << "RGB48LE";     break;
-                case mdk::PixelFormat::GBRP:        qDebug() << "GBRP";        break;
-                case mdk::PixelFormat::GBRP10LE:    qDebug() << "GBRP10LE";    break;
-                case mdk::PixelFormat::XYZ12LE:     qDebug() << "XYZ12LE";     break;
-                case mdk::PixelFormat::YUVA420P:    qDebug() << "YUVA420P";    break;
-                case mdk::PixelFormat::BC1:         qDebug() << "BC1";         break;
-                case mdk::PixelFormat::BC3:         qDebug() << "BC3";         break;
-                case mdk::PixelFormat::RGBA64:      qDebug() << "RGBA64";      break;
-                case mdk::PixelFormat::BGRA64:      qDebug() << "BGRA64";      break;
-                case mdk::PixelFormat::RGBP16:      qDebug() << "RGBP16";      break;
-                case mdk::PixelFormat::RGBPF32:     qDebug() << "RGBPF32";     break;
-                case mdk::PixelFormat::BGRAF32:     qDebug() << "BGRAF32";     break;
-            }*/
-
-            auto vscaled = v.to(format, width, height);
-            auto ptr = vscaled.bufferData();
-            auto ptr_size = vscaled.bytesPerLine() * vscaled.height();
-
-            if (!cb(frame_num, timestamp_ms, vscaled.width(), vscaled.height(), vmd.codec.width, vmd.codec.height, vmd.codec.frame_rate, vmd.duration, vmd.frames, ptr, ptr_size)) {
-                // If cb returns false - stop the processing
-                m_processingPlayers[id]->set(mdk::PlaybackState::Paused);
-                m_processingPlayers[id]->waitFor(mdk::PlaybackState::Paused);
-                cb(-1, -1.0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
-                *finished = true;
-                return 0;
-            }
-        }
+bool MDKPlayer::processingQueueStats(uint64_t id, FrameQueueStats &stats) const {
+    auto it = m_processingSessions.find(id);
+    if (it == m_processingSessions.end()) return false;
+    return it->second->queueStats(stats);
+}
 
-        if (timestamp_ms >= ranges[*range_id].second) {
-            if (*range_id + 1 < ranges.size()) {
-                *range_id += 1;
-                m_processingPlayers[id]->seek(ranges[*range_id].first, mdk::SeekFlag::FromStart);
-                return 0;
-            }
-            m_processingPlayers[id]->set(mdk::PlaybackState::Paused);
-            m_processingPlayers[id]->waitFor(mdk::PlaybackState::Paused);
-            cb(-1, -1.0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
-            *finished = true;
-            return 0;
-        }
+bool MDKPlayer::processingConverterStats(uint64_t id, ConverterStats &stats) const {
+    auto it = m_processingSessions.find(id);
+    if (it == m_processingSessions.end()) return false;
+    return it->second->converterStats(stats);
+}
 
-        return 0;
+void MDKPlayer::initProcessingPlayer(uint64_t id, uint64_t width, uint64_t height, bool yuv, std::string custom_decoder, const std::vector<std::pair<uint64_t, uint64_t>> &ranges, VideoProcessCb &&cb, const ProcessingOptions &options) { // ms
+    const std::string url = m_player? std::string(m_player->url()) : toStdString(m_pendingUrl.toLocalFile());
+
+    // Segmenting needs the duration up front, without it the session falls back to a single player
+    const double duration = (m_videoLoaded && m_fps > 0)? m_duration : 0.0;
+
+    m_processingSessions[id] = std::make_unique<ProcessingSession>(url, options, std::move(cb));
+    if (m_player && std::string(m_player->url()) == url) {
+        if (auto index = frameIndex()) m_processingSessions[id]->setFrameIndex(index);
+        if (auto info = mediaInfo()) m_processingSessions[id]->setSourceSize(info->summary.width, info->summary.height);
+    }
+    m_processingSessions[id]->start(width, height, yuv, custom_decoder, ranges, duration);
+}
+
+void MDKPlayer::setFrameIndexing(bool scan) {
+    m_frameIndexScan = scan;
+    if (scan && m_videoLoaded && !frameIndex()) {
+        startFrameIndex();
+    }
+}
+
+std::shared_ptr<const FrameIndex> MDKPlayer::frameIndex() const {
+    auto index = std::atomic_load(&m_frameIndex);
+    if (!index || !index->ready()) return nullptr;
+    return index;
+}
+
+void MDKPlayer::startFrameIndex() {
+    std::atomic_store(&m_frameIndex, std::shared_ptr<FrameIndex>());
+    if (!m_player || m_fps <= 0.0) return;
+
+    if (m_source) {
+        QPointer<QQuickItem> item = m_item;
+        std::atomic_store(&m_frameIndex, m_source->frameIndex(this, m_frameIndexScan, [item](bool ok, int64_t frameCount) {
+            if (!ok || !item) return;
+            QMetaObject::invokeMethod(item, "frameIndexReady", Qt::QueuedConnection, Q_ARG(qlonglong, frameCount));
+        }));
+        return;
+    }
+
+    auto index = std::make_shared<FrameIndex>(std::string(m_player->url()));
+    QPointer<QQuickItem> item = m_item;
+    auto raw = index.get(); // The callback runs on the index thread, which is joined before the index is destroyed
+    index->start(m_frameIndexScan, [item, raw](bool ok) {
+        if (!ok || !item) return;
+        QMetaObject::invokeMethod(item, "frameIndexReady", Qt::QueuedConnection, Q_ARG(qlonglong, raw->frameCount()));
     });
-    player->setVideoSurfaceSize(64, 64);
+    std::atomic_store(&m_frameIndex, index);
+}
+
+void MDKPlayer::generateThumbnails(uint64_t id, const std::vector<double> &timestampsMs, uint32_t count, uint32_t width, uint32_t height, ThumbnailCb &&cb, const ThumbnailOptions &options) {
+    const std::string url = m_player? std::string(m_player->url()) : toStdString(m_pendingUrl.toLocalFile());
+
+    // Saves opening the file once more when the video is already loaded
+    double duration = 0.0;
+    uint32_t videoWidth = 0, videoHeight = 0;
+    if (const auto info = m_videoLoaded? mediaInfo() : nullptr) {
+        duration    = info->summary.durationMs;
+        videoWidth  = info->summary.width;
+        videoHeight = info->summary.height;
+    }
+
+    m_thumbnailGenerators.erase(id);
+    auto generator = std::make_unique<ThumbnailGenerator>(url, options, std::move(cb));
+    generator->start(timestampsMs, count, width, height, duration, videoWidth, videoHeight);
+    m_thumbnailGenerators[id] = std::move(generator);
+}
 
-    player->prepare(ranges[0].first);
-    player->set(State::Running);
+void MDKPlayer::stopThumbnails(uint64_t id) {
+    auto it = m_thumbnailGenerators.find(id);
+    if (it == m_thumbnailGenerators.end()) return;
+    it->second->stop();
+}
+
+void MDKPlayer::generateItemThumbnails(uint32_t count, uint32_t width, uint32_t height) {
+    QPointer<QQuickItem> item = m_item;
+    ThumbnailOptions options;
+    options.diskCache = true; // QML loads the thumbnails from the files
+    generateThumbnails(UINT64_MAX, { }, count, width, height, [item](int32_t index, double requestedMs, double timestampMs, uint32_t, uint32_t, const uint8_t *, uint64_t, const std::string &cachedFile) {
+        if (!item || index < 0 || cachedFile.empty()) return;
+        QMetaObject::invokeMethod(item, "thumbnailReady", Qt::QueuedConnection, Q_ARG(int, index), Q_ARG(double, timestampMs), Q_ARG(QString, QUrl::fromLocalFile(QString::fromStdString(cachedFile)).toString()));
+    }, options);
 }
 
 std::map<std::string, std::string> MDKPlayer::getMediaInfo(const MediaInfo &mi) {
     std::map<std::string, std::string> ret;
-    ret["start_time"] = std::to_string(mi.start_time);
-    ret["bit_rate"]   = std::to_string(mi.bit_rate);
-    ret["size"]       = std::to_string(mi.size);
-    ret["format"]     = std::string(mi.format);
-    ret["streams"]    = std::to_string(mi.streams);
-    for (const auto &x : mi.metadata) {
-        ret["metadata." + x.first] = x.second;
-    }
-    int i = 0;
-    for (const auto &v : mi.video) {
-        std::string key = "stream.video[" + std::to_string(i) + "].";
-        ret[key + "index"] = std::to_string(v.index);
-        ret[key + "start_time"] = std::to_string(v.start_time);
-        ret[key + "duration"] = std::to_string(m_duration);
-        ret[key + "frames"] = std::to_string(v.frames);
-        ret[key + "rotation"] = std::to_string(v.rotation);
-        for (const auto &x : v.metadata) {
-            ret[key + "metadata." + x.first] = x.second;
-        }
-
-        ret[key + "codec.name"]         = std::string(v.codec.codec);
-        ret[key + "codec.tag"]          = std::to_string(v.codec.codec_tag);
-        //ret[key + "codec.extra_data"] = std::to_string(v.codec.extra_data, v.codec.extra_data_size);
-        ret[key + "codec.bit_rate"]     = std::to_string(v.codec.bit_rate);
-        ret[key + "codec.profile"]      = std::to_string(v.codec.profile);
-        ret[key + "codec.level"]        = std::to_string(v.codec.level);
-        ret[key + "codec.frame_rate"]   = std::to_string(m_overrideFps > 0.0? m_overrideFps : v.codec.frame_rate);
-        ret[key + "codec.format"]       = std::to_string(v.codec.format);
-        ret[key + "codec.format_name"]  = std::string(v.codec.format_name);
-        ret[key + "codec.width"]        = std::to_string(v.codec.width);
-        ret[key + "codec.height"]       = std::to_string(v.codec.height);
-        ret[key + "codec.b_frames"]     = std::to_string(v.codec.b_frames);
-
-        ++i;
-    }
-    i = 0;
-    for (const auto &a : mi.audio) {
-        std::string key = "stream.audio[" + std::to_string(i) + "].";
-        ret[key + "index"] = std::to_string(a.index);
-        ret[key + "start_time"] = std::to_string(a.start_time);
-        ret[key + "duration"] = std::to_string(a.duration);
-        ret[key + "frames"] = std::to_string(a.frames);
-        for (const auto &x : a.metadata) {
-            ret[key + "metadata." + x.first] = x.second;
-        }
-
-        ret[key + "codec.name"]            = std::string(a.codec.codec);
-        ret[key + "codec.tag"]             = std::to_string(a.codec.codec_tag);
-        //ret[key + "codec.extra_data"]    = std::to_string(a.codec.extra_data, a.codec.extra_data_size);
-        ret[key + "codec.bit_rate"]        = std::to_string(a.codec.bit_rate);
-        ret[key + "codec.profile"]         = std::to_string(a.codec.profile);
-        ret[key + "codec.level"]           = std::to_string(a.codec.level);
-        ret[key + "codec.frame_rate"]      = std::to_string(a.codec.frame_rate);
-        ret[key + "codec.is_float"]        = a.codec.is_float?    "true" : "false";
-        ret[key + "codec.is_unsigned"]     = a.codec.is_unsigned? "true" : "false";
-        ret[key + "codec.is_planar"]       = a.codec.is_planar?   "true" : "false";
-        ret[key + "codec.raw_sample_size"] = std::to_string(a.codec.raw_sample_size);
-        ret[key + "codec.channels"]        = std::to_string(a.codec.channels);
-        ret[key + "codec.sample_rate"]     = std::to_string(a.codec.sample_rate);
-        ret[key + "codec.block_align"]     = std::to_string(a.codec.block_align);
-        ret[key + "codec.frame_size"]      = std::to_string(a.codec.frame_size);
-
-        ++i;
+    const QJsonObject obj = metadataJson(*MediaInfoSnapshot::fromMediaInfo(mi));
+    for (auto it = obj.constBegin(); it != obj.constEnd(); ++it) {
+        ret[it.key().toStdString()] = it.value().toString().toStdString();
     }
     return ret;
 }
 
+std::shared_ptr<const MediaInfoSnapshot> MDKPlayer::mediaInfo() const {
+    return std::atomic_load(&m_mediaInfo);
+}
+
+// The only place which copies mdk's MediaInfo, everything else reads the snapshot
+void MDKPlayer::refreshMediaInfo() {
+    if (!m_player) return;
+    std::atomic_store(&m_mediaInfo, MediaInfoSnapshot::fromMediaInfo(m_player->mediaInfo()));
+}
+
+// Snapshot metadata with the frame rate set by setFrameRate applied
+QJsonObject MDKPlayer::metadataJson(const MediaInfoSnapshot &info) const {
+    QJsonObject obj = info.metadata;
+    if (m_overrideFps > 0.0) {
+        for (int i = 0; obj.contains(QString("stream.video[%1].index").arg(i)); ++i) {
+            const QString key = QString("stream.video[%1].").arg(i);
+            obj.insert(key + "duration", QString::fromStdString(std::to_string(m_duration)));
+            obj.insert(key + "codec.frame_rate", QString::fromStdString(std::to_string(m_overrideFps)));
+        }
+    }
+    return obj;
+}
+
 QSGDefaultRenderContext *MDKPlayer::rhiContext() {
     return static_cast<QSGDefaultRenderContext *>(QQuickItemPrivate::get(m_item)->sceneGraphRenderContext());
 }
@@ -2,6 +2,8 @@
 #define MDK_PLAYER_H
 
 #include <QtQuick/QQuickItem>
+#include <QtCore/QPointer>
+#include <QtCore/QMetaMethod>
 #include <QtQuick/QQuickWindow>
 #include <QtQuick/QSGImageNode>
 #include <QtCore/QJsonObject>
@@ -11,16 +13,55 @@
 #include <queue>
 #include <atomic>
 #include <functional>
+#include <cmath>
 
 #include "VideoTextureNode.h"
+#include "ProcessingSession.h"
+#include "ThumbnailGenerator.h"
+#include "FrameCache.h"
+#include "FrameIndex.h"
+#include "MediaProbe.h"
+#include "PlayerPool.h"
+#include "SharedSource.h"
+#include "DecodeScheduler.h"
+#include "PlayerStats.h"
+#include "ReversePlayback.h"
+#include "PlaybackState.h"
 
 typedef std::function<bool(QQuickItem *item, uint32_t frame, double timestamp, uint32_t width, uint32_t height, uint32_t backend_id, uint64_t ptr1, uint64_t ptr2, uint64_t ptr3, uint64_t ptr4, uint64_t ptr5)> ProcessTextureCb;
 typedef std::function<QImage(QQuickItem *item, uint32_t frame, double timestamp, const QImage &img)> ProcessPixelsCb;
+typedef std::function<bool(QQuickItem *item, uint32_t frame, double timestamp, uint32_t width, uint32_t height, uint32_t stride, uint8_t *bits, uint64_t bitsSize)> ProcessPixelsInPlaceCb;
 typedef std::function<bool(QQuickItem *item)> ReadyForProcessingCb;
-typedef std::function<bool(int32_t frame, double timestamp, uint32_t width, uint32_t height, uint32_t org_width, uint32_t org_height, double fps, double duration_ms, uint32_t frame_count, const uint8_t *bits, uint64_t bitsSize)> VideoProcessCb;
 
 namespace mdk { class Player; }
 
+// Passed to ProcessTextureCb as `ptr5` with backend_id 5, i.e. Vulkan with explicit synchronization, see MDKPlayer::setVulkanExplicitSync().
+// Must match `VulkanFrameInfo` in video_player.rs
+struct VulkanFrameInfo {
+    uint64_t instance{0};        // VkInstance
+    uint64_t queue{0};           // VkQueue the frame's command buffer is submitted to
+    uint64_t frameNumber{0};     // Increases by one every rendered frame, e.g. as a timeline semaphore value
+    uint32_t queueFamilyIndex{0};
+    uint32_t format{0};          // VkFormat of the texture
+    uint32_t layout{0};          // VkImageLayout of the texture when the callback is called. A callback which transitions the image stores its final layout here
+    uint32_t frameSlot{0};       // Resources used in this frame can be reused once the same slot comes back
+    uint32_t framesInFlight{0};
+};
+
+// Must match `SurfaceStats` in video_player.rs
+struct SurfaceStats {
+    uint64_t reallocations{0}; // Render textures created, including the first one
+    uint64_t deferredResizes{0}; // Size changes shown by scaling the current texture instead of reallocating
+    uint32_t width{0};
+    uint32_t height{0};
+};
+
+// Must match `RenderPassStats` in video_player.rs
+struct RenderPassStats {
+    uint64_t rendered{0};
+    uint64_t skipped{0}; // beforeRendering calls without a new frame, e.g. the UI repainted over a paused video
+};
+
 class MDKPlayer : public VideoTextureNodePriv {
 public:
     MDKPlayer();
@@ -30,6 +71,13 @@ public:
     ~MDKPlayer();
 
     void setUrl(const QUrl &url, const QString &customDecoder);
+    // Opens and prepares `url` in the background, so a following setUrl() with the same arguments switches to it without reopening. Empty url cancels it
+    void setNextUrl(const QUrl &url, const QString &customDecoder);
+    // Items with sharing enabled which open the same url and decoder use one decoder, see SharedSource. Applies from the next setUrl()
+    void setSourceSharing(bool enabled);
+    size_t sharedSourceViews() const { return m_source? m_source->viewCount() : 0; }
+    // Items with higher priority get the decode budget first, see DecodeScheduler
+    void setDecodePriority(int priority);
     void setProperty(const QString &key, const QString &value);
     void setDefaultProperty(const QString &key, const QString &value);
 
@@ -45,38 +93,91 @@ public:
 
     void setupNode(QSGImageNode *node, QQuickItem *item);
     void setProcessPixelsCallback(ProcessPixelsCb &&cb);
+    // Callback modifies the readback buffer in place and returns true if it should be uploaded back. Takes precedence over ProcessPixelsCb
+    void setProcessPixelsInPlaceCallback(ProcessPixelsInPlaceCb &&cb);
     void setProcessTextureCallback(ProcessTextureCb &&cb);
     void setReadyForProcessingCallback(ReadyForProcessingCb &&cb);
 
+    // Number of frames kept in flight for the processPixels readback. 0 or 1 waits for the GPU on every frame
+    void setReadbackDepth(int depth);
+    int readbackDepth() const { return m_readbackDepth; }
+    uint32_t readbackLatencyFrames() const { return m_readbackLatencyFrames; }
+    double readbackLatencyMs() const { return m_readbackLatencyMs; }
+    uint64_t readbackDroppedFrames() const { return m_readbackDropped; }
+
+    // On Vulkan, call the process texture callback inside the frame with backend_id 5 instead of waiting for the GPU first.
+    // The callback records its work into the frame's command buffer (`ptr3`), which is submitted after the video's render pass
+    void setVulkanExplicitSync(bool enabled) { m_vulkanExplicitSync = enabled; }
+
+    // Region of the next processed image which changed since the previous one. Applies to a single upload
+    void setProcessedDirtyRect(const QRect &rect) { m_processedDirtyRect = rect; }
+
+    // Keep up to `bytes` of rendered frames of the playback range on the GPU, so looping and stepping within the range doesn't decode.
+    // Cached playback has no audio. 0 disables the cache
+    void setFrameCacheBudget(uint64_t bytes);
+    FrameCacheStats frameCacheStats() const { return m_frameCache.stats(); }
+
     void setupPlayer();
 
     void windowBeforeRendering();
 
-    void sync(QSGImageNode *node, QSize newSize, QQuickItem *item, bool force = false);
-    void forceRedraw() { m_renderedPosition = -1; m_playerPosition = 0; m_renderedReturnCount = 0; }
+    // `deferrable`: size changes may be shown by scaling the current texture until the size settles, see m_resizeBucket
+    void sync(QSGImageNode *node, QSize newSize, QQuickItem *item, bool force = false, bool deferrable = false);
+    SurfaceStats surfaceStats() const;
+    // Renders the current frame again in the next beforeRendering, e.g. after a seek or a property change
+    void forceRedraw() { m_renderDirty = true; }
+    RenderPassStats renderPassStats() const { return { m_renderedPasses, m_stats->skippedPasses() }; }
+    PlayerStats &pipelineStats() { return *m_stats; }
+    // Latest position and state, without going through the item
+    PlaybackSnapshot playbackState() const { return m_playbackState.load(); }
+    // Position notifications to the item are coalesced to at most one per `ms`. 0 delivers once per event loop iteration
+    void setNotifyInterval(uint32_t ms) { m_notifyIntervalMs = ms; }
 
     void play();
     void pause();
     void stop();
 
     void seekToTimestamp(float timestampMs, bool exact = true);
+    // While scrubbing, seeks are coalesced so only the latest one is issued once the previous one finished. They go to keyframes,
+    // ahead in the direction of the drag by the distance the drag covers during a seek. Ending the scrub does one exact seek
+    void setScrubbing(bool scrubbing);
     void seekToFrame(int64_t frame, int64_t currentFrame, bool exact = true);
     void seekToFrameDelta(int64_t frameDelta);
 
     void setFrameRate(float fps);
 
+    // Negative rates play backwards from a separate decoder, see ReversePlayback. There is no audio and no rotation in reverse
     void setPlaybackRate(float rate);
     float playbackRate();
+    // Memory for the decoded frames of reverse playback, applies from the next time it starts. Default 512 MB
+    void setReverseBufferBudget(uint64_t bytes) { m_reverseBudget = bytes; }
+    ReversePlaybackStats reversePlaybackStats() const;
 
     void setPlaybackRange(int64_t from_ms, int64_t to_ms);
 
     void setRotation(int v);
     int getRotation();
 
-    void initProcessingPlayer(uint64_t id, uint64_t width, uint64_t height, bool yuv, std::string custom_decoder, const std::vector<std::pair<uint64_t, uint64_t>> &ranges, VideoProcessCb &&cb);
+    // Index of every frame of local files, used for frame numbers, seekToFrame and processing callbacks so they're exact with variable frame rate.
+    // A stored index is always used, `scan` decides whether files without one are scanned in the background. Emits `frameIndexReady(frames)`
+    void setFrameIndexing(bool scan);
+    // Null until the index of the current file is ready
+    std::shared_ptr<const FrameIndex> frameIndex() const;
+
+    void initProcessingPlayer(uint64_t id, uint64_t width, uint64_t height, bool yuv, std::string custom_decoder, const std::vector<std::pair<uint64_t, uint64_t>> &ranges, VideoProcessCb &&cb, const ProcessingOptions &options = ProcessingOptions());
     void stopProcessingPlayer(uint64_t id);
+    bool processingQueueStats(uint64_t id, FrameQueueStats &stats) const;
+    bool processingConverterStats(uint64_t id, ConverterStats &stats) const;
+
+    // Thumbnails of the current file, see ThumbnailGenerator. Starting with an id in use replaces the previous request
+    void generateThumbnails(uint64_t id, const std::vector<double> &timestampsMs, uint32_t count, uint32_t width, uint32_t height, ThumbnailCb &&cb, const ThumbnailOptions &options = ThumbnailOptions());
+    void stopThumbnails(uint64_t id);
+    // Emits `thumbnailReady(index, timestamp, url)` on the QML item for each cached thumbnail file
+    void generateItemThumbnails(uint32_t count, uint32_t width, uint32_t height);
 
     std::map<std::string, std::string> getMediaInfo(const MediaInfo &mi);
+    // Refreshed when the media or its metadata changes. Null until the media is loaded
+    std::shared_ptr<const MediaInfoSnapshot> mediaInfo() const;
 
     QSGDefaultRenderContext *rhiContext();
     QRhiTexture *rhiTexture();
@@ -106,26 +207,164 @@ private:
     std::function<void(void *)> m_userData2Destructor;
 
     ProcessPixelsCb m_processPixels;
+    ProcessPixelsInPlaceCb m_processPixelsInPlace;
     ProcessTextureCb m_processTexture;
     ReadyForProcessingCb m_readyForProcessing;
 
-    std::unique_ptr<mdk::Player> m_player;
-    std::map<uint64_t, std::unique_ptr<mdk::Player>> m_processingPlayers;
+    std::shared_ptr<mdk::Player> m_player; // From PlayerPool, written with std::atomic_store as the render thread reads it
+    std::shared_ptr<mdk::Player> acquirePlayer();
+    void releaseRenderer(std::shared_ptr<mdk::Player> player);
+    void openMedia(const std::shared_ptr<mdk::Player> &player, const QUrl &url, const QString &customDecoder);
+    void onMediaLoaded();
+    std::atomic<bool> m_loadHandled{false};
+
+    void takeNextPlayer();
+    void catchUpLoadedMedia();
+
+    void attachSharedSource(const QUrl &url, const QString &customDecoder);
+    void *vo() { return m_source? this : nullptr; } // Our output of a shared player
+    std::shared_ptr<SharedSource> m_source;
+    bool m_sourceCreated{false}; // This view opened the shared source, so its playback settings apply
+    bool m_shareSource{false};
+
+    void applyDecodeLevel(DecodeLevel level, const QSize &surfaceCap);
+    uint64_t m_decodeClient{0};
+    int m_decodePriority{0};
+    DecodeLevel m_decodeLevel{DecodeLevel::Full};
+    QSize m_surfaceCap; // Render surface limit of a reduced item, invalid if there's none
+    bool m_schedulerPaused{false}; // The user is playing, but the scheduler keeps the decoder paused
+
+    void onRenderRequested();
+    bool onPlayerEvent(const mdk::MediaEvent &evt);
+    void onPlayerStateChanged(mdk::State state);
+    bool onPlayerMediaStatus(mdk::MediaStatus status);
+    std::shared_ptr<mdk::Player> m_nextPlayer;
+    QUrl m_nextUrl;
+    QString m_nextCustomDecoder;
+    bool m_rebindNext{false}; // Like m_syncNext, but keeps the texture
+    std::map<uint64_t, std::unique_ptr<ProcessingSession>> m_processingSessions;
+    std::map<uint64_t, std::unique_ptr<ThumbnailGenerator>> m_thumbnailGenerators;
 
     std::atomic<bool> m_videoLoaded{false};
     std::atomic<bool> m_firstFrameLoaded{false};
 
     int m_renderFailCounter{10};
-
-    int64_t m_renderedPosition{-1};
-    int64_t m_renderedReturnCount{0};
+    std::atomic<bool> m_vulkanExplicitSync{false};
+    VulkanFrameInfo m_vulkanFrameInfo; // Render thread
+
+    double renderDecodedFrame(mdk::Player *player, QSGDefaultRenderContext *context, QRhiCommandBuffer *cb);
+    void processPixelsAsync(uint32_t frame, double timestamp);
+    bool deliverCompletedReadback();
+    void deliverPixels(QRhiReadbackResult &result, uint32_t frame, double timestamp);
+    void uploadProcessedImage(const QImage &img);
+    QRect m_processedDirtyRect;
+    std::atomic<uint32_t> m_readbackLatencyFrames{0};
+    std::atomic<double> m_readbackLatencyMs{0.0};
+    std::atomic<uint64_t> m_readbackDropped{0};
+
+    void refreshMediaInfo();
+    QJsonObject metadataJson(const MediaInfoSnapshot &info) const;
+    std::shared_ptr<const MediaInfoSnapshot> m_mediaInfo; // Accessed with std::atomic_load/store
+
+    void startFrameIndex();
+    std::shared_ptr<FrameIndex> m_frameIndex; // Accessed with std::atomic_load/store, the render thread reads it
+    bool m_frameIndexScan{false};
+
+    // RAM preview, see setFrameCacheBudget
+    int64_t frameKey(double timestamp) const { return std::llround(timestamp * m_fps); }
+    void updateFrameCacheRange();
+    void storeInFrameCache(QRhiCommandBuffer *cb, double timestamp);
+    double renderFromFrameCache(QRhiCommandBuffer *cb);
+    bool showCachedFrame(int64_t frame);
+    void leaveFrameCache(bool seekToCachedFrame);
+    void resetFrameCache();
+    void releaseFrameCacheTextures();
+    FrameCache m_frameCache;
+    std::atomic<bool> m_cacheServing{false};      // Frames come from m_frameCache and the decoder is paused
+    std::atomic<bool> m_cacheClockRunning{false}; // Playing the cached range on our own clock
+    std::atomic<bool> m_cacheClockReset{false};
+    std::atomic<bool> m_cacheComplete{false};     // A whole pass over the range is cached
+    std::atomic<int64_t> m_cacheFrame{-1};
+    std::atomic<int64_t> m_cacheRangeFirst{0};
+    std::atomic<int64_t> m_cacheRangeLast{-1};
+    std::atomic<int64_t> m_lastFrameKey{-1};
+    std::chrono::steady_clock::time_point m_cacheClockStart;
+    int64_t m_cacheClockStartFrame{0};
+    int64_t m_cachePrevFrame{-1};
+    bool m_cachePassFromStart{false};
+    uint64_t m_cachePassEvictions{0};
+    std::atomic<bool> m_userPlaying{false};
+    int64_t m_rangeFromMs{0};
+    int64_t m_rangeToMs{-1};
+
+    std::atomic<bool> m_renderDirty{true}; // Set by the render callback and forceRedraw(), cleared when a pass renders
+    std::atomic<uint64_t> m_renderedPasses{0};
+    std::shared_ptr<PlayerStats> m_stats{std::make_shared<PlayerStats>()}; // Shared with queued events which may outlive a frame
+
+    // Item methods called for every frame or state change, looked up once in setupNode()
+    struct ItemMethods {
+        QMetaMethod frameRendered;
+        QMetaMethod stateChanged;
+        QMetaMethod setBuffering;
+        QMetaMethod setBufferedRanges;
+    } m_itemMethods;
+    void publishPosition(double timestampMs, int frame);
+    void dispatchPosition();
+    void notifyState(mdk::State state, Qt::ConnectionType type = Qt::AutoConnection);
+    PlaybackState m_playbackState;
+    std::atomic<uint32_t> m_notifyIntervalMs{0};
+    std::atomic<bool> m_notifyPending{false}; // A dispatch is queued or waiting for the interval, later positions are picked up by it
+    PlayerStats::Clock::time_point m_notifyQueuedAt;
+    PlayerStats::Clock::time_point m_lastNotify; // GUI thread
+    uint64_t m_notifiedUpdates{0};               // GUI thread
+    std::vector<std::pair<int64_t, int64_t>> m_bufferedRanges; // Player callback thread, last ranges sent to the item
+
+    // Reverse playback, see setPlaybackRate. The decoder of m_player stays paused meanwhile
+    bool startReverse(double fromMs);
+    void leaveReverse(bool seekToShownFrame);
+    double renderReverseFrame(ReversePlayback &reverse);
+    std::shared_ptr<ReversePlayback> m_reverse; // Accessed with std::atomic_load/store, the render thread reads it
+    uint64_t m_reverseBudget{512ull * 1024 * 1024};
+    std::atomic<double> m_reverseOriginMs{0.0};   // Position of the reverse clock when it was started
+    std::atomic<bool> m_reverseClockReset{false}; // Start the clock from m_reverseOriginMs with the next frame
+    std::atomic<double> m_reverseShownMs{-1.0};
+    std::chrono::steady_clock::time_point m_reverseClockStart;
+    ReversePlayback::Frame m_reverseFrame; // Render thread only. Shown frame, its pixels must stay valid until the upload is done
+
+    // Shared with the mdk seek callback, which can run after the player changed
+    struct SeekState {
+        std::atomic<bool> inFlight{false};
+        std::atomic<bool> landed{false};
+        PlayerStats::Clock::time_point started;
+    };
+    bool issueSeek(int64_t position, mdk::SeekFlag flags);
+    bool canPlayReverse() const;
+    void scrubTo(double timestampMs);
+    void issuePendingScrubSeek();
+    std::shared_ptr<SeekState> m_seekState{std::make_shared<SeekState>()}; // Replaced with the player, accessed with std::atomic_load/store
+    std::atomic<double> m_seekLatencyMs{50.0}; // Moving average of the seek to display time
+    bool m_scrubbing{false};
+    bool m_scrubPending{false}; // m_scrubTarget wasn't issued yet
+    double m_scrubTarget{-1.0};
+    double m_scrubVelocity{0.0}; // ms of video per ms of wall time, positive forward
+    PlayerStats::Clock::time_point m_scrubLastTime;
     double m_fps{0.0};
     double m_overrideFps{0.0};
     double m_duration{0.0};
     float m_playbackRate{1.0};
     bool m_syncNext{false};
     bool m_isHttp{false};
-    int64_t m_playerPosition{0};
+
+    // Render texture sizing during interactive resizes. The texture is reallocated right away only when the new size is more than
+    // one bucket away from the current one, otherwise the scene graph scales it until no resize came for m_resizeSettleMs
+    bool deferResize(const QSize &newSize);
+    static constexpr int m_resizeBucket = 128;
+    static constexpr int m_resizeSettleMs = 150;
+    QSize m_pendingSize; // Size requested by the last deferred sync()
+    std::chrono::steady_clock::time_point m_lastResize;
+    std::atomic<bool> m_resizeTimerPending{false};
+    std::atomic<uint64_t> m_surfaceReallocations{0};
+    std::atomic<uint64_t> m_deferredResizes{0};
 
     QJsonObject m_metadata;
 
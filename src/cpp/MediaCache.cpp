@@ -0,0 +1,30 @@
+#include "MediaCache.h"
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QUrl>
+
+QString MediaCache::fileKey(const QString &pathOrUrl) {
+    QString id = pathOrUrl;
+    const QUrl url(pathOrUrl);
+    if (url.isLocalFile() || url.scheme().size() <= 1) { // No scheme or a drive letter
+        const QFileInfo fi(url.isLocalFile()? url.toLocalFile() : pathOrUrl);
+        if (!fi.exists()) return QString();
+        id = fi.canonicalFilePath() + "|" + QString::number(fi.size()) + "|" + QString::number(fi.lastModified().toMSecsSinceEpoch());
+    }
+    return QString::fromLatin1(QCryptographicHash::hash(id.toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+QString MediaCache::directory(const QString &kind) {
+    QString base = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (base.isEmpty()) {
+        base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+        if (base.isEmpty()) return QString();
+        base += "/qml-video-rs";
+    }
+    const QString path = base + "/" + kind;
+    if (!QDir().mkpath(path)) return QString();
+    return path;
+}
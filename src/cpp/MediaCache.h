@@ -0,0 +1,17 @@
+#ifndef MEDIA_CACHE_H
+#define MEDIA_CACHE_H
+
+#include <QtCore/QString>
+
+// Shared helpers for data derived from media files and kept between sessions (thumbnails, indexes, probe results)
+class MediaCache {
+public:
+    // Identifies the file contents without reading them, from the canonical path, size and modification time.
+    // Accepts a local path or a url. Empty if a local file doesn't exist
+    static QString fileKey(const QString &pathOrUrl);
+
+    // Writable directory for one kind of cached data, created if needed. Empty if there's no usable cache location
+    static QString directory(const QString &kind);
+};
+
+#endif
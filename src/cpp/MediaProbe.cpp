@@ -0,0 +1,249 @@
+#include "MediaProbe.h"
+#include "MediaCache.h"
+#include <map>
+#include <mutex>
+#include <future>
+#include <QtCore/QFile>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QSaveFile>
+
+#include "mdk/MediaInfo.h"
+#include "mdk/Player.h"
+
+static constexpr int probeCacheVersion = 1;
+
+static std::mutex probeCacheMutex;
+static std::map<QString, std::shared_ptr<const MediaInfoSnapshot>> &probeCache() {
+    static std::map<QString, std::shared_ptr<const MediaInfoSnapshot>> cache;
+    return cache;
+}
+
+std::shared_ptr<const MediaInfoSnapshot> MediaInfoSnapshot::fromMediaInfo(const mdk::MediaInfo &mi) {
+    auto ret = std::make_shared<MediaInfoSnapshot>();
+    auto &s = ret->summary;
+    s.durationMs  = double(mi.duration);
+    s.startTimeMs = double(mi.start_time);
+    s.bitRate     = mi.bit_rate;
+    s.size        = mi.size;
+    s.streams     = uint32_t(mi.streams);
+    ret->format   = mi.format? mi.format : "";
+    if (!mi.video.empty()) {
+        const auto &v = mi.video[0];
+        s.hasVideo        = true;
+        s.width           = uint32_t(v.codec.width);
+        s.height          = uint32_t(v.codec.height);
+        s.rotation        = v.rotation;
+        s.frameRate       = v.codec.frame_rate;
+        s.frames          = v.frames;
+        s.videoDurationMs = double(v.duration);
+        s.videoBitRate    = v.codec.bit_rate;
+        if (!s.frames && v.duration > 0 && v.codec.frame_rate > 0) {
+            s.frames = int64_t((double(v.duration) / 1000.0) * v.codec.frame_rate);
+        }
+        ret->videoCodec = v.codec.codec? v.codec.codec : "";
+    }
+    if (!mi.audio.empty()) {
+        const auto &a = mi.audio[0];
+        s.hasAudio        = true;
+        s.channels        = uint32_t(a.codec.channels);
+        s.sampleRate      = uint32_t(a.codec.sample_rate);
+        s.audioDurationMs = double(a.duration);
+        ret->audioCodec   = a.codec.codec? a.codec.codec : "";
+    }
+
+    QJsonObject &md = ret->metadata;
+    auto put = [&md](const QString &key, const QString &value) { md.insert(key, value); };
+    auto num = [](auto v) { return QString::number(v); };
+    auto str = [](const char *v) { return QString::fromUtf8(v? v : ""); };
+    auto flag = [](bool v) { return QString(v? "true" : "false"); };
+
+    put("start_time", num(mi.start_time));
+    put("bit_rate",   num(mi.bit_rate));
+    put("size",       num(mi.size));
+    put("format",     str(mi.format));
+    put("streams",    num(mi.streams));
+    for (const auto &x : mi.metadata) {
+        put("metadata." + QString::fromStdString(x.first), QString::fromStdString(x.second));
+    }
+    for (size_t i = 0; i < mi.video.size(); ++i) {
+        const auto &v = mi.video[i];
+        const QString key = QString("stream.video[%1].").arg(i);
+        put(key + "index",      num(v.index));
+        put(key + "start_time", num(v.start_time));
+        put(key + "duration",   num(v.duration));
+        put(key + "frames",     num(v.frames));
+        put(key + "rotation",   num(v.rotation));
+        for (const auto &x : v.metadata) {
+            put(key + "metadata." + QString::fromStdString(x.first), QString::fromStdString(x.second));
+        }
+
+        put(key + "codec.name",        str(v.codec.codec));
+        put(key + "codec.tag",         num(v.codec.codec_tag));
+        put(key + "codec.bit_rate",    num(v.codec.bit_rate));
+        put(key + "codec.profile",     num(v.codec.profile));
+        put(key + "codec.level",       num(v.codec.level));
+        put(key + "codec.frame_rate",  QString::fromStdString(std::to_string(v.codec.frame_rate)));
+        put(key + "codec.format",      num(int(v.codec.format)));
+        put(key + "codec.format_name", str(v.codec.format_name));
+        put(key + "codec.width",       num(v.codec.width));
+        put(key + "codec.height",      num(v.codec.height));
+        put(key + "codec.b_frames",    num(v.codec.b_frames));
+    }
+    for (size_t i = 0; i < mi.audio.size(); ++i) {
+        const auto &a = mi.audio[i];
+        const QString key = QString("stream.audio[%1].").arg(i);
+        put(key + "index",      num(a.index));
+        put(key + "start_time", num(a.start_time));
+        put(key + "duration",   num(a.duration));
+        put(key + "frames",     num(a.frames));
+        for (const auto &x : a.metadata) {
+            put(key + "metadata." + QString::fromStdString(x.first), QString::fromStdString(x.second));
+        }
+
+        put(key + "codec.name",            str(a.codec.codec));
+        put(key + "codec.tag",             num(a.codec.codec_tag));
+        put(key + "codec.bit_rate",        num(a.codec.bit_rate));
+        put(key + "codec.profile",         num(a.codec.profile));
+        put(key + "codec.level",           num(a.codec.level));
+        put(key + "codec.frame_rate",      QString::fromStdString(std::to_string(a.codec.frame_rate)));
+        put(key + "codec.is_float",        flag(a.codec.is_float));
+        put(key + "codec.is_unsigned",     flag(a.codec.is_unsigned));
+        put(key + "codec.is_planar",       flag(a.codec.is_planar));
+        put(key + "codec.raw_sample_size", num(a.codec.raw_sample_size));
+        put(key + "codec.channels",        num(a.codec.channels));
+        put(key + "codec.sample_rate",     num(a.codec.sample_rate));
+        put(key + "codec.block_align",     num(a.codec.block_align));
+        put(key + "codec.frame_size",      num(a.codec.frame_size));
+    }
+    return ret;
+}
+
+static QJsonObject toJson(const MediaInfoSnapshot &snapshot) {
+    const auto &s = snapshot.summary;
+    QJsonObject summary;
+    summary.insert("durationMs",      s.durationMs);
+    summary.insert("startTimeMs",     s.startTimeMs);
+    summary.insert("bitRate",         double(s.bitRate));
+    summary.insert("size",            double(s.size));
+    summary.insert("streams",         double(s.streams));
+    summary.insert("width",           double(s.width));
+    summary.insert("height",          double(s.height));
+    summary.insert("rotation",        s.rotation);
+    summary.insert("frameRate",       s.frameRate);
+    summary.insert("frames",          double(s.frames));
+    summary.insert("videoDurationMs", s.videoDurationMs);
+    summary.insert("videoBitRate",    double(s.videoBitRate));
+    summary.insert("channels",        double(s.channels));
+    summary.insert("sampleRate",      double(s.sampleRate));
+    summary.insert("audioDurationMs", s.audioDurationMs);
+    summary.insert("hasVideo",        s.hasVideo);
+    summary.insert("hasAudio",        s.hasAudio);
+
+    QJsonObject obj;
+    obj.insert("version",    probeCacheVersion);
+    obj.insert("summary",    summary);
+    obj.insert("format",     QString::fromStdString(snapshot.format));
+    obj.insert("videoCodec", QString::fromStdString(snapshot.videoCodec));
+    obj.insert("audioCodec", QString::fromStdString(snapshot.audioCodec));
+    obj.insert("metadata",   snapshot.metadata);
+    return obj;
+}
+
+static std::shared_ptr<const MediaInfoSnapshot> fromJson(const QJsonObject &obj) {
+    if (obj.value("version").toInt() != probeCacheVersion) return nullptr;
+    const QJsonObject summary = obj.value("summary").toObject();
+
+    auto ret = std::make_shared<MediaInfoSnapshot>();
+    auto &s = ret->summary;
+    s.durationMs      = summary.value("durationMs").toDouble();
+    s.startTimeMs     = summary.value("startTimeMs").toDouble();
+    s.bitRate         = int64_t(summary.value("bitRate").toDouble());
+    s.size            = int64_t(summary.value("size").toDouble());
+    s.streams         = uint32_t(summary.value("streams").toDouble());
+    s.width           = uint32_t(summary.value("width").toDouble());
+    s.height          = uint32_t(summary.value("height").toDouble());
+    s.rotation        = summary.value("rotation").toInt();
+    s.frameRate       = summary.value("frameRate").toDouble();
+    s.frames          = int64_t(summary.value("frames").toDouble());
+    s.videoDurationMs = summary.value("videoDurationMs").toDouble();
+    s.videoBitRate    = int64_t(summary.value("videoBitRate").toDouble());
+    s.channels        = uint32_t(summary.value("channels").toDouble());
+    s.sampleRate      = uint32_t(summary.value("sampleRate").toDouble());
+    s.audioDurationMs = summary.value("audioDurationMs").toDouble();
+    s.hasVideo        = summary.value("hasVideo").toBool();
+    s.hasAudio        = summary.value("hasAudio").toBool();
+    ret->format     = obj.value("format").toString().toStdString();
+    ret->videoCodec = obj.value("videoCodec").toString().toStdString();
+    ret->audioCodec = obj.value("audioCodec").toString().toStdString();
+    ret->metadata   = obj.value("metadata").toObject();
+    return ret;
+}
+
+QString MediaProbe::cacheFile(const QString &key) {
+    const QString dir = MediaCache::directory("probe");
+    return dir.isEmpty()? QString() : dir + "/" + key + ".json";
+}
+
+std::shared_ptr<const MediaInfoSnapshot> MediaProbe::cached(const std::string &url) {
+    const QString key = MediaCache::fileKey(QString::fromStdString(url));
+    if (key.isEmpty()) return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(probeCacheMutex);
+        auto it = probeCache().find(key);
+        if (it != probeCache().end()) return it->second;
+    }
+
+    const QString path = cacheFile(key);
+    QFile file(path);
+    if (path.isEmpty() || !file.open(QIODevice::ReadOnly)) return nullptr;
+    auto snapshot = fromJson(QJsonDocument::fromJson(file.readAll()).object());
+    if (snapshot) {
+        std::lock_guard<std::mutex> lock(probeCacheMutex);
+        probeCache()[key] = snapshot;
+    }
+    return snapshot;
+}
+
+void MediaProbe::store(const std::string &url, const std::shared_ptr<const MediaInfoSnapshot> &snapshot) {
+    if (!snapshot) return;
+    const QString key = MediaCache::fileKey(QString::fromStdString(url));
+    if (key.isEmpty()) return;
+    {
+        std::lock_guard<std::mutex> lock(probeCacheMutex);
+        auto &entry = probeCache()[key];
+        if (entry && entry->metadata == snapshot->metadata) return; // Already on disk
+        entry = snapshot;
+    }
+
+    const QString path = cacheFile(key);
+    if (path.isEmpty()) return;
+    QSaveFile file(path);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(toJson(*snapshot)).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+}
+
+std::shared_ptr<const MediaInfoSnapshot> MediaProbe::probe(const std::string &url, const std::atomic<bool> *cancel) {
+    if (auto snapshot = cached(url)) return snapshot;
+
+    mdk::Player player;
+    auto prepared = std::make_shared<std::promise<bool>>();
+    auto once = std::make_shared<std::atomic<bool>>(false);
+    auto future = prepared->get_future();
+
+    player.setDecoders(mdk::MediaType::Audio, { });
+    player.setMedia(url.c_str());
+    player.prepare(0, [prepared, once](int64_t position, bool *) {
+        if (!once->exchange(true)) prepared->set_value(position >= 0);
+        return true;
+    });
+    while (future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+        if (cancel && *cancel) return nullptr;
+    }
+    if (!future.get()) return nullptr;
+
+    auto snapshot = MediaInfoSnapshot::fromMediaInfo(player.mediaInfo());
+    store(url, snapshot);
+    return snapshot;
+}
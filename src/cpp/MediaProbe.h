@@ -0,0 +1,64 @@
+#ifndef MEDIA_PROBE_H
+#define MEDIA_PROBE_H
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+
+namespace mdk { struct MediaInfo; }
+
+// Must match `MediaSummary` in video_player.rs
+struct MediaSummary {
+    double durationMs{0.0};
+    double startTimeMs{0.0};
+    int64_t bitRate{0};
+    int64_t size{0};
+    uint32_t streams{0};
+    // First video stream, zero if there's none
+    uint32_t width{0};
+    uint32_t height{0};
+    int32_t rotation{0};
+    double frameRate{0.0};
+    int64_t frames{0};
+    double videoDurationMs{0.0};
+    int64_t videoBitRate{0};
+    // First audio stream, zero if there's none
+    uint32_t channels{0};
+    uint32_t sampleRate{0};
+    double audioDurationMs{0.0};
+    bool hasVideo{false};
+    bool hasAudio{false};
+};
+
+// Immutable copy of the parts of mdk::MediaInfo used by this library. Taken once when the media info changes,
+// so queries don't copy the whole mdk structure and the metadata isn't formatted again on every use
+struct MediaInfoSnapshot {
+    MediaSummary summary;
+    std::string format;
+    std::string videoCodec;
+    std::string audioCodec;
+    // Flat "stream.video[0].codec.width" style keys with string values, as emitted in `metadataLoaded`
+    QJsonObject metadata;
+
+    static std::shared_ptr<const MediaInfoSnapshot> fromMediaInfo(const mdk::MediaInfo &mi);
+};
+
+// Media info of files without keeping a player around, cached in memory and in the cache directory
+// keyed by the file identity, so opening a known file again doesn't probe it
+class MediaProbe {
+public:
+    // Returns the cached snapshot, or opens the file and waits until it's prepared. Null if it can't be opened or `cancel` was set
+    static std::shared_ptr<const MediaInfoSnapshot> probe(const std::string &url, const std::atomic<bool> *cancel = nullptr);
+    // Null if the file isn't cached
+    static std::shared_ptr<const MediaInfoSnapshot> cached(const std::string &url);
+    // Adds the snapshot of a file which was opened anyway, e.g. by a player
+    static void store(const std::string &url, const std::shared_ptr<const MediaInfoSnapshot> &snapshot);
+
+private:
+    static QString cacheFile(const QString &key);
+};
+
+#endif
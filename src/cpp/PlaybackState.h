@@ -0,0 +1,66 @@
+#ifndef PLAYBACK_STATE_H
+#define PLAYBACK_STATE_H
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+
+// Must match `PlaybackSnapshot` in video_player.rs
+struct PlaybackSnapshot {
+    double timestampMs{0.0};
+    int64_t frame{0};
+    uint64_t updates{0}; // Number of position updates so far, changes whenever the position does
+    bool playing{false};
+    bool buffering{false};
+};
+
+// Latest position and state of a player, readable from any thread without locking.
+// The position has a single writer (the render thread) and is published through a sequence counter, so a reader never sees
+// the timestamp of one frame with the number of another. The flags are independent and may be set from any thread
+class PlaybackState {
+public:
+    void setPosition(double timestampMs, int64_t frame) {
+        const uint64_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed); // Odd while writing
+        std::atomic_thread_fence(std::memory_order_release);
+        m_timestampMs.store(timestampMs, std::memory_order_relaxed);
+        m_frame.store(frame, std::memory_order_relaxed);
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+    // Returns true if the value changed
+    bool setPlaying(bool playing)     { return setFlag(Playing, playing); }
+    bool setBuffering(bool buffering) { return setFlag(Buffering, buffering); }
+
+    PlaybackSnapshot load() const {
+        PlaybackSnapshot ret;
+        uint64_t seq;
+        while (true) {
+            seq = m_seq.load(std::memory_order_acquire);
+            if (seq & 1) { std::this_thread::yield(); continue; }
+            ret.timestampMs = m_timestampMs.load(std::memory_order_relaxed);
+            ret.frame = m_frame.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_seq.load(std::memory_order_relaxed) == seq) break;
+        }
+        ret.updates = seq / 2;
+        const uint32_t flags = m_flags.load(std::memory_order_acquire);
+        ret.playing = flags & Playing;
+        ret.buffering = flags & Buffering;
+        return ret;
+    }
+
+private:
+    enum Flag : uint32_t { Playing = 1, Buffering = 2 };
+
+    bool setFlag(Flag flag, bool set) {
+        const uint32_t prev = set? m_flags.fetch_or(flag, std::memory_order_acq_rel) : m_flags.fetch_and(~uint32_t(flag), std::memory_order_acq_rel);
+        return bool(prev & flag) != set;
+    }
+
+    std::atomic<uint64_t> m_seq{0};
+    std::atomic<double> m_timestampMs{0.0};
+    std::atomic<int64_t> m_frame{0};
+    std::atomic<uint32_t> m_flags{0};
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "PlayerPool.h"
+#include <atomic>
+#include <cstdio>
+#include <algorithm>
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#   include <psapi.h>
+#elif defined(__APPLE__)
+#   include <mach/mach.h>
+#   include <sys/resource.h>
+#else
+#   include <unistd.h>
+#   include <sys/resource.h>
+#endif
+
+#include "mdk/Player.h"
+
+struct PlayerPool::Config {
+    std::string key;
+    std::atomic<bool> dirty{false};
+};
+
+struct PlayerPool::Releaser {
+    std::shared_ptr<Config> config;
+    void operator()(mdk::Player *player) const { PlayerPool::instance().release(player, config); }
+};
+
+PlayerPool &PlayerPool::instance() {
+    // Never destroyed: players may still be released by other static objects during exit
+    static PlayerPool *pool = new PlayerPool();
+    return *pool;
+}
+
+PlayerPool::PlayerPool() {
+    m_thread = std::thread([this] { run(); });
+    m_thread.detach();
+}
+
+std::shared_ptr<mdk::Player> PlayerPool::acquire(const std::vector<std::string> &decoders, const std::vector<std::pair<std::string, std::string>> &properties) {
+    std::string key;
+    for (const auto &x : decoders) key += x + ",";
+    for (const auto &x : properties) key += "\n" + x.first + "=" + x.second;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Most recently used first, its decoder threads are the most likely to be warm
+        for (auto it = m_idle.rbegin(); it != m_idle.rend(); ++it) {
+            if (it->key != key) continue;
+            auto player = std::move(it->player);
+            m_idle.erase(std::next(it).base());
+            m_stats.reused++;
+            return wrap(std::move(player), key);
+        }
+        m_stats.created++;
+    }
+
+    auto player = std::make_unique<mdk::Player>();
+    player->setDecoders(mdk::MediaType::Video, decoders);
+    for (const auto &x : properties) {
+        player->setProperty(x.first, x.second);
+    }
+    return wrap(std::move(player), key);
+}
+
+std::shared_ptr<mdk::Player> PlayerPool::wrap(std::unique_ptr<mdk::Player> player, const std::string &key) {
+    auto config = std::make_shared<Config>();
+    config->key = key;
+    return std::shared_ptr<mdk::Player>(player.release(), Releaser { config });
+}
+
+void PlayerPool::markDirty(const std::shared_ptr<mdk::Player> &player) {
+    if (auto releaser = std::get_deleter<Releaser>(player)) {
+        releaser->config->dirty = true;
+    }
+}
+
+// Called by whichever thread dropped the last reference, so it only queues the player
+void PlayerPool::release(mdk::Player *player, std::shared_ptr<Config> config) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_released.push_back(Idle { std::unique_ptr<mdk::Player>(player), config->dirty? std::string() : config->key });
+    }
+    m_cv.notify_one();
+}
+
+void PlayerPool::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this] { return !m_released.empty(); });
+        Idle entry = std::move(m_released.front());
+        m_released.pop_front();
+        lock.unlock();
+
+        auto player = entry.player.get();
+        player->set(mdk::State::Stopped);
+        player->waitFor(mdk::State::Stopped);
+        // In case the owner left any behind, a listener of a gone owner must not survive into the next one
+        player->onMediaStatusChanged(nullptr);
+        player->onEvent(nullptr);
+        std::vector<Idle> destroy;
+        if (!entry.key.empty()) {
+            // Undo what the items change on their player, decoders and properties stay
+            player->setMute(false);
+            player->setVolume(1.0f);
+            player->setPlaybackRate(1.0f);
+            player->setLoop(0);
+            player->setRange(0);
+            player->rotate(0);
+            player->setBufferRange();
+        }
+
+        lock.lock();
+        if (!entry.key.empty() && m_maxIdle > 0) {
+            m_idle.push_back(std::move(entry));
+        } else {
+            destroy.push_back(std::move(entry));
+        }
+        while (m_idle.size() > m_maxIdle) {
+            destroy.push_back(std::move(m_idle.front()));
+            m_idle.pop_front();
+        }
+        m_stats.destroyed += destroy.size();
+
+        lock.unlock();
+        destroy.clear();
+        lock.lock();
+    }
+}
+
+void PlayerPool::setMaxIdle(size_t count) {
+    std::vector<Idle> destroy;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_maxIdle = count;
+        while (m_idle.size() > m_maxIdle) {
+            destroy.push_back(std::move(m_idle.front()));
+            m_idle.pop_front();
+        }
+        m_stats.destroyed += destroy.size();
+    }
+}
+
+PlayerPoolStats PlayerPool::stats() const {
+    PlayerPoolStats ret;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ret = m_stats;
+        ret.idle = m_idle.size();
+    }
+    ret.alive = ret.created - ret.destroyed;
+    ret.residentBytes = residentMemory();
+    ret.peakResidentBytes = peakResidentMemory();
+    return ret;
+}
+
+uint64_t PlayerPool::residentMemory() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+    return 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS) {
+        return info.resident_size;
+    }
+    return 0;
+#else
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long long size = 0, resident = 0;
+    const int read = fscanf(f, "%llu %llu", &size, &resident);
+    fclose(f);
+    return read == 2? resident * uint64_t(sysconf(_SC_PAGESIZE)) : 0;
+#endif
+}
+
+uint64_t PlayerPool::peakResidentMemory() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#   if defined(__APPLE__)
+    return uint64_t(usage.ru_maxrss); // bytes
+#   else
+    return uint64_t(usage.ru_maxrss) * 1024; // kilobytes
+#   endif
+#endif
+}
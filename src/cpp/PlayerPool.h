@@ -0,0 +1,72 @@
+#ifndef PLAYER_POOL_H
+#define PLAYER_POOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace mdk { class Player; }
+
+// Must match `PlayerPoolStats` in video_player.rs
+struct PlayerPoolStats {
+    uint64_t alive{0};        // Players in use, idle in the pool, or being reset
+    uint64_t idle{0};
+    uint64_t created{0};
+    uint64_t reused{0};       // Acquisitions served by an idle player
+    uint64_t destroyed{0};
+    uint64_t residentBytes{0}; // Resident memory of the whole process, 0 if unknown
+    uint64_t peakResidentBytes{0}; // Highest resident memory of the process so far, 0 if unknown
+};
+
+// Reusable mdk players for the video items, so switching clips doesn't create and tear down a player, its decoders and threads every time.
+// Players are handed out as shared_ptr: when the last reference goes away the player is stopped and reset on the pool thread,
+// then kept idle for the next acquisition with the same configuration, or destroyed if the pool is full.
+// Callbacks and listeners set on the player must be cleared before releasing it, and its renderer released on the thread of its graphics context
+class PlayerPool {
+public:
+    static PlayerPool &instance();
+
+    // Player with `decoders` and `properties` applied, taken from the idle players with the same configuration when there is one
+    std::shared_ptr<mdk::Player> acquire(const std::vector<std::string> &decoders, const std::vector<std::pair<std::string, std::string>> &properties);
+
+    // The player got configuration which a reset doesn't undo (e.g. setProperty), destroy it instead of reusing it
+    static void markDirty(const std::shared_ptr<mdk::Player> &player);
+
+    // Maximum number of idle players kept, 0 disables reuse. Default 2
+    void setMaxIdle(size_t count);
+    PlayerPoolStats stats() const;
+
+    // Resident memory of the process in bytes, 0 if it can't be determined
+    static uint64_t residentMemory();
+    static uint64_t peakResidentMemory();
+
+private:
+    struct Config;
+    struct Releaser;
+    struct Idle {
+        std::unique_ptr<mdk::Player> player;
+        std::string key;
+    };
+
+    PlayerPool();
+
+    std::shared_ptr<mdk::Player> wrap(std::unique_ptr<mdk::Player> player, const std::string &key);
+    void release(mdk::Player *player, std::shared_ptr<Config> config);
+    void run();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Idle> m_idle; // Oldest first
+    std::deque<Idle> m_released; // Waiting to be reset on the pool thread
+    size_t m_maxIdle{2};
+    std::thread m_thread;
+
+    PlayerPoolStats m_stats;
+};
+
+#endif
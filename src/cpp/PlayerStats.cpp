@@ -0,0 +1,146 @@
+#include "PlayerStats.h"
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QSaveFile>
+
+static const char *stageNames[PlayerStats::StageCount] = { "render", "readback", "readbackLatency", "processTexture", "processPixels", "upload", "eventLatency", "seek" };
+
+void PlayerStats::record(Stage stage, Clock::time_point start, Clock::time_point end) {
+    const uint64_t us = uint64_t(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()));
+    auto &h = m_stages[stage];
+    int bucket = 0;
+    while (bucket < bucketCount - 1 && (uint64_t(1) << bucket) <= us) bucket++;
+    h.buckets[bucket]++;
+    h.count++;
+    h.totalUs += us;
+    uint64_t prev = h.maxUs;
+    while (prev < us && !h.maxUs.compare_exchange_weak(prev, us)) { }
+
+    const uint32_t windowMs = m_traceWindowMs;
+    if (windowMs) {
+        std::lock_guard<std::mutex> lock(m_traceMutex);
+        m_trace.push_back({ stage, start, end, std::this_thread::get_id() });
+        const auto oldest = end - std::chrono::milliseconds(windowMs);
+        while (!m_trace.empty() && m_trace.front().end < oldest) m_trace.pop_front();
+    }
+}
+
+void PlayerStats::addRendered(uint32_t frame, bool playing) {
+    m_rendered++;
+    const int64_t prev = m_lastFrame.exchange(frame);
+    // Only forward gaps while playing count, seeks and loops jump on purpose
+    if (playing && prev >= 0 && int64_t(frame) > prev + 1 && int64_t(frame) - prev < 100) {
+        m_dropped += uint64_t(int64_t(frame) - prev - 1);
+    }
+}
+
+StageStats PlayerStats::Histogram::stats() const {
+    StageStats ret;
+    ret.count = count;
+    if (!ret.count) return ret;
+    ret.meanUs = double(totalUs) / double(ret.count);
+    ret.maxUs = double(maxUs);
+
+    auto percentile = [this, &ret](double p) {
+        const uint64_t target = uint64_t(std::ceil(double(ret.count) * p));
+        uint64_t seen = 0;
+        for (int i = 0; i < bucketCount; ++i) {
+            seen += buckets[i];
+            if (seen >= target) return std::min(double(uint64_t(1) << i), ret.maxUs);
+        }
+        return ret.maxUs;
+    };
+    ret.p50Us = percentile(0.50);
+    ret.p95Us = percentile(0.95);
+    ret.p99Us = percentile(0.99);
+    return ret;
+}
+
+PipelineStats PlayerStats::snapshot() const {
+    PipelineStats ret;
+    ret.render         = m_stages[Render].stats();
+    ret.readback       = m_stages[Readback].stats();
+    ret.readbackLatency = m_stages[ReadbackLatency].stats();
+    ret.processTexture = m_stages[ProcessTexture].stats();
+    ret.processPixels  = m_stages[ProcessPixels].stats();
+    ret.upload         = m_stages[Upload].stats();
+    ret.eventLatency   = m_stages[EventLatency].stats();
+    ret.seek           = m_stages[Seek].stats();
+    ret.renderedFrames = m_rendered;
+    ret.droppedFrames  = m_dropped;
+    ret.skippedPasses  = m_skippedPasses;
+    return ret;
+}
+
+QJsonObject PlayerStats::toJson() const {
+    QJsonObject obj;
+    for (int i = 0; i < StageCount; ++i) {
+        const StageStats s = m_stages[i].stats();
+        QJsonObject stage;
+        stage.insert("count", double(s.count));
+        stage.insert("meanUs", s.meanUs);
+        stage.insert("p50Us", s.p50Us);
+        stage.insert("p95Us", s.p95Us);
+        stage.insert("p99Us", s.p99Us);
+        stage.insert("maxUs", s.maxUs);
+        obj.insert(stageNames[i], stage);
+    }
+    obj.insert("renderedFrames", double(m_rendered));
+    obj.insert("droppedFrames", double(m_dropped));
+    obj.insert("skippedPasses", double(m_skippedPasses));
+    return obj;
+}
+
+void PlayerStats::reset() {
+    for (auto &h : m_stages) {
+        for (auto &x : h.buckets) x = 0;
+        h.count = 0;
+        h.totalUs = 0;
+        h.maxUs = 0;
+    }
+    m_rendered = 0;
+    m_dropped = 0;
+    m_skippedPasses = 0;
+    m_lastFrame = -1;
+}
+
+void PlayerStats::startTrace(uint32_t windowMs) {
+    std::lock_guard<std::mutex> lock(m_traceMutex);
+    m_traceWindowMs = windowMs;
+    m_trace.clear();
+}
+
+bool PlayerStats::writeTrace(const QString &path) const {
+    std::deque<TraceEvent> trace;
+    {
+        std::lock_guard<std::mutex> lock(m_traceMutex);
+        trace = m_trace;
+    }
+
+    // Small sequential thread ids read better in the viewers than hashes
+    std::map<std::thread::id, int> threads;
+    QJsonArray events;
+    for (const auto &x : trace) {
+        const int tid = threads.emplace(x.thread, int(threads.size()) + 1).first->second;
+        QJsonObject event;
+        event.insert("name", stageNames[x.stage]);
+        event.insert("cat", "mdkplayer");
+        event.insert("ph", "X");
+        event.insert("ts", double(std::chrono::duration_cast<std::chrono::microseconds>(x.start.time_since_epoch()).count()));
+        event.insert("dur", double(std::chrono::duration_cast<std::chrono::microseconds>(x.end - x.start).count()));
+        event.insert("pid", 1);
+        event.insert("tid", tid);
+        events.append(event);
+    }
+    QJsonObject root;
+    root.insert("traceEvents", events);
+    root.insert("displayTimeUnit", "ms");
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
@@ -0,0 +1,98 @@
+#ifndef PLAYER_STATS_H
+#define PLAYER_STATS_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+
+// Must match `StageStats` in video_player.rs. Times in microseconds, percentiles are bucket upper bounds
+struct StageStats {
+    uint64_t count{0};
+    double meanUs{0.0};
+    double p50Us{0.0};
+    double p95Us{0.0};
+    double p99Us{0.0};
+    double maxUs{0.0};
+};
+
+// Must match `PipelineStats` in video_player.rs
+struct PipelineStats {
+    StageStats render;         // renderVideo() or the frame cache copy
+    StageStats readback;       // Blocking readback: waiting for the GPU to read the texture back
+    StageStats readbackLatency; // Asynchronous readback: from queuing it until the pixels are delivered, spans several frames
+    StageStats processTexture; // The processTexture callback
+    StageStats processPixels;  // The processPixels or processPixelsInPlace callback
+    StageStats upload;         // Uploading the processed pixels
+    StageStats eventLatency;   // From queuing the position notification until the GUI thread picks it up
+    StageStats seek;           // From issuing a seek until the frame it landed on is rendered
+    uint64_t renderedFrames{0};
+    uint64_t droppedFrames{0};  // Frame numbers skipped during playback, and readbacks dropped for a slow consumer
+    uint64_t skippedPasses{0};  // beforeRendering without a new frame
+};
+
+// Per-player timing of the frame pipeline. Stages are recorded from the render and GUI threads without locking, as
+// log2 histograms of microseconds. When tracing, the events of the last `windowMs` are also kept for a Chrome trace dump
+class PlayerStats {
+public:
+    enum Stage { Render, Readback, ReadbackLatency, ProcessTexture, ProcessPixels, Upload, EventLatency, Seek, StageCount };
+    using Clock = std::chrono::steady_clock;
+
+    // Records the time from construction to destruction
+    struct Scope {
+        Scope(PlayerStats &stats, Stage stage) : stats(stats), stage(stage), start(Clock::now()) { }
+        ~Scope() { stats.record(stage, start, Clock::now()); }
+        PlayerStats &stats;
+        Stage stage;
+        Clock::time_point start;
+    };
+
+    void record(Stage stage, Clock::time_point start, Clock::time_point end);
+    void addRendered(uint32_t frame, bool playing);
+    void addDropped(uint64_t count) { m_dropped += count; }
+    void addSkippedPass() { m_skippedPasses++; }
+    uint64_t skippedPasses() const { return m_skippedPasses; }
+
+    PipelineStats snapshot() const;
+    QJsonObject toJson() const;
+    void reset();
+
+    // Keeps the events of the last `windowMs` until stopTrace(). 0 stops tracing
+    void startTrace(uint32_t windowMs);
+    void stopTrace() { startTrace(0); }
+    // Chrome trace event format, loads in chrome://tracing and Perfetto
+    bool writeTrace(const QString &path) const;
+
+private:
+    static constexpr int bucketCount = 32; // Bucket i holds durations below 2^i us
+    struct Histogram {
+        std::atomic<uint64_t> buckets[bucketCount];
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> totalUs{0};
+        std::atomic<uint64_t> maxUs{0};
+        Histogram() { for (auto &x : buckets) x = 0; }
+        StageStats stats() const;
+    };
+    struct TraceEvent {
+        Stage stage;
+        Clock::time_point start;
+        Clock::time_point end;
+        std::thread::id thread;
+    };
+
+    Histogram m_stages[StageCount];
+    std::atomic<uint64_t> m_rendered{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_skippedPasses{0};
+    std::atomic<int64_t> m_lastFrame{-1};
+
+    std::atomic<uint32_t> m_traceWindowMs{0};
+    mutable std::mutex m_traceMutex;
+    std::deque<TraceEvent> m_trace;
+};
+
+#endif
@@ -0,0 +1,524 @@
+#include "ProcessingSession.h"
+#include "FrameConverter.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <algorithm>
+#include <QtCore/QDebug>
+
+#include "mdk/Player.h"
+#include "mdk/VideoFrame.h"
+
+struct ProcessingSession::Frame {
+    int32_t frame{0};
+    double timestamp{0.0};
+    mdk::VideoFrame image;
+
+    // Output of the built-in converter, used instead of `image` when not empty
+    std::vector<uint8_t> pixels;
+    uint32_t width{0};
+    uint32_t height{0};
+};
+
+struct ProcessingSession::Segment {
+    std::unique_ptr<mdk::Player> player;
+    std::vector<std::pair<uint64_t, uint64_t>> ranges; // ms
+    size_t rangeIndex{0};
+
+    size_t groupFirst{0};       // First segment of the requested range this segment belongs to
+    bool alignToKeyframe{false}; // Starts inside a requested range, its real start is the keyframe found by the seek
+    bool joinsNext{false};       // The next segment continues the same range, so this one ends where the next one starts
+
+    std::promise<double> startPromise;
+    std::shared_future<double> start;
+    bool startPublished{false};
+
+    bool resolved{false};
+    double from{-DBL_MAX};
+    double to{DBL_MAX};
+
+    bool finished{false};
+    std::deque<Frame> buffer;
+
+    FrameConverter converter;
+};
+
+static int32_t frameNumber(double timestamp, double fps) {
+    return std::ceil(std::round(timestamp * fps * 100.0) / 100.0);
+}
+
+ProcessingSession::ProcessingSession(const std::string &url, const ProcessingOptions &options, VideoProcessCb &&cb) : m_url(url), m_options(options), m_cb(std::move(cb)) { }
+
+ProcessingSession::~ProcessingSession() {
+    stop();
+}
+
+void ProcessingSession::start(uint64_t width, uint64_t height, bool yuv, const std::string &customDecoder, const std::vector<std::pair<uint64_t, uint64_t>> &requestedRanges, double durationMs) {
+    m_width = width;
+    m_height = height;
+    m_yuv = yuv;
+
+    auto ranges = requestedRanges;
+    if (ranges.empty()) {
+        ranges.push_back({ 0, UINT64_MAX });
+    }
+
+    const uint32_t parallel = std::max<uint32_t>(1, m_options.parallelSegments);
+    if (parallel == 1 || durationMs <= 0.0) {
+        // Single player going through all ranges in order
+        addSegment(std::move(ranges), 0, false, false);
+    } else {
+        double total = 0.0;
+        for (auto &r : ranges) {
+            r.second = std::min<uint64_t>(r.second, uint64_t(durationMs));
+            if (r.second > r.first) total += double(r.second - r.first);
+        }
+        const double pieceLength = std::max(1000.0, total / parallel); // Don't bother splitting below one second
+
+        for (const auto &r : ranges) {
+            if (r.second <= r.first) continue;
+            const size_t pieces = std::max<size_t>(1, size_t(std::ceil(double(r.second - r.first) / pieceLength)));
+            const size_t groupFirst = m_segments.size();
+            for (size_t i = 0; i < pieces; ++i) {
+                const uint64_t from = r.first + uint64_t(double(r.second - r.first) * i / pieces);
+                const uint64_t to = (i + 1 == pieces)? r.second : r.first + uint64_t(double(r.second - r.first) * (i + 1) / pieces);
+                addSegment({ { from, to } }, groupFirst, i > 0, i + 1 < pieces);
+            }
+        }
+        if (m_segments.empty()) {
+            addSegment({ { 0, UINT64_MAX } }, 0, false, false);
+        }
+    }
+
+    if (m_options.queueDepth > 0) {
+        const auto policy = m_options.queuePolicy == 1? FrameQueue<Frame>::Policy::DropOldest
+                          : m_options.queuePolicy == 2? FrameQueue<Frame>::Policy::DropNewest
+                          :                             FrameQueue<Frame>::Policy::Block;
+        m_queue = std::make_unique<FrameQueue<Frame>>(m_options.queueDepth, policy);
+        m_consumer = std::thread([this] { consume(); });
+    }
+
+    const auto videoDecoders = customDecoder.empty()? decoders() : std::vector<std::string> { customDecoder };
+    for (size_t i = 0; i < m_segments.size(); ++i) {
+        auto &seg = *m_segments[i];
+        auto player = seg.player.get();
+        player->setDecoders(mdk::MediaType::Video, videoDecoders);
+
+        player->setMedia(m_url.c_str());
+
+        player->setDecoders(mdk::MediaType::Audio, { });
+        player->setMute(true);
+        player->onSync([] { return DBL_MAX; });
+        player->onFrame<mdk::VideoFrame>([this, i](mdk::VideoFrame &v, int) -> int { return onFrame(i, v); });
+        player->setVideoSurfaceSize(64, 64);
+
+        player->prepare(seg.ranges[0].first, nullptr, seg.alignToKeyframe? mdk::SeekFlag::FromStart | mdk::SeekFlag::KeyFrame : mdk::SeekFlag::FromStart);
+        player->set(mdk::State::Running);
+    }
+}
+
+// Default decoders with the options of the reduced-cost modes. The output size decides how much resolution the decoder can skip
+std::vector<std::string> ProcessingSession::decoders() const {
+    std::string ffmpeg = "FFmpeg", braw = "BRAW:gpu=auto", r3d = "R3D:gpu=auto";
+    if (m_options.decoderScale && m_width && m_height) {
+        // FFmpeg clamps lowres to what the codec supports
+        int lowres = 0;
+        while (m_sourceWidth && m_sourceHeight && lowres < 3 && (m_sourceWidth >> (lowres + 1)) >= m_width && (m_sourceHeight >> (lowres + 1)) >= m_height) lowres++;
+        if (lowres > 0) ffmpeg += ":lowres=" + std::to_string(lowres);
+
+        const std::string scale = ":scale=" + std::to_string(m_width) + "x" + std::to_string(m_height);
+        braw += scale;
+        r3d  += scale;
+    }
+    if (m_options.keyframesOnly) {
+        ffmpeg += ":skip_frame=nokey";
+    } else if (m_options.skipNonReference) {
+        ffmpeg += ":skip_frame=noref";
+    }
+    return { ffmpeg, braw, r3d };
+}
+
+void ProcessingSession::addSegment(std::vector<std::pair<uint64_t, uint64_t>> &&ranges, size_t groupFirst, bool alignToKeyframe, bool joinsNext) {
+    auto seg = std::make_unique<Segment>();
+    seg->player = std::make_unique<mdk::Player>();
+    seg->ranges = std::move(ranges);
+    seg->groupFirst = groupFirst;
+    seg->alignToKeyframe = alignToKeyframe;
+    seg->joinsNext = joinsNext;
+    seg->start = seg->startPromise.get_future().share();
+    m_segments.push_back(std::move(seg));
+}
+
+void ProcessingSession::stop() {
+    if (m_queue) {
+        // Wakes up a decoder blocked on a full queue, which may be holding m_mutex
+        m_queue->abort();
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished = true;
+    }
+    m_cv.notify_all();
+    // Unblock segments which may still wait for their neighbours' start
+    for (auto &seg : m_segments) {
+        publishStart(*seg, DBL_MAX);
+    }
+    for (auto &seg : m_segments) {
+        seg->player->set(mdk::State::Stopped);
+        seg->player->waitFor(mdk::State::Stopped);
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        finishAll();
+    }
+    if (m_consumer.joinable()) {
+        m_consumer.join();
+    }
+}
+
+bool ProcessingSession::queueStats(FrameQueueStats &stats) const {
+    if (!m_queue) return false;
+    stats = m_queue->stats();
+    return true;
+}
+
+bool ProcessingSession::converterStats(ConverterStats &stats) const {
+    if (!m_options.compareConverter) return false;
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    stats = m_converterStats;
+    return true;
+}
+
+void ProcessingSession::publishStart(Segment &seg, double timestamp) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (seg.startPublished) return;
+    seg.startPublished = true;
+    seg.startPromise.set_value(timestamp);
+}
+
+// Segments of one range start at the keyframe found by their seek, which is only known after decoding their first frame.
+// Every segment publishes its start and then takes the bounds from its neighbours, so each frame is delivered exactly once.
+bool ProcessingSession::resolveBounds(size_t index, double firstTimestamp) {
+    auto &seg = *m_segments[index];
+    publishStart(seg, seg.alignToKeyframe? firstTimestamp : -DBL_MAX);
+
+    // A keyframe seek may land outside of the requested range, the bounds never go past it
+    const double rangeFrom = double(m_segments[seg.groupFirst]->ranges.front().first);
+    const double rangeTo = double(seg.ranges.back().second);
+
+    double from = rangeFrom;
+    for (size_t j = seg.groupFirst; j <= index; ++j) {
+        from = std::max(from, m_segments[j]->start.get());
+    }
+    double to = rangeTo;
+    if (seg.joinsNext) {
+        to = std::min(rangeTo, std::max(from, m_segments[index + 1]->start.get()));
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    seg.from = from;
+    seg.to = to;
+    seg.resolved = true;
+    return !m_finished;
+}
+
+int ProcessingSession::onFrame(size_t index, mdk::VideoFrame &v) {
+    auto &seg = *m_segments[index];
+    if (seg.finished) return 0;
+    if (!v || v.timestamp() == mdk::TimestampEOS) { // AOT frame(1st frame, seek end 1st frame) is not valid, but format is valid. eof frame format is invalid
+        publishStart(seg, DBL_MAX);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        finishSegment(index);
+        return 0;
+    }
+    if (!v.format()) {
+        printf("error occured!\n");
+        return 0;
+    }
+
+    const double timestamp_ms = v.timestamp() * 1000.0;
+
+    if (!seg.resolved && !resolveBounds(index, timestamp_ms)) return 0;
+    if (timestamp_ms < seg.from) return 0; // Already delivered by the previous segment
+    // The next segment starts there. The last segment of a range delivers its first frame past the end, like a single decoder, see below
+    if (seg.joinsNext && timestamp_ms >= seg.to) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        finishSegment(index);
+        return 0;
+    }
+
+    if (!m_infoValid) {
+        const auto md = seg.player->mediaInfo();
+        if (md.video.empty()) return 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const auto &vmd = md.video[0];
+        m_orgWidth   = vmd.codec.width;
+        m_orgHeight  = vmd.codec.height;
+        m_fps        = vmd.codec.frame_rate;
+        m_durationMs = vmd.duration;
+        m_frameCount = m_index? uint32_t(m_index->frameCount()) : vmd.frames;
+        m_isR3d      = !strcmp(md.format, "r3d");
+        m_fullRange  = vmd.codec.format_name && !strncmp(vmd.codec.format_name, "yuvj", 4);
+        // e.g. yuv420p10le or p010le, the hardware surfaces of these streams hold more than 8 bits
+        m_highBitDepth = vmd.codec.format_name && (strstr(vmd.codec.format_name, "10") || strstr(vmd.codec.format_name, "12") || strstr(vmd.codec.format_name, "16"));
+        m_infoValid  = true;
+    }
+
+    Frame f;
+    f.frame = m_index? int32_t(m_index->frameAt(timestamp_ms)) : frameNumber(v.timestamp(), m_fps);
+    f.timestamp = timestamp_ms;
+    // Numbered by position in the file, so the stride picks the same frames whatever the decoder skipped
+    if (m_options.frameStride <= 1 || f.frame % int32_t(m_options.frameStride) == 0) {
+        if (m_options.outputFormat == 4) {
+            // The frame holds a reference to the decoder's buffers, so they stay valid while it's queued
+            f.image = v.bufferData(0)? v : v.to(m_highBitDepth? mdk::PixelFormat::P010LE : mdk::PixelFormat::NV12);
+        } else if (!convert(seg, v, f)) {
+            if (m_options.outputFormat == 3) {
+                // Only the built-in converter produces GRAY8, VideoFrame::to would hand the callback RGBA
+                qWarning("ProcessingSession: GRAY8 output is not supported for pixel format %d", int(v.format()));
+                std::unique_lock<std::mutex> lock(m_mutex);
+                for (auto &s : m_segments) {
+                    s->player->set(mdk::State::Paused);
+                }
+                finishAll();
+                return 0;
+            }
+            auto format = m_yuv? mdk::PixelFormat::YUV420P : mdk::PixelFormat::RGBA;
+            if (m_options.outputFormat == 1) format = mdk::PixelFormat::RGBA;
+            if (m_options.outputFormat == 2 || m_isR3d) format = mdk::PixelFormat::BGRA;
+            f.image = v.to(format, m_width? int(m_width) : v.width(), m_height? int(m_height) : v.height());
+        }
+
+        // A full queue is waited for here and not in deliver(), so stop() and the consumer can take m_mutex meanwhile
+        if (m_queue) m_queue->waitForRoom();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!push(index, std::move(f), lock)) return 0;
+    }
+
+    if (!seg.joinsNext && timestamp_ms >= seg.ranges[seg.rangeIndex].second) {
+        if (seg.rangeIndex + 1 < seg.ranges.size()) {
+            seg.rangeIndex += 1;
+            seg.player->seek(seg.ranges[seg.rangeIndex].first, mdk::SeekFlag::FromStart);
+            return 0;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        finishSegment(index);
+    }
+
+    return 0;
+}
+
+// Colour conversion and scaling in one pass straight from the decoded planes.
+// Returns false if the frame has to go through VideoFrame::to instead (hardware frames, other pixel formats, YUV output).
+bool ProcessingSession::convert(Segment &seg, mdk::VideoFrame &v, Frame &f) {
+    FrameConverter::Target target;
+    switch (m_options.outputFormat) {
+        case 1: target = FrameConverter::Target::RGBA; break;
+        case 2: target = FrameConverter::Target::BGRA; break;
+        case 3: target = FrameConverter::Target::GRAY8; break;
+        default:
+            if (m_yuv) return false;
+            target = FrameConverter::Target::RGBA;
+    }
+    if (m_isR3d && target == FrameConverter::Target::RGBA) target = FrameConverter::Target::BGRA;
+    if (!m_options.builtinConverter && target != FrameConverter::Target::GRAY8) return false;
+
+    mdk::VideoFrame source = v;
+    FrameConverter::Planes planes;
+    if (!FrameConverter::planesFromFrame(source, planes)) {
+        if (target != FrameConverter::Target::GRAY8) return false;
+        // VideoFrame::to can't produce GRAY8, so convert to planar first
+        source = v.to(mdk::PixelFormat::YUV420P);
+        if (!FrameConverter::planesFromFrame(source, planes)) return false;
+    }
+    // mdk frames don't carry the matrix and range, the pixel format of the stream tells JPEG (full range BT.601) apart
+    if (m_fullRange) {
+        planes.fullRange = true;
+        planes.matrix = FrameConverter::Matrix::BT601;
+    }
+
+    const uint32_t width  = m_width?  uint32_t(m_width)  : planes.width;
+    const uint32_t height = m_height? uint32_t(m_height) : planes.height;
+    const size_t stride = size_t(width) * FrameConverter::bytesPerPixel(target);
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        if (!m_freeBuffers.empty()) {
+            f.pixels = std::move(m_freeBuffers.back());
+            m_freeBuffers.pop_back();
+        }
+    }
+    f.pixels.resize(stride * height);
+    const auto started = std::chrono::steady_clock::now();
+    if (!seg.converter.convert(planes, target, width, height, f.pixels.data(), stride, m_options.scaleFilter == 1? FrameConverter::Filter::Area : FrameConverter::Filter::Bilinear)) {
+        f.pixels.clear();
+        return false;
+    }
+    f.width = width;
+    f.height = height;
+    if (m_options.compareConverter && target != FrameConverter::Target::GRAY8) {
+        compare(v, f, target == FrameConverter::Target::BGRA, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count());
+    }
+    return true;
+}
+
+// Converts the same frame again with VideoFrame::to, and records the time of both and how far apart the results are
+void ProcessingSession::compare(mdk::VideoFrame &v, const Frame &f, bool bgra, double builtinMs) {
+    const auto started = std::chrono::steady_clock::now();
+    const mdk::VideoFrame ref = v.to(bgra? mdk::PixelFormat::BGRA : mdk::PixelFormat::RGBA, int(f.width), int(f.height));
+    const double mdkMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    const uint8_t *bits = ref.bufferData();
+    if (!bits || uint32_t(ref.width()) != f.width || uint32_t(ref.height()) != f.height) return;
+
+    const size_t stride = size_t(f.width) * 4;
+    const size_t refStride = size_t(ref.bytesPerLine());
+    uint32_t maxDiff = 0;
+    uint64_t sum = 0;
+    for (uint32_t y = 0; y < f.height; ++y) {
+        const uint8_t *a = f.pixels.data() + y * stride;
+        const uint8_t *b = bits + y * refStride;
+        for (size_t x = 0; x < stride; ++x) {
+            if ((x & 3) == 3) continue; // Alpha
+            const uint32_t d = uint32_t(std::abs(int(a[x]) - int(b[x])));
+            maxDiff = std::max(maxDiff, d);
+            sum += d;
+        }
+    }
+    const double samples = double(f.width) * f.height * 3;
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    auto &s = m_converterStats;
+    s.meanDiff   = (s.meanDiff * double(s.frames) + sum / samples) / double(s.frames + 1);
+    s.frames    += 1;
+    s.builtinMs += builtinMs;
+    s.mdkMs     += mdkMs;
+    s.maxDiff    = std::max(s.maxDiff, maxDiff);
+}
+
+bool ProcessingSession::push(size_t index, Frame &&f, std::unique_lock<std::mutex> &lock) {
+    if (m_finished) return false;
+    if (m_options.ordered && m_segments.size() > 1) {
+        m_cv.wait(lock, [&] { return m_finished || index == m_head || m_buffered < std::max<uint32_t>(1, m_options.reorderBufferFrames); });
+        if (m_finished) return false;
+        if (index != m_head) {
+            m_segments[index]->buffer.push_back(std::move(f));
+            m_buffered++;
+            return true;
+        }
+    }
+    return deliver(f);
+}
+
+bool ProcessingSession::deliver(Frame &f) {
+    if (m_finished) return false;
+
+    if (m_queue) {
+        // Never blocks with m_mutex held. Other segments or the reorder buffer may take the queue over its capacity by a few frames
+        m_queue->push(std::move(f), false); // A dropped frame is not an error
+        return !m_finished;
+    }
+    if (!invoke(f)) {
+        // If cb returns false - stop the processing
+        for (auto &seg : m_segments) {
+            seg->player->set(mdk::State::Paused);
+        }
+        finishAll();
+        return false;
+    }
+    return true;
+}
+
+bool ProcessingSession::invoke(Frame &f) {
+    if (m_options.outputFormat == 4) {
+        FramePlanes planes;
+        planes.format     = int32_t(f.image.format());
+        planes.width      = uint32_t(f.image.width());
+        planes.height     = uint32_t(f.image.height());
+        planes.planeCount = uint32_t(std::clamp(f.image.planeCount(), 0, 4));
+        for (uint32_t i = 0; i < planes.planeCount; ++i) {
+            planes.data[i]        = f.image.bufferData(int(i));
+            planes.stride[i]      = uint32_t(f.image.bytesPerLine(int(i)));
+            planes.planeHeight[i] = uint32_t(f.image.height(int(i)));
+        }
+        return m_cb(f.frame, f.timestamp, planes.width, planes.height, m_orgWidth, m_orgHeight, m_fps, m_durationMs, m_frameCount, planes.data[0], uint64_t(planes.stride[0]) * planes.planeHeight[0], &planes);
+    }
+
+    const bool converted = !f.pixels.empty();
+    auto ptr      = converted? f.pixels.data() : f.image.bufferData();
+    auto ptr_size = converted? f.pixels.size() : f.image.bytesPerLine() * f.image.height();
+    auto width    = converted? f.width  : f.image.width();
+    auto height   = converted? f.height : f.image.height();
+
+    const bool ok = m_cb(f.frame, f.timestamp, width, height, m_orgWidth, m_orgHeight, m_fps, m_durationMs, m_frameCount, ptr, ptr_size, nullptr);
+    if (converted) {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        m_freeBuffers.push_back(std::move(f.pixels));
+    }
+    return ok;
+}
+
+// Runs the callback on its own thread when the session uses a queue, and sends the final frame -1 once the queue is done
+void ProcessingSession::consume() {
+    Frame f;
+    while (m_queue->pop(f)) {
+        if (!invoke(f)) {
+            // If cb returns false - stop the processing
+            m_queue->abort();
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (auto &seg : m_segments) {
+                seg->player->set(mdk::State::Paused);
+            }
+            finishAll();
+            break;
+        }
+    }
+    m_cb(-1, -1.0, 0, 0, 0, 0, 0, 0, 0, 0, 0, nullptr);
+}
+
+void ProcessingSession::finishSegment(size_t index) {
+    auto &seg = *m_segments[index];
+    if (seg.finished) return;
+    seg.finished = true;
+    seg.player->set(mdk::State::Paused);
+
+    if (m_options.ordered) {
+        advanceHead();
+    }
+    if (std::all_of(m_segments.begin(), m_segments.end(), [](const auto &x) { return x->finished; })) {
+        finishAll();
+    }
+    m_cv.notify_all();
+}
+
+void ProcessingSession::advanceHead() {
+    while (m_head < m_segments.size() && m_segments[m_head]->finished && !m_finished) {
+        m_head++;
+        if (m_head >= m_segments.size()) break;
+        auto &next = *m_segments[m_head];
+        while (!next.buffer.empty()) {
+            Frame f = std::move(next.buffer.front());
+            next.buffer.pop_front();
+            m_buffered--;
+            if (!deliver(f)) return;
+        }
+    }
+    m_cv.notify_all();
+}
+
+void ProcessingSession::finishAll() {
+    m_finished = true;
+    for (auto &seg : m_segments) {
+        m_buffered -= seg->buffer.size();
+        seg->buffer.clear();
+    }
+    if (m_queue) {
+        m_queue->close(); // The consumer sends the end after the queued frames
+    } else if (!m_endSent) {
+        m_endSent = true;
+        m_cb(-1, -1.0, 0, 0, 0, 0, 0, 0, 0, 0, 0, nullptr);
+    }
+    m_cv.notify_all();
+}
@@ -0,0 +1,156 @@
+#ifndef PROCESSING_SESSION_H
+#define PROCESSING_SESSION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include "FrameQueue.h"
+#include "FrameIndex.h"
+
+// Must match `FramePlanes` in video_player.rs
+struct FramePlanes {
+    int32_t format{-1}; // mdk::PixelFormat of the decoded frame
+    uint32_t width{0};  // Frame size, i.e. the size of the luma plane
+    uint32_t height{0};
+    uint32_t planeCount{0};
+    const uint8_t *data[4]{};
+    uint32_t stride[4]{};      // In bytes
+    uint32_t planeHeight[4]{}; // Rows, so a plane is stride * planeHeight bytes
+};
+
+// `planes` is only set with ProcessingOptions::outputFormat 4, and only valid until the callback returns. `bits` is the first plane then
+typedef std::function<bool(int32_t frame, double timestamp, uint32_t width, uint32_t height, uint32_t org_width, uint32_t org_height, double fps, double duration_ms, uint32_t frame_count, const uint8_t *bits, uint64_t bitsSize, const FramePlanes *planes)> VideoProcessCb;
+
+// Must match `ProcessingOptions` in video_player.rs
+struct ProcessingOptions {
+    // Number of decoder instances, each working on its own keyframe aligned part of the requested ranges
+    uint32_t parallelSegments{1};
+    // With multiple segments, deliver frames in presentation order. Otherwise frames are delivered as soon as they are decoded
+    bool ordered{true};
+    // Maximum number of frames held back by the reorder buffer
+    uint32_t reorderBufferFrames{64};
+    // Convert and scale 8 and 10 bit 4:2:0 frames with the built-in SIMD kernels instead of VideoFrame::to
+    bool builtinConverter{false};
+    // 0: RGBA, or YUV420P if requested by `yuv`, 1: RGBA, 2: BGRA, 3: GRAY8 (always uses the built-in converter),
+    // 4: the planes as decoded, without conversion, scaling or copy. Hardware frames are downloaded as NV12, or P010LE when the stream has more than 8 bits
+    uint32_t outputFormat{0};
+    // Built-in converter only. 0: bilinear, 1: area average (better quality when downscaling a lot)
+    uint32_t scaleFilter{0};
+    // When > 0, decoded frames go through a queue of this many frames and the callback runs on its own thread,
+    // so decoding doesn't wait for the callback. 0 calls the callback directly from the decoder thread
+    uint32_t queueDepth{0};
+    // What to do when the queue is full. 0: block the decoder, 1: drop the oldest queued frame, 2: drop the new frame
+    uint32_t queuePolicy{0};
+    // Deliver only frames whose number is a multiple of this, the others are decoded but not converted. 0 and 1 deliver every frame
+    uint32_t frameStride{1};
+    // Only decode keyframes (FFmpeg skip_frame=nokey)
+    bool keyframesOnly{false};
+    // Don't decode frames which no other frame references (FFmpeg skip_frame=noref), they are missing from the output
+    bool skipNonReference{false};
+    // keyframesOnly, skipNonReference and decoderScale are options of the default decoders, a custom decoder string is used as is
+    // Decode at a lower resolution when the output size allows it: FFmpeg lowres, BRAW and R3D scale
+    bool decoderScale{false};
+    // Built-in converter only. Also converts every frame with VideoFrame::to and compares the two, see ConverterStats. Slows processing down
+    bool compareConverter{false};
+};
+
+// Must match `ConverterStats` in video_player.rs
+struct ConverterStats {
+    uint64_t frames{0};    // Frames converted both ways
+    double builtinMs{0.0}; // Total time of the built-in converter
+    double mdkMs{0.0};     // Total time of VideoFrame::to on the same frames
+    uint32_t maxDiff{0};   // Largest difference of a colour channel between the two outputs
+    double meanDiff{0.0};  // Average difference per colour channel
+};
+
+namespace mdk { class Player; class VideoFrame; }
+
+// Drives one or more processing players over the requested ranges and delivers the converted frames to a single callback.
+// The callback is never called concurrently and receives frame -1 exactly once at the end.
+class ProcessingSession {
+public:
+    ProcessingSession(const std::string &url, const ProcessingOptions &options, VideoProcessCb &&cb);
+    ~ProcessingSession();
+
+    void start(uint64_t width, uint64_t height, bool yuv, const std::string &customDecoder, const std::vector<std::pair<uint64_t, uint64_t>> &ranges, double durationMs);
+    void stop();
+
+    // Numbers the delivered frames by their position in the file instead of timestamp * fps. Must be set before start() and be ready
+    void setFrameIndex(std::shared_ptr<const FrameIndex> index) { m_index = std::move(index); }
+    // Coded size of the video, needed to pick the FFmpeg lowres level of ProcessingOptions::decoderScale. Must be set before start()
+    void setSourceSize(uint32_t width, uint32_t height) { m_sourceWidth = width; m_sourceHeight = height; }
+
+    // Returns false if the session doesn't use a queue
+    bool queueStats(FrameQueueStats &stats) const;
+    // Returns false if the session doesn't compare the converters
+    bool converterStats(ConverterStats &stats) const;
+
+private:
+    struct Segment;
+    struct Frame;
+
+    std::vector<std::string> decoders() const;
+    bool convert(Segment &seg, mdk::VideoFrame &v, Frame &f);
+    void compare(mdk::VideoFrame &v, const Frame &f, bool bgra, double builtinMs);
+    void addSegment(std::vector<std::pair<uint64_t, uint64_t>> &&ranges, size_t groupFirst, bool alignToKeyframe, bool joinsNext);
+    int onFrame(size_t index, mdk::VideoFrame &v);
+    bool resolveBounds(size_t index, double firstTimestamp);
+    void publishStart(Segment &seg, double timestamp);
+
+    // All of these require m_mutex to be locked
+    bool push(size_t index, Frame &&f, std::unique_lock<std::mutex> &lock);
+    bool deliver(Frame &f);
+    bool invoke(Frame &f);
+    void finishSegment(size_t index);
+    void advanceHead();
+    void finishAll();
+
+    void consume();
+
+    std::string m_url;
+    ProcessingOptions m_options;
+    VideoProcessCb m_cb;
+
+    uint64_t m_width{0};
+    uint64_t m_height{0};
+    bool m_yuv{false};
+    uint32_t m_sourceWidth{0};
+    uint32_t m_sourceHeight{0};
+
+    std::vector<std::unique_ptr<Segment>> m_segments;
+    std::shared_ptr<const FrameIndex> m_index;
+
+    std::mutex m_buffersMutex;
+    std::vector<std::vector<uint8_t>> m_freeBuffers; // Converter output buffers of delivered frames, reused for the next ones
+
+    std::unique_ptr<FrameQueue<Frame>> m_queue;
+    std::thread m_consumer;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    size_t m_head{0};
+    size_t m_buffered{0};
+    bool m_finished{false};
+    bool m_endSent{false};
+
+    std::atomic<bool> m_infoValid{false};
+    uint32_t m_orgWidth{0};
+    uint32_t m_orgHeight{0};
+    double m_fps{0.0};
+    double m_durationMs{0.0};
+    uint32_t m_frameCount{0};
+    bool m_isR3d{false};
+    bool m_fullRange{false};
+    bool m_highBitDepth{false};
+
+    mutable std::mutex m_statsMutex;
+    ConverterStats m_converterStats;
+};
+
+#endif
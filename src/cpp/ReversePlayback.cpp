@@ -0,0 +1,251 @@
+#include "ReversePlayback.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "mdk/Player.h"
+#include "mdk/VideoFrame.h"
+
+ReversePlayback::ReversePlayback(const std::string &url, std::shared_ptr<const FrameIndex> index) : m_url(url), m_index(std::move(index)) { }
+
+ReversePlayback::~ReversePlayback() {
+    stop();
+}
+
+void ReversePlayback::start(double fromMs, uint32_t width, uint32_t height, bool flipY, uint64_t budgetBytes) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    m_width  = std::max<uint32_t>(2, width);
+    m_height = std::max<uint32_t>(2, height);
+    m_flipY  = flipY;
+    m_budget = budgetBytes;
+    m_capacity = size_t(std::max<uint64_t>(2, budgetBytes / 2 / (uint64_t(m_width) * m_height * 4)));
+    m_upper = fromMs + 1.0; // Includes the frame at fromMs
+
+    m_player = std::make_unique<mdk::Player>();
+    auto player = m_player.get();
+    player->setDecoders(mdk::MediaType::Video, { "FFmpeg", "BRAW:gpu=auto", "R3D:gpu=auto" });
+    player->setDecoders(mdk::MediaType::Audio, { });
+    player->setMedia(m_url.c_str());
+    player->setMute(true);
+    player->onSync([] { return DBL_MAX; });
+    player->onFrame<mdk::VideoFrame>([this](mdk::VideoFrame &v, int) -> int { return onFrame(v); });
+    player->setVideoSurfaceSize(64, 64);
+
+    decodeNext();
+}
+
+void ReversePlayback::stop() {
+    m_stopped = true;
+    // Not under m_mutex, the decoder thread may be waiting for it
+    if (m_player) {
+        m_player->set(mdk::State::Stopped);
+        m_player->waitFor(mdk::State::Stopped);
+    }
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    m_ready.clear();
+    m_decoding.clear();
+}
+
+void ReversePlayback::seek(double fromMs) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    if (m_stopped || !m_player) return;
+    // The decoder is paused at the start of the file or with two chunks ready, the next pass resumes it. Without a pass yet it wasn't prepared
+    m_decoderIdle = m_passes > 0 && (m_decoderIdle || m_atStart);
+    m_atStart = false;
+    m_ready.clear();
+    m_decoding.clear();
+    m_upper = fromMs + 1.0;
+    m_lookback = 2000.0;
+    decodeNext(); // The new seek generation discards the frames of the pass in progress
+}
+
+// Starts the pass which ends at m_upper. Requires m_mutex to be locked
+void ReversePlayback::decodeNext() {
+    if (m_stopped || m_atStart) return;
+    if (m_ready.size() >= 2) {
+        if (!m_decoderIdle) {
+            m_decoderIdle = true;
+            m_player->set(mdk::State::Paused);
+        }
+        return;
+    }
+
+    m_decoding.clear();
+    m_dropped = false;
+    m_keepFrom = -1.0;
+    mdk::SeekFlag flags = mdk::SeekFlag::FromStart | mdk::SeekFlag::KeyFrame;
+    if (m_index) {
+        // Last frame before m_upper
+        int64_t last = m_index->frameAt(m_upper);
+        while (last >= 0 && m_index->timestamp(last) > m_upper - 0.5) last--;
+        if (last < 0) {
+            m_atStart = true;
+            m_player->set(mdk::State::Paused);
+            return;
+        }
+        const int64_t key = m_index->keyframeBefore(last);
+        m_target = m_index->timestamp(key);
+        if (last - key + 1 > int64_t(m_capacity)) {
+            // The beginning of the GOP doesn't fit, it's decoded but not converted
+            m_keepFrom = m_index->timestamp(last - int64_t(m_capacity) + 1);
+        }
+        flags = mdk::SeekFlag::FromStart;
+    } else {
+        m_target = std::max(0.0, m_upper - m_lookback);
+    }
+    m_passes++;
+
+    if (m_passes == 1) {
+        m_player->prepare(int64_t(m_target), [this](int64_t position, bool *) {
+            if (position < 0) { // Can't open the file
+                std::lock_guard<std::recursive_mutex> lock(m_mutex);
+                m_atStart = true;
+            }
+            return true;
+        }, flags);
+        m_player->set(mdk::State::Running);
+        return;
+    }
+
+    const uint64_t generation = ++m_seekIssued;
+    m_player->seek(int64_t(m_target), flags, [this, generation](int64_t) {
+        std::lock_guard<std::recursive_mutex> lock(m_mutex);
+        if (generation == m_seekIssued) m_seekDone = generation;
+    });
+    if (m_decoderIdle) {
+        m_decoderIdle = false;
+        m_player->set(mdk::State::Running);
+    }
+}
+
+int ReversePlayback::onFrame(mdk::VideoFrame &v) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_mutex);
+        // Frames decoded before the last seek completed belong to the previous pass
+        if (m_stopped || m_atStart || m_decoderIdle || m_seekDone != m_seekIssued) return 0;
+
+        if (v.timestamp() == mdk::TimestampEOS || !v.format()) { // eof frame format is invalid
+            finishPass();
+            return 0;
+        }
+        if (!v) return 0; // AOT frame(1st frame, seek end 1st frame) is not valid, but format is valid
+
+        const double timestamp = v.timestamp() * 1000.0;
+        if (timestamp >= m_upper) {
+            finishPass();
+            return 0;
+        }
+        m_decodedFrames++;
+        if (timestamp < m_keepFrom) {
+            m_discardedFrames++;
+            m_dropped = true;
+            return 0;
+        }
+        generation = m_seekIssued;
+    }
+
+    // Converted without the lock, so the render thread isn't held up
+    Frame f;
+    if (!convert(v, f)) return 0;
+
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    if (m_stopped || generation != m_seekIssued) return 0;
+    m_decoding.push_back(std::move(f));
+    if (m_decoding.size() > m_capacity) {
+        m_decoding.pop_front();
+        m_discardedFrames++;
+        m_dropped = true;
+    }
+    return 0;
+}
+
+// The current pass reached m_upper or the end of the file. Requires m_mutex to be locked
+void ReversePlayback::finishPass() {
+    if (m_decoding.empty()) {
+        if (m_index || m_target <= 0.0) { // Nothing before m_upper
+            m_atStart = true;
+            m_player->set(mdk::State::Paused);
+            return;
+        }
+        // The keyframe is further back
+        m_lookback *= 2.0;
+        decodeNext();
+        return;
+    }
+
+    // Everything since the first keyframe is buffered
+    const bool reachedStart = !m_dropped && (m_index? m_index->keyframeBefore(m_index->frameAt(m_target)) <= 0 : m_target <= 0.0);
+
+    m_upper = m_decoding.front().timestamp;
+    m_ready.push_back(std::move(m_decoding));
+    m_decoding = Chunk();
+
+    if (reachedStart) {
+        m_atStart = true;
+        m_player->set(mdk::State::Paused);
+        return;
+    }
+    decodeNext();
+}
+
+bool ReversePlayback::take(double timestampMs, Frame &frame) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    while (!m_ready.empty()) {
+        auto &chunk = m_ready.front();
+        while (!chunk.empty() && chunk.back().timestamp > timestampMs + 0.001) {
+            // The first frame of the file stays, it's shown once playback got there
+            if (m_atStart && m_ready.size() == 1 && chunk.size() == 1) break;
+            chunk.pop_back();
+        }
+        if (!chunk.empty()) {
+            frame = chunk.back(); // Pixels are implicitly shared
+            return true;
+        }
+        m_ready.pop_front();
+        if (m_decoderIdle) decodeNext();
+    }
+    m_starvedFrames++;
+    return false;
+}
+
+bool ReversePlayback::convert(mdk::VideoFrame &v, Frame &f) {
+    const size_t stride = size_t(m_width) * 4;
+    f.timestamp = v.timestamp() * 1000.0;
+    f.size = QSize(int(m_width), int(m_height));
+    f.pixels.resize(qsizetype(stride * m_height));
+    auto dst = reinterpret_cast<uint8_t *>(f.pixels.data());
+
+    FrameConverter::Planes planes;
+    if (!FrameConverter::planesFromFrame(v, planes) || !m_converter.convert(planes, FrameConverter::Target::RGBA, m_width, m_height, dst, stride)) {
+        auto rgba = v.to(mdk::PixelFormat::RGBA, int(m_width), int(m_height));
+        const uint8_t *src = rgba.bufferData();
+        if (!src) return false;
+        const size_t srcStride = rgba.bytesPerLine();
+        const size_t rowSize = std::min(srcStride, stride);
+        for (uint32_t y = 0; y < m_height && y < uint32_t(rgba.height()); ++y) {
+            memcpy(dst + y * stride, src + y * srcStride, rowSize);
+        }
+    }
+    if (m_flipY) {
+        for (uint32_t y = 0; y < m_height / 2; ++y) {
+            std::swap_ranges(dst + y * stride, dst + (y + 1) * stride, dst + (m_height - 1 - y) * stride);
+        }
+    }
+    return true;
+}
+
+ReversePlaybackStats ReversePlayback::stats() const {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    ReversePlaybackStats ret;
+    ret.budgetBytes = m_budget;
+    ret.bufferedFrames = m_decoding.size();
+    for (const auto &chunk : m_ready) ret.bufferedFrames += chunk.size();
+    ret.usedBytes = ret.bufferedFrames * uint64_t(m_width) * m_height * 4;
+    ret.passes = m_passes;
+    ret.decodedFrames = m_decodedFrames;
+    ret.discardedFrames = m_discardedFrames;
+    ret.starvedFrames = m_starvedFrames;
+    return ret;
+}
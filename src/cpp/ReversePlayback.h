@@ -0,0 +1,96 @@
+#ifndef REVERSE_PLAYBACK_H
+#define REVERSE_PLAYBACK_H
+
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <QtCore/QByteArray>
+#include <QtCore/QSize>
+#include "FrameConverter.h"
+#include "FrameIndex.h"
+
+// Must match `ReversePlaybackStats` in video_player.rs
+struct ReversePlaybackStats {
+    uint64_t budgetBytes{0};
+    uint64_t usedBytes{0};
+    uint64_t bufferedFrames{0};
+    uint64_t passes{0};          // Forward decodes from a keyframe
+    uint64_t decodedFrames{0};
+    uint64_t discardedFrames{0}; // Decoded but not kept, they didn't fit in the budget and are decoded again by a later pass
+    uint64_t starvedFrames{0};   // Requested before the decoder got there
+};
+
+namespace mdk { class Player; class VideoFrame; }
+
+// Backwards playback of a file on its own decoder. Each pass seeks to a keyframe and decodes forward up to the oldest frame handed out so far,
+// keeping the converted frames in a chunk which is then presented last frame first. While one chunk is presented the one before it is decoded,
+// and at most two chunks are held, each limited to half of the budget. A GOP which doesn't fit keeps its last frames and the rest is decoded again
+// by the next pass. With a frame index the keyframes are known up front, otherwise the pass seeks further back until it lands before the target
+class ReversePlayback {
+public:
+    struct Frame {
+        double timestamp{0.0}; // ms
+        QSize size;
+        QByteArray pixels; // RGBA, tightly packed
+    };
+
+    ReversePlayback(const std::string &url, std::shared_ptr<const FrameIndex> index);
+    ~ReversePlayback();
+
+    // Frames are scaled to `width` x `height` and stored bottom row first if `flipY` is set, so they can be uploaded as they are
+    void start(double fromMs, uint32_t width, uint32_t height, bool flipY, uint64_t budgetBytes);
+    void stop();
+    // Continues backwards from `fromMs` on the same decoder, the buffered frames are dropped
+    void seek(double fromMs);
+
+    // The frame displayed at `timestampMs`, i.e. the latest buffered one at or before it. Newer frames are released.
+    // Returns false if the decoder didn't get there yet
+    bool take(double timestampMs, Frame &frame);
+    // The first frame of the file is buffered, nothing before it will be decoded
+    bool atStart() const { return m_atStart; }
+
+    ReversePlaybackStats stats() const;
+
+private:
+    typedef std::deque<Frame> Chunk; // Ascending timestamps
+
+    void decodeNext();
+    int onFrame(mdk::VideoFrame &v);
+    void finishPass();
+    bool convert(mdk::VideoFrame &v, Frame &f);
+
+    std::string m_url;
+    std::shared_ptr<const FrameIndex> m_index;
+    std::unique_ptr<mdk::Player> m_player;
+    FrameConverter m_converter;
+
+    uint32_t m_width{0};
+    uint32_t m_height{0};
+    bool m_flipY{false};
+    uint64_t m_budget{0};
+    size_t m_capacity{2}; // Frames per chunk
+
+    mutable std::recursive_mutex m_mutex; // The seek callback may run from inside seek()
+    std::deque<Chunk> m_ready;  // Presented first to last, each chunk is older than the one before it
+    Chunk m_decoding;
+    double m_upper{0.0};        // Exclusive end of the current pass, ms
+    double m_target{0.0};       // Where the current pass seeked to, ms
+    double m_keepFrom{-1.0};    // Frames of the pass before this don't fit in the chunk and aren't converted. Only known with a frame index
+    double m_lookback{2000.0};  // Without a frame index, how far before m_upper the keyframe is searched, ms
+    bool m_dropped{false};      // Frames of the current pass were discarded
+    bool m_decoderIdle{false};  // Two chunks are ready, the decoder waits until one is presented
+    uint64_t m_seekIssued{0};
+    uint64_t m_seekDone{0};
+
+    std::atomic<bool> m_atStart{false};
+    std::atomic<bool> m_stopped{false};
+    uint64_t m_passes{0};
+    uint64_t m_decodedFrames{0};
+    uint64_t m_discardedFrames{0};
+    uint64_t m_starvedFrames{0};
+};
+
+#endif
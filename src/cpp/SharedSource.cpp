@@ -0,0 +1,149 @@
+#include "SharedSource.h"
+#include "FrameIndex.h"
+#include <map>
+#include <algorithm>
+
+#include "mdk/Player.h"
+
+static std::mutex sourcesMutex;
+static thread_local std::vector<const SharedSource *> dispatchingSources; // Sources whose callbacks are running on this thread
+static std::map<std::string, std::weak_ptr<SharedSource>> &sources() {
+    static std::map<std::string, std::weak_ptr<SharedSource>> map;
+    return map;
+}
+
+std::shared_ptr<SharedSource> SharedSource::attach(const std::string &key, void *view, const std::function<std::shared_ptr<mdk::Player>()> &open, bool &created) {
+    std::lock_guard<std::mutex> lock(sourcesMutex);
+    auto &entry = sources()[key];
+    auto source = entry.lock();
+    created = !source;
+    if (!source) {
+        source = std::shared_ptr<SharedSource>(new SharedSource());
+        source->m_key = key;
+        source->m_player = open();
+        source->installCallbacks();
+        entry = source;
+    }
+    std::lock_guard<std::mutex> viewsLock(source->m_mutex);
+    source->m_views.push_back(View { view, { } });
+    return source;
+}
+
+SharedSource::~SharedSource() {
+    {
+        std::lock_guard<std::mutex> lock(sourcesMutex);
+        auto it = sources().find(m_key);
+        if (it != sources().end() && it->second.expired()) sources().erase(it);
+    }
+    if (m_player) {
+        m_player->setRenderCallback([](void *) {});
+        m_player->onStateChanged([](mdk::State) {});
+        m_player->onMediaStatusChanged(nullptr); // Removes the listeners, a callback would add one
+        m_player->onEvent(nullptr);
+    }
+    // A dispatch which started before the callbacks were replaced still uses this object, the ones on this thread are the caller itself
+    const size_t own = size_t(std::count(dispatchingSources.begin(), dispatchingSources.end(), this));
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this, own] { return m_dispatching <= own; });
+}
+
+// The player's callbacks are set once and forwarded to the views, mdk only keeps one of each
+void SharedSource::installCallbacks() {
+    m_player->setRenderCallback([this](void *vo_opaque) {
+        dispatch(vo_opaque, [](const Callbacks &x) { if (x.render) x.render(); });
+    });
+    m_player->onEvent([this](const mdk::MediaEvent &evt) -> bool {
+        dispatch(nullptr, [&evt](const Callbacks &x) { if (x.event) x.event(evt); });
+        return true;
+    });
+    m_player->onStateChanged([this](mdk::State state) {
+        dispatch(nullptr, [state](const Callbacks &x) { if (x.state) x.state(state); });
+    });
+    m_player->onMediaStatusChanged([this](mdk::MediaStatus status) -> bool {
+        dispatch(nullptr, [status](const Callbacks &x) { if (x.status) x.status(status); });
+        return true;
+    });
+}
+
+// The callbacks are copied and called without m_mutex, so a callback can detach its view. `view` selects one view, null selects all of them
+template <typename F>
+void SharedSource::dispatch(void *view, F &&call) {
+    std::vector<Callbacks> list;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &x : m_views) {
+            if (!view || x.opaque == view) list.push_back(x.callbacks);
+        }
+        m_dispatching++;
+    }
+    dispatchingSources.push_back(this);
+    for (const auto &x : list) call(x);
+    dispatchingSources.pop_back();
+    // Notified under the lock, the destructor may go ahead as soon as it's released
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_dispatching--;
+    m_cv.notify_all();
+}
+
+void SharedSource::setCallbacks(void *view, Callbacks &&callbacks) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &x : m_views) {
+        if (x.opaque == view) x.callbacks = std::move(callbacks);
+    }
+}
+
+void SharedSource::detach(void *view) {
+    {
+        // A dispatch which started before the view was removed may still call it. The ones on this thread are the caller itself
+        const size_t own = size_t(std::count(dispatchingSources.begin(), dispatchingSources.end(), this));
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_views.erase(std::remove_if(m_views.begin(), m_views.end(), [view](const View &x) { return x.opaque == view; }), m_views.end());
+        m_cv.wait(lock, [this, own] { return m_dispatching <= own; });
+    }
+    std::lock_guard<std::mutex> lock(m_indexState->mutex);
+    auto &waiting = m_indexState->waiting;
+    waiting.erase(std::remove_if(waiting.begin(), waiting.end(), [view](const auto &x) { return x.first == view; }), waiting.end());
+}
+
+std::shared_ptr<FrameIndex> SharedSource::frameIndex(void *view, bool allowScan, std::function<void(bool ok, int64_t frameCount)> &&onReady) {
+    std::unique_lock<std::mutex> lock(m_indexState->mutex);
+    if (m_indexState->done) {
+        const bool ok = m_indexState->ok;
+        const int64_t frameCount = m_indexState->frameCount;
+        lock.unlock();
+        onReady(ok, frameCount);
+        return m_frameIndex;
+    }
+    auto &waiting = m_indexState->waiting;
+    waiting.erase(std::remove_if(waiting.begin(), waiting.end(), [view](const auto &x) { return x.first == view; }), waiting.end());
+    waiting.emplace_back(view, std::move(onReady));
+    if (m_frameIndex) return m_frameIndex;
+
+    m_frameIndex = std::make_shared<FrameIndex>(std::string(m_player->url()));
+    lock.unlock();
+    auto state = m_indexState;
+    auto raw = m_frameIndex.get(); // The callback runs on the index thread, which is joined before the index is destroyed
+    m_frameIndex->start(allowScan, [state, raw](bool ok) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done = true;
+        state->ok = ok;
+        state->frameCount = ok? raw->frameCount() : 0;
+        auto waiting = std::move(state->waiting);
+        state->waiting.clear();
+        lock.unlock();
+        for (auto &x : waiting) x.second(ok, state->frameCount);
+    });
+    return m_frameIndex;
+}
+
+size_t SharedSource::viewCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_views.size();
+}
+
+size_t SharedSource::activeCount() {
+    std::lock_guard<std::mutex> lock(sourcesMutex);
+    size_t count = 0;
+    for (const auto &x : sources()) count += !x.second.expired();
+    return count;
+}
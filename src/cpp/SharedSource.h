@@ -0,0 +1,77 @@
+#ifndef SHARED_SOURCE_H
+#define SHARED_SOURCE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "mdk/global.h"
+
+namespace mdk { class Player; struct MediaEvent; }
+class FrameIndex;
+
+// One decoder for all video items which show the same source with sharing enabled. The player renders the decoded frame
+// once per item, into the item's own texture and at its own size (mdk outputs keyed by vo_opaque, the item's MDKPlayer),
+// so decoding scales with the number of sources instead of the number of views.
+// Playback is shared: play, pause, seek, rate and properties set from one item apply to all of them, and so is the frame index
+class SharedSource {
+public:
+    struct Callbacks {
+        std::function<void()> render;
+        std::function<bool(const mdk::MediaEvent &)> event;
+        std::function<void(mdk::State)> state;
+        std::function<bool(mdk::MediaStatus)> status;
+    };
+
+    // Source for `key`, created with `open` when no other item has it. `created` is set when this view opened it
+    static std::shared_ptr<SharedSource> attach(const std::string &key, void *view, const std::function<std::shared_ptr<mdk::Player>()> &open, bool &created);
+    ~SharedSource();
+
+    void setCallbacks(void *view, Callbacks &&callbacks);
+    // Stops calling the view's callbacks, and waits for the ones still running on other threads. The player stays with the remaining views,
+    // the view releases its renderer on its own render thread
+    void detach(void *view);
+
+    // Index of the source, started by the first view which asks for it with its `allowScan`, so the file is indexed once however many views show it.
+    // `onReady` is called from the index thread once it's done, or right away if it already is
+    std::shared_ptr<FrameIndex> frameIndex(void *view, bool allowScan, std::function<void(bool ok, int64_t frameCount)> &&onReady);
+
+    const std::shared_ptr<mdk::Player> &player() const { return m_player; }
+    size_t viewCount() const;
+    // Number of sources with at least one view
+    static size_t activeCount();
+
+private:
+    struct View {
+        void *opaque;
+        Callbacks callbacks;
+    };
+    // Shared with the index thread, which may finish after the source is gone
+    struct IndexState {
+        std::mutex mutex;
+        bool done{false};
+        bool ok{false};
+        int64_t frameCount{0};
+        std::vector<std::pair<void *, std::function<void(bool, int64_t)>>> waiting;
+    };
+    SharedSource() = default;
+    void installCallbacks();
+    template <typename F>
+    void dispatch(void *view, F &&call);
+
+    std::string m_key;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<View> m_views;
+    size_t m_dispatching{0}; // Dispatches which copied the callbacks and haven't finished calling them
+    std::shared_ptr<mdk::Player> m_player;
+
+    std::shared_ptr<IndexState> m_indexState{std::make_shared<IndexState>()};
+    std::shared_ptr<FrameIndex> m_frameIndex;
+};
+
+#endif
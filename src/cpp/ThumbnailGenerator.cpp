@@ -0,0 +1,282 @@
+#include "ThumbnailGenerator.h"
+#include "FrameConverter.h"
+#include "MediaCache.h"
+#include "MediaProbe.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <QtCore/QCache>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtGui/QImage>
+
+#include "mdk/Player.h"
+#include "mdk/VideoFrame.h"
+
+struct ThumbnailGenerator::Worker {
+    std::unique_ptr<mdk::Player> player;
+    std::vector<Job> jobs; // Sorted by timestamp, so the worker only ever seeks forward
+    size_t next{0};
+
+    // Frames decoded before the last seek completed belong to the previous job
+    uint64_t seekIssued{0};
+    uint64_t seekDone{0};
+
+    std::atomic<bool> finished{false};
+    std::recursive_mutex mutex; // The seek callback may run from inside seek()
+
+    FrameConverter converter;
+};
+
+// Thumbnails generated by this process, shared by all generators
+static std::mutex memoryCacheMutex;
+static QCache<QString, QImage> &memoryCache() {
+    static QCache<QString, QImage> cache(64 * 1024); // KB
+    return cache;
+}
+
+static QImage frameToImage(FrameConverter &converter, mdk::VideoFrame &v, uint32_t width, uint32_t height) {
+    if (!height) {
+        height = std::max<uint32_t>(2, uint32_t(std::round(double(width) * v.height() / std::max(1, v.width()))));
+    }
+    QImage img(width, height, QImage::Format_RGBA8888);
+    if (img.isNull()) return img;
+
+    FrameConverter::Planes planes;
+    if (FrameConverter::planesFromFrame(v, planes) && converter.convert(planes, FrameConverter::Target::RGBA, width, height, img.bits(), img.bytesPerLine(), FrameConverter::Filter::Area)) {
+        return img;
+    }
+    auto rgba = v.to(mdk::PixelFormat::RGBA, int(width), int(height));
+    const uint8_t *src = rgba.bufferData();
+    if (!src) return QImage();
+    const size_t srcStride = rgba.bytesPerLine();
+    const size_t rowSize = std::min<size_t>(srcStride, img.bytesPerLine());
+    for (uint32_t y = 0; y < height && y < uint32_t(rgba.height()); ++y) {
+        memcpy(img.scanLine(y), src + y * srcStride, rowSize);
+    }
+    return img;
+}
+
+ThumbnailGenerator::ThumbnailGenerator(const std::string &url, const ThumbnailOptions &options, ThumbnailCb &&cb) : m_url(url), m_options(options), m_cb(std::move(cb)) { }
+
+ThumbnailGenerator::~ThumbnailGenerator() {
+    stop();
+}
+
+void ThumbnailGenerator::start(const std::vector<double> &timestampsMs, uint32_t count, uint32_t width, uint32_t height, double durationMs, uint32_t videoWidth, uint32_t videoHeight) {
+    m_width = width? width : 160;
+    m_height = height;
+    // Opening the file and reading the caches can take a while, don't block the caller
+    m_setup = std::thread([this, timestampsMs, count, durationMs, videoWidth, videoHeight] { run(timestampsMs, count, durationMs, videoWidth, videoHeight); });
+}
+
+void ThumbnailGenerator::run(std::vector<double> timestamps, uint32_t count, double durationMs, uint32_t videoWidth, uint32_t videoHeight) {
+    if ((timestamps.empty() && count > 0 && durationMs <= 0.0) || !videoWidth || !videoHeight) {
+        probe(durationMs, videoWidth, videoHeight);
+    }
+    if (timestamps.empty()) {
+        for (uint32_t i = 0; i < count && durationMs > 0.0; ++i) {
+            timestamps.push_back((i + 0.5) * durationMs / count);
+        }
+    }
+
+    m_fileKey = MediaCache::fileKey(QString::fromStdString(m_url));
+    if (!m_fileKey.isEmpty() && m_options.diskCache) {
+        const QString dir = MediaCache::directory("thumbnails");
+        if (!dir.isEmpty() && QDir().mkpath(dir + "/" + m_fileKey)) {
+            m_cacheDir = dir + "/" + m_fileKey;
+        }
+    }
+
+    std::vector<Job> missing;
+    for (size_t i = 0; i < timestamps.size() && !m_stopped; ++i) {
+        const Job job { i, timestamps[i] };
+        if (!fromCache(job)) missing.push_back(job);
+    }
+    if (missing.empty() || m_stopped) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        finish();
+        return;
+    }
+    std::sort(missing.begin(), missing.end(), [](const Job &a, const Job &b) { return a.timestamp < b.timestamp; });
+
+    // Let the decoder skip the resolution we don't need. FFmpeg clamps it to what the codec supports
+    int lowres = 0;
+    if (videoWidth && videoHeight) {
+        const uint32_t targetHeight = m_height? m_height : uint32_t(double(m_width) * videoHeight / videoWidth);
+        while (lowres < 3 && (videoWidth >> (lowres + 1)) >= m_width && (videoHeight >> (lowres + 1)) >= targetHeight) lowres++;
+    }
+
+    const size_t workers = std::clamp<size_t>(m_options.workers, 1, missing.size());
+    for (size_t i = 0; i < workers; ++i) {
+        auto w = std::make_unique<Worker>();
+        w->player = std::make_unique<mdk::Player>();
+        w->jobs.assign(missing.begin() + missing.size() * i / workers, missing.begin() + missing.size() * (i + 1) / workers);
+        if (lowres > 0) {
+            w->player->setDecoders(mdk::MediaType::Video, { "FFmpeg:lowres=" + std::to_string(lowres), "BRAW:gpu=auto", "R3D:gpu=auto" });
+        } else {
+            w->player->setDecoders(mdk::MediaType::Video, { "FFmpeg", "BRAW:gpu=auto", "R3D:gpu=auto" });
+        }
+        m_workers.push_back(std::move(w));
+    }
+    for (auto &w : m_workers) {
+        if (m_stopped) break;
+        startWorker(*w);
+    }
+}
+
+// Duration and video size, when they weren't known by the caller
+bool ThumbnailGenerator::probe(double &durationMs, uint32_t &videoWidth, uint32_t &videoHeight) {
+    const auto info = MediaProbe::probe(m_url, &m_stopped);
+    if (!info) return false;
+
+    if (durationMs <= 0.0) durationMs = info->summary.durationMs;
+    if (info->summary.hasVideo) {
+        videoWidth  = info->summary.width;
+        videoHeight = info->summary.height;
+    }
+    return true;
+}
+
+QString ThumbnailGenerator::cacheName(double timestamp) const {
+    return QString("%1x%2%3_%4").arg(m_width).arg(m_height).arg(m_options.keyframesOnly? "k" : "e").arg(qRound64(timestamp));
+}
+
+bool ThumbnailGenerator::fromCache(const Job &job) {
+    if (m_fileKey.isEmpty()) return false;
+    const QString name = cacheName(job.timestamp);
+    const QString file = m_cacheDir.isEmpty()? QString() : m_cacheDir + "/" + name + ".jpg";
+
+    QImage img;
+    if (m_options.memoryCache) {
+        std::lock_guard<std::mutex> lock(memoryCacheMutex);
+        if (auto cached = memoryCache().object(m_fileKey + "/" + name)) img = *cached;
+    }
+    if (img.isNull() && !file.isEmpty() && QFileInfo::exists(file)) {
+        img = QImage(file).convertToFormat(QImage::Format_RGBA8888);
+        if (!img.isNull() && m_options.memoryCache) {
+            std::lock_guard<std::mutex> lock(memoryCacheMutex);
+            memoryCache().insert(m_fileKey + "/" + name, new QImage(img), img.sizeInBytes() / 1024);
+        }
+    }
+    if (img.isNull()) return false;
+
+    produce(job, job.timestamp, img, QFileInfo::exists(file)? file : QString());
+    return true;
+}
+
+void ThumbnailGenerator::startWorker(Worker &w) {
+    auto player = w.player.get();
+    player->setMedia(m_url.c_str());
+
+    player->setDecoders(mdk::MediaType::Audio, { });
+    player->setMute(true);
+    player->onSync([] { return DBL_MAX; });
+    player->onFrame<mdk::VideoFrame>([this, &w](mdk::VideoFrame &v, int) -> int { return onFrame(w, v); });
+    player->setVideoSurfaceSize(64, 64);
+
+    player->prepare(int64_t(w.jobs[0].timestamp), [this, &w](int64_t position, bool *) {
+        if (position < 0) { // Can't open the file
+            std::lock_guard<std::recursive_mutex> lock(w.mutex);
+            finishWorker(w);
+        }
+        return true;
+    }, m_options.keyframesOnly? mdk::SeekFlag::FromStart | mdk::SeekFlag::KeyFrame : mdk::SeekFlag::FromStart);
+    player->set(mdk::State::Running);
+}
+
+// Requires w.mutex to be locked
+void ThumbnailGenerator::seekNext(Worker &w) {
+    if (m_stopped || w.finished) return;
+    if (w.next >= w.jobs.size()) {
+        finishWorker(w);
+        return;
+    }
+    const uint64_t generation = ++w.seekIssued;
+    w.player->seek(int64_t(w.jobs[w.next].timestamp), m_options.keyframesOnly? mdk::SeekFlag::FromStart | mdk::SeekFlag::KeyFrame : mdk::SeekFlag::FromStart, [this, &w, generation](int64_t ret) {
+        std::lock_guard<std::recursive_mutex> lock(w.mutex);
+        if (generation != w.seekIssued) return;
+        if (ret < 0) { // Skip this one
+            w.next++;
+            seekNext(w);
+            return;
+        }
+        w.seekDone = generation;
+    });
+}
+
+int ThumbnailGenerator::onFrame(Worker &w, mdk::VideoFrame &v) {
+    std::lock_guard<std::recursive_mutex> lock(w.mutex);
+    if (w.finished || m_stopped || w.seekDone != w.seekIssued) return 0;
+
+    if (v.timestamp() == mdk::TimestampEOS || !v.format()) { // eof frame format is invalid, the requested timestamp is past the end
+        w.next++;
+        seekNext(w);
+        return 0;
+    }
+    if (!v) return 0; // AOT frame(1st frame, seek end 1st frame) is not valid, but format is valid
+
+    const Job job = w.jobs[w.next];
+    QImage img = frameToImage(w.converter, v, m_width, m_height);
+
+    // Start decoding the next one while this one is stored
+    w.next++;
+    const bool last = w.next >= w.jobs.size();
+    if (!last) seekNext(w);
+
+    if (!img.isNull()) {
+        QString file;
+        const QString name = cacheName(job.timestamp);
+        if (!m_fileKey.isEmpty() && m_options.memoryCache) {
+            std::lock_guard<std::mutex> cacheLock(memoryCacheMutex);
+            memoryCache().insert(m_fileKey + "/" + name, new QImage(img), img.sizeInBytes() / 1024);
+        }
+        if (!m_cacheDir.isEmpty() && img.save(m_cacheDir + "/" + name + ".jpg", "JPG", 90)) {
+            file = m_cacheDir + "/" + name + ".jpg";
+        }
+        produce(job, v.timestamp() * 1000.0, img, file);
+    }
+
+    if (last) finishWorker(w);
+    return 0;
+}
+
+void ThumbnailGenerator::produce(const Job &job, double timestamp, const QImage &img, const QString &file) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stopped || m_endSent) return;
+    m_cb(int32_t(job.index), job.timestamp, timestamp, img.width(), img.height(), img.constBits(), img.sizeInBytes(), file.toStdString());
+}
+
+// Requires w.mutex to be locked
+void ThumbnailGenerator::finishWorker(Worker &w) {
+    if (w.finished) return;
+    w.finished = true;
+    w.player->set(mdk::State::Paused);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // The setup thread is done with m_workers before any worker can finish, see stop()
+    if (std::all_of(m_workers.begin(), m_workers.end(), [](const auto &x) { return x->finished; })) {
+        finish();
+    }
+}
+
+// Requires m_mutex to be locked
+void ThumbnailGenerator::finish() {
+    if (m_endSent) return;
+    m_endSent = true;
+    m_cb(-1, -1.0, -1.0, 0, 0, nullptr, 0, std::string());
+}
+
+void ThumbnailGenerator::stop() {
+    m_stopped = true;
+    if (m_setup.joinable()) {
+        m_setup.join();
+    }
+    for (auto &w : m_workers) {
+        w->player->set(mdk::State::Stopped);
+        w->player->waitFor(mdk::State::Stopped);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    finish();
+}
@@ -0,0 +1,80 @@
+#ifndef THUMBNAIL_GENERATOR_H
+#define THUMBNAIL_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <QtCore/QString>
+
+// Must match `ThumbnailOptions` in video_player.rs
+struct ThumbnailOptions {
+    // Number of decoder instances, each taking a contiguous part of the timestamps
+    uint32_t workers{3};
+    // Use the keyframe nearest to each timestamp instead of decoding up to the exact frame. Much faster with long GOPs
+    bool keyframesOnly{true};
+    // Keep generated thumbnails in memory for the lifetime of the process
+    bool memoryCache{true};
+    // Store generated thumbnails in the cache directory, keyed by the file identity and thumbnail size
+    bool diskCache{true};
+};
+
+// Called for every thumbnail as soon as it's available, in no particular order, and with index -1 once at the end.
+// Pixels are RGBA with a stride of width * 4. `cachedFile` is empty if the thumbnail isn't stored on disk
+typedef std::function<void(int32_t index, double requestedMs, double timestampMs, uint32_t width, uint32_t height, const uint8_t *rgba, uint64_t size, const std::string &cachedFile)> ThumbnailCb;
+
+namespace mdk { class VideoFrame; }
+class QImage;
+
+class ThumbnailGenerator {
+public:
+    ThumbnailGenerator(const std::string &url, const ThumbnailOptions &options, ThumbnailCb &&cb);
+    ~ThumbnailGenerator();
+
+    // Either the given timestamps, or `count` timestamps evenly spaced over the duration. `height` 0 keeps the aspect ratio of the video.
+    // Duration and video size are probed if passed as 0
+    void start(const std::vector<double> &timestampsMs, uint32_t count, uint32_t width, uint32_t height, double durationMs, uint32_t videoWidth, uint32_t videoHeight);
+    void stop();
+
+private:
+    struct Job {
+        size_t index;
+        double timestamp; // ms
+    };
+    struct Worker;
+
+    void run(std::vector<double> timestamps, uint32_t count, double durationMs, uint32_t videoWidth, uint32_t videoHeight);
+    bool probe(double &durationMs, uint32_t &videoWidth, uint32_t &videoHeight);
+    bool fromCache(const Job &job);
+    QString cacheName(double timestamp) const;
+
+    void startWorker(Worker &w);
+    void seekNext(Worker &w);
+    int onFrame(Worker &w, mdk::VideoFrame &v);
+    void produce(const Job &job, double timestamp, const QImage &img, const QString &file);
+    void finishWorker(Worker &w);
+    void finish();
+
+    std::string m_url;
+    ThumbnailOptions m_options;
+    ThumbnailCb m_cb;
+
+    uint32_t m_width{0};
+    uint32_t m_height{0};
+
+    QString m_fileKey;
+    QString m_cacheDir;
+
+    std::thread m_setup;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    std::mutex m_mutex;
+    std::atomic<bool> m_stopped{false};
+    bool m_endSent{false};
+};
+
+#endif
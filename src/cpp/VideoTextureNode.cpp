@@ -4,7 +4,7 @@
 #include "mdk/RenderAPI.h"
 using namespace mdk;
 
-QSGTexture *VideoTextureNodePriv::createTexture(mdk::Player *player, const QSize &size) {
+QSGTexture *VideoTextureNodePriv::createTexture(mdk::Player *player, const QSize &size, void *vo_opaque) {
     SetGlobalOption("sdr.white", 100.0f);
     if (!m_item || !m_window) return nullptr;
 
@@ -45,16 +45,28 @@ QSGTexture *VideoTextureNodePriv::createTexture(mdk::Player *player, const QSize
         return nullptr;
     }
 
+    QSGTexture *native = setupRenderAPI(player, size, vo_opaque);
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 6, 0))
+    // the only way to create sg texture with a correct format
+    return m_window->createTextureFromRhiTexture(m_texture, QQuickWindow::TextureHasAlphaChannel);
+#endif
+    return native;
+}
+
+// Points the player's renderer at m_texture. Returns the native texture wrapper on Qt < 6.6, nullptr otherwise
+QSGTexture *VideoTextureNodePriv::setupRenderAPI(mdk::Player *player, const QSize &size, void *vo_opaque) {
+    if (!m_texture || !m_rt || !m_window) return nullptr;
+
     QSGRendererInterface *rif = m_window->rendererInterface();
     switch (rif->graphicsApi()) {
         case QSGRendererInterface::OpenGLRhi: {
-            qDebug2("VideoTextureNodePriv::createTexture") << "QSGRendererInterface::OpenGL";
+            qDebug2("VideoTextureNodePriv::setupRenderAPI") << "QSGRendererInterface::OpenGL";
 #if QT_CONFIG(opengl)
             m_tx = QSGImageNode::TextureCoordinatesTransformFlag::MirrorVertically;
             auto glrt = static_cast<QGles2TextureRenderTarget*>(m_rt.get());
             GLRenderAPI ra;
             ra.fbo = glrt->framebuffer;
-            player->setRenderAPI(&ra);
+            player->setRenderAPI(&ra, vo_opaque);
             #if (QT_VERSION < QT_VERSION_CHECK(6, 6, 0))
                 auto tex = GLuint(m_texture->nativeTexture().object);
                 if (tex)
@@ -63,7 +75,7 @@ QSGTexture *VideoTextureNodePriv::createTexture(mdk::Player *player, const QSize
 #endif // if QT_CONFIG(opengl)
         } break;
         case QSGRendererInterface::MetalRhi: {
-            qDebug2("VideoTextureNodePriv::createTexture") << "QSGRendererInterface::Metal";
+            qDebug2("VideoTextureNodePriv::setupRenderAPI") << "QSGRendererInterface::Metal";
 #if (__APPLE__+0)
             auto dev = rif->getResource(m_window, QSGRendererInterface::DeviceResource);
             Q_ASSERT(dev);
@@ -76,7 +88,7 @@ QSGTexture *VideoTextureNodePriv::createTexture(mdk::Player *player, const QSize
                 auto sc = (QRhiSwapChain*)rif->getResource(m_window, QSGRendererInterface::RhiSwapchainResource);
                 ra.layer = sc->proxyData().reserved[0];
             # endif
-            player->setRenderAPI(&ra);
+            player->setRenderAPI(&ra, vo_opaque);
             #if (QT_VERSION < QT_VERSION_CHECK(6, 6, 0))
                 if (ra.texture)
                     return QNativeInterface::QSGMetalTexture::fromNative((__bridge id<MTLTexture>)ra.texture, m_window, size, QQuickWindow::TextureHasAlphaChannel);
@@ -85,10 +97,10 @@ QSGTexture *VideoTextureNodePriv::createTexture(mdk::Player *player, const QSize
         } break;
 #if (_WIN32+0)
         case QSGRendererInterface::Direct3D11Rhi: {
-            qDebug2("VideoTextureNodePriv::createTexture") << "QSGRendererInterface::Direct3D11";
+            qDebug2("VideoTextureNodePriv::setupRenderAPI") << "QSGRendererInterface::Direct3D11";
             D3D11RenderAPI ra;
             ra.rtv = reinterpret_cast<ID3D11DeviceChild*>(quintptr(m_texture->nativeTexture().object));
-            player->setRenderAPI(&ra);
+            player->setRenderAPI(&ra, vo_opaque);
             #if (QT_VERSION < QT_VERSION_CHECK(6, 6, 0))
                 if (ra.rtv)
                     return QNativeInterface::QSGD3D11Texture::fromNative(ra.rtv, m_window, size, QQuickWindow::TextureHasAlphaChannel);
@@ -96,16 +108,16 @@ QSGTexture *VideoTextureNodePriv::createTexture(mdk::Player *player, const QSize
         } break;
 # if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
         case QSGRendererInterface::Direct3D12: {
-            qDebug2("VideoTextureNodePriv::createTexture") << "QSGRendererInterface::Direct3D12";
+            qDebug2("VideoTextureNodePriv::setupRenderAPI") << "QSGRendererInterface::Direct3D12";
             D3D12RenderAPI ra;
             ra.cmdQueue = reinterpret_cast<ID3D12CommandQueue*>(rif->getResource(m_window, QSGRendererInterface::CommandQueueResource));
             ra.rt = reinterpret_cast<ID3D12Resource*>(quintptr(m_texture->nativeTexture().object));
-            player->setRenderAPI(&ra);
+            player->setRenderAPI(&ra, vo_opaque);
         } break;
 # endif
 #endif // (_WIN32)
         case QSGRendererInterface::VulkanRhi: {
-            qDebug2("VideoTextureNodePriv::createTexture") << "QSGRendererInterface::Vulkan";
+            qDebug2("VideoTextureNodePriv::setupRenderAPI") << "QSGRendererInterface::Vulkan";
 #if (VK_VERSION_1_0+0) && QT_CONFIG(vulkan)
             VulkanRenderAPI ra{};
             ra.device = *static_cast<VkDevice *>(rif->getResource(m_window, QSGRendererInterface::DeviceResource));
@@ -127,27 +139,28 @@ QSGTexture *VideoTextureNodePriv::createTexture(mdk::Player *player, const QSize
                 auto cmdBuf = *static_cast<VkCommandBuffer *>(rif->getResource(node->m_window, QSGRendererInterface::CommandListResource));
                 return cmdBuf;
             };
-            player->setRenderAPI(&ra);
+            player->setRenderAPI(&ra, vo_opaque);
 # if (QT_VERSION < QT_VERSION_CHECK(6, 6, 0))
             if (ra.rt)
                 return QNativeInterface::QSGVulkanTexture::fromNative(ra.rt, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_window, size, QQuickWindow::TextureHasAlphaChannel);
 # endif // (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
 #else
-            qDebug2("VideoTextureNodePriv::createTexture") << "Vulkan support not compiled";
+            qDebug2("VideoTextureNodePriv::setupRenderAPI") << "Vulkan support not compiled";
 #endif // (VK_VERSION_1_0+0) && QT_CONFIG(vulkan)
         } break;
         default: break;
     }
-#if (QT_VERSION >= QT_VERSION_CHECK(6, 6, 0))
-    // the only way to create sg texture with a correct format
-    return m_window->createTextureFromRhiTexture(m_texture, QQuickWindow::TextureHasAlphaChannel);
-#endif
     return nullptr;
 }
 
 // Read texture to QImage. This copies data from GPU to CPU
 QImage VideoTextureNodePriv::toImage(bool normalized) {
-    if (!m_item || !m_texture || !m_item->window()) return QImage();
+    auto result = readback();
+    return result? readbackToImage(*result, normalized) : QImage();
+}
+
+QRhiReadbackResult *VideoTextureNodePriv::readback() {
+    if (!m_item || !m_texture || !m_item->window()) return nullptr;
     auto context = static_cast<QSGDefaultRenderContext *>(QQuickItemPrivate::get(m_item)->sceneGraphRenderContext());
     auto rhi = context->rhi();
 
@@ -161,7 +174,11 @@ QImage VideoTextureNodePriv::toImage(bool normalized) {
     // We need the results right away.
     rhi->finish();
 
-    if (m_readbackResult->data.isEmpty()) {
+    return m_readbackResult;
+}
+
+QImage VideoTextureNodePriv::readbackToImage(const QRhiReadbackResult &result, bool normalized) {
+    if (result.data.isEmpty()) {
         qWarning("Layer grab failed");
         return QImage();
     }
@@ -170,36 +187,160 @@ QImage VideoTextureNodePriv::toImage(bool normalized) {
     // Also, Quick is always premultiplied alpha.
     const QImage::Format imageFormat = QImage::Format_RGBA8888_Premultiplied;
 
-    const uchar *p = reinterpret_cast<const uchar *>(m_readbackResult->data.constData());
-    QImage ret(p, m_readbackResult->pixelSize.width(), m_readbackResult->pixelSize.height(), imageFormat);
+    const uchar *p = reinterpret_cast<const uchar *>(result.data.constData());
+    QImage ret(p, result.pixelSize.width(), result.pixelSize.height(), imageFormat);
 
-    if (normalized && rhi->isYUpInFramebuffer())
+    auto rhi = this->rhi();
+    if (normalized && rhi && rhi->isYUpInFramebuffer())
         ret.mirror();
 
     return ret;
 }
 
+bool VideoTextureNodePriv::queueReadback(uint32_t frame, double timestamp) {
+    if (!m_item || !m_texture || !m_item->window() || m_readbackDepth < 2) return false;
+    auto context = static_cast<QSGDefaultRenderContext *>(QQuickItemPrivate::get(m_item)->sceneGraphRenderContext());
+    auto rhi = context->rhi();
+
+    if (m_readbackSlots.size() != size_t(m_readbackDepth)) {
+        // Only resize the ring when nothing is pending, the rhi holds pointers to the results
+        for (const auto &x : m_readbackSlots) {
+            if (x->inFlight) return false;
+        }
+        m_readbackSlots.clear();
+        for (int i = 0; i < m_readbackDepth; ++i) {
+            auto slot = std::make_unique<ReadbackSlot>();
+            auto ptr = slot.get();
+            slot->result.completed = [ptr] {
+                ptr->inFlight = false;
+                ptr->completed = true;
+            };
+            m_readbackSlots.push_back(std::move(slot));
+        }
+        m_readbackDelivered = m_readbackQueued;
+    }
+
+    auto slot = m_readbackSlots[m_readbackQueued % m_readbackSlots.size()].get();
+    if (slot->inFlight || slot->completed) return false; // Consumer is too slow, drop this frame
+
+    slot->frame = frame;
+    slot->timestamp = timestamp;
+    slot->sequence = m_readbackQueued++;
+    slot->queuedAt = std::chrono::steady_clock::now();
+    slot->inFlight = true;
+
+    QRhiCommandBuffer *cb = context->currentFrameCommandBuffer();
+    QRhiResourceUpdateBatch *resourceUpdates = rhi->nextResourceUpdateBatch();
+    resourceUpdates->readBackTexture({ m_texture }, &slot->result);
+    cb->resourceUpdate(resourceUpdates);
+
+    return true;
+}
+
+ReadbackSlot *VideoTextureNodePriv::takeCompletedReadback() {
+    if (m_readbackSlots.empty() || m_readbackDelivered == m_readbackQueued) return nullptr;
+
+    auto slot = m_readbackSlots[m_readbackDelivered % m_readbackSlots.size()].get();
+    if (!slot->completed) return nullptr;
+
+    slot->completed = false;
+    m_readbackDelivered++;
+    return slot;
+}
+
 // Upload QImage to texture. This copies data from CPU to GPU
-bool VideoTextureNodePriv::fromImage(const QImage &img, bool normalized) {
-    if (!m_item || !m_texture || !m_item->window()) return false;
+bool VideoTextureNodePriv::fromImage(const QImage &img, bool normalized, const QRect &dirtyRect) {
+    if (!m_item || !m_texture || !m_item->window() || img.isNull()) return false;
     auto context = static_cast<QSGDefaultRenderContext *>(QQuickItemPrivate::get(m_item)->sceneGraphRenderContext());
     auto rhi = context->rhi();
 
     if (normalized && rhi->isYUpInFramebuffer())
         const_cast<QImage&>(img).mirror();
 
+    QRect rect = dirtyRect.intersected(img.rect());
+    QRhiTexture *target = m_texture;
+    if (img.size() != m_texture->pixelSize() || !rect.isEmpty()) {
+        if (!m_uploadTexture || m_uploadTexture->pixelSize() != img.size()) {
+            if (m_uploadTexture) {
+                showUploadTexture(false);
+                m_uploadTexture->deleteLater();
+            }
+            m_uploadTexture = rhi->newTexture(QRhiTexture::RGBA8, img.size(), 1, QRhiTexture::UsedAsTransferSource);
+            if (!m_uploadTexture || !m_uploadTexture->create()) {
+                delete m_uploadTexture;
+                m_uploadTexture = nullptr;
+                return false;
+            }
+        }
+        target = m_uploadTexture;
+    }
+    // Partial upload is only valid if the upload texture still holds the previous processed frame
+    if (target != m_uploadTexture || !m_showingUploadTexture)
+        rect = QRect();
+
+    QRhiTextureSubresourceUploadDescription desc(img);
+    if (!rect.isEmpty()) {
+        desc.setSourceTopLeft(rect.topLeft());
+        desc.setSourceSize(rect.size());
+        desc.setDestinationTopLeft(rect.topLeft());
+    }
+
     QRhiCommandBuffer *cb = context->currentFrameCommandBuffer();
     QRhiResourceUpdateBatch *resourceUpdates = rhi->nextResourceUpdateBatch();
-    resourceUpdates->uploadTexture(m_texture, img.scaled(m_texture->pixelSize())); // TODO: use second texture instead of .scaled()
+    resourceUpdates->uploadTexture(target, QRhiTextureUploadDescription(QRhiTextureUploadEntry(0, 0, desc)));
 
     cb->resourceUpdate(resourceUpdates);
 
-    rhi->finish();
+    showUploadTexture(target == m_uploadTexture);
 
     return true;
 }
 
+bool VideoTextureNodePriv::uploadPixels(const QByteArray &data, const QSize &size) {
+    if (!m_item || !m_texture || !m_item->window()) return false;
+    if (size != m_texture->pixelSize() || data.size() < size.width() * size.height() * 4) return false;
+    auto context = static_cast<QSGDefaultRenderContext *>(QQuickItemPrivate::get(m_item)->sceneGraphRenderContext());
+    auto rhi = context->rhi();
+
+    // Implicitly shared, so the readback buffer is reused by the next readback once the upload is done
+    QRhiTextureSubresourceUploadDescription desc(data);
+    desc.setSourceSize(size);
+
+    QRhiCommandBuffer *cb = context->currentFrameCommandBuffer();
+    QRhiResourceUpdateBatch *resourceUpdates = rhi->nextResourceUpdateBatch();
+    resourceUpdates->uploadTexture(m_texture, QRhiTextureUploadDescription(QRhiTextureUploadEntry(0, 0, desc)));
+    cb->resourceUpdate(resourceUpdates);
+
+    showUploadTexture(false);
+
+    return true;
+}
+
+void VideoTextureNodePriv::showUploadTexture(bool show) {
+    if (show == m_showingUploadTexture) return;
+    auto plain = dynamic_cast<QSGPlainTexture *>(m_sgTexture.data());
+    if (!plain || !m_texture || (show && !m_uploadTexture)) return;
+
+    // The sg texture may own m_texture, make sure it doesn't delete it when switching
+    if (show) {
+        m_sgOwnsTexture = plain->ownsTexture();
+        plain->setOwnsTexture(false);
+        plain->setTexture(m_uploadTexture);
+        plain->setTextureSize(m_uploadTexture->pixelSize());
+    } else {
+        plain->setTexture(m_texture);
+        plain->setTextureSize(m_texture->pixelSize());
+        plain->setOwnsTexture(m_sgOwnsTexture);
+    }
+    m_showingUploadTexture = show;
+}
+
 void VideoTextureNodePriv::releaseResources() {
+    showUploadTexture(false);
+    if (m_uploadTexture) {
+        m_uploadTexture->deleteLater();
+        m_uploadTexture = nullptr;
+    }
     /*if (m_texture) {
         m_texture->destroy();
         delete m_texture;
@@ -213,6 +354,20 @@ void VideoTextureNodePriv::releaseResources() {
     delete m_readbackResult;
     m_readbackResult = nullptr;
 
+    bool pending = false;
+    for (const auto &x : m_readbackSlots) pending |= x->inFlight;
+    if (pending) {
+        if (auto rhi = this->rhi()) {
+            rhi->finish();
+        } else {
+            // The rhi is already gone and may still reference the results, leak them instead
+            for (auto &x : m_readbackSlots) { if (x->inFlight) x.release(); }
+        }
+    }
+    m_readbackSlots.clear();
+    m_readbackQueued = 0;
+    m_readbackDelivered = 0;
+
 #if (_WIN32+0)
     if (m_fence) {
         m_fence->Release();
@@ -224,3 +379,14 @@ void VideoTextureNodePriv::releaseResources() {
     }
 #endif
 }
+
+VideoTextureNodePriv::~VideoTextureNodePriv() {
+    // Readbacks still in flight are referenced by the rhi, so they can't be deleted here
+    for (auto &x : m_readbackSlots) { if (x->inFlight) x.release(); }
+}
+
+QRhi *VideoTextureNodePriv::rhi() const {
+    if (!m_item || !m_item->window()) return nullptr;
+    auto context = static_cast<QSGDefaultRenderContext *>(QQuickItemPrivate::get(m_item)->sceneGraphRenderContext());
+    return context? context->rhi() : nullptr;
+}
@@ -4,6 +4,9 @@
 #include <QQuickWindow>
 #include <QSGImageNode>
 #include <QPointer>
+#include <chrono>
+#include <memory>
+#include <vector>
 #include <private/qquickitem_p.h>
 #if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
 #   include <rhi/qrhi.h>
@@ -14,6 +17,7 @@
 #endif
 #include <private/qsgrenderer_p.h>
 #include <private/qsgdefaultrendercontext_p.h>
+#include <private/qsgplaintexture_p.h>
 
 #if (_WIN32+0)
 #   include <d3d11.h>
@@ -36,21 +40,64 @@
 
 namespace mdk { class Player; }
 
+// One entry of the asynchronous readback ring. Pixel data stays valid until the slot is queued again
+struct ReadbackSlot {
+    QRhiReadbackResult result;
+    uint32_t frame{0};
+    double timestamp{0.0};
+    uint64_t sequence{0};
+    std::chrono::steady_clock::time_point queuedAt;
+    bool inFlight{false};
+    bool completed{false};
+};
+
 class VideoTextureNodePriv {
 public:
-    QSGTexture *createTexture(mdk::Player *player, const QSize &size);
+    ~VideoTextureNodePriv();
+
+    // `vo_opaque` selects the output when several items render the same player
+    QSGTexture *createTexture(mdk::Player *player, const QSize &size, void *vo_opaque = nullptr);
+    // Sets the render API of `player` to render into the existing texture, e.g. when another player takes over
+    QSGTexture *setupRenderAPI(mdk::Player *player, const QSize &size, void *vo_opaque = nullptr);
 
     // Read texture to QImage. This copies data from GPU to CPU
     QImage toImage(bool normalized = false);
+    // Read texture into m_readbackResult, waiting for the GPU. The buffer is reused for every readback
+    QRhiReadbackResult *readback();
 
     // Upload QImage to texture. This copies data from CPU to GPU
-    bool fromImage(const QImage &img, bool normalized = false);
+    // Images which don't match the texture size, or come with a dirty rect, go to a persistent upload texture which is then scaled by the scene graph.
+    // The image data must stay valid until the end of the current frame
+    bool fromImage(const QImage &img, bool normalized = false, const QRect &dirtyRect = QRect());
+
+    // Upload tightly packed RGBA8 pixels to the texture. The data is shared with the rhi, not copied
+    bool uploadPixels(const QByteArray &data, const QSize &size);
+
+    // Switch the scene graph texture between m_texture and m_uploadTexture
+    void showUploadTexture(bool show);
+
+    // Queue a readback of the current texture without waiting for the GPU. Returns false when all slots are still in flight
+    bool queueReadback(uint32_t frame, double timestamp);
+    // Oldest readback which finished on the GPU, in queue order. nullptr if none is ready yet
+    ReadbackSlot *takeCompletedReadback();
+    QImage readbackToImage(const QRhiReadbackResult &result, bool normalized = false);
 
     void releaseResources();
 
+    QRhi *rhi() const;
+
     QRhiReadbackResult *m_readbackResult{nullptr};
 
+    std::vector<std::unique_ptr<ReadbackSlot>> m_readbackSlots;
+    uint64_t m_readbackQueued{0};
+    uint64_t m_readbackDelivered{0};
+    int m_readbackDepth{0};
+
     QRhiTexture *m_texture{nullptr};
+    QRhiTexture *m_uploadTexture{nullptr};
+    QPointer<QSGTexture> m_sgTexture;
+    bool m_sgOwnsTexture{true};
+    bool m_showingUploadTexture{false};
     QRhiTexture *m_workaroundTexture{nullptr};
     std::unique_ptr<QRhiTextureRenderTarget> m_rt;
     std::unique_ptr<QRhiRenderPassDescriptor> m_rtRp;
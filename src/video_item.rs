@@ -7,6 +7,7 @@ use qmetaobject::*;
 use crate::video_player::*;
 
 type ProcessPixelsCb = Box<dyn Fn(u32, f64, u32, u32, u32, &mut [u8]) -> (u32, u32, u32, *mut u8)>;
+type ProcessPixelsInPlaceCb = Box<dyn Fn(u32, f64, u32, u32, u32, &mut [u8]) -> bool>;
 type ProcessTextureCb = Box<dyn Fn(u32, f64, u32, u32, u32, u64, u64, u64, u64, u64) -> bool>;
 type ReadyForProcessingCb = Box<dyn Fn() -> bool>;
 type ResizeCb = Box<dyn Fn(u32, u32)>;
@@ -47,11 +48,20 @@ pub struct MDKVideoItem {
     pub seekToFrame:      qt_method!(fn(&mut self, frame: i64, exact: bool)),
     pub seekToFrameDelta: qt_method!(fn(&mut self, frame_delta: i64)),
     pub seekToTimestamp:  qt_method!(fn(&mut self, timestamp: f64, exact: bool)),
+    pub setScrubbing:     qt_method!(fn(&mut self, scrubbing: bool)),
 
     pub setFrameRate: qt_method!(fn(&mut self, fps: f64)),
 
     pub url:    qt_property!(QUrl; CONST),
     pub setUrl: qt_method!(fn(&mut self, url: QUrl, custom_decoder: QString)),
+    pub setNextUrl: qt_method!(fn(&mut self, url: QUrl, custom_decoder: QString)),
+    pub setSourceSharing: qt_method!(fn(&mut self, enabled: bool)),
+    pub setDecodePriority: qt_method!(fn(&mut self, priority: i32)),
+    pub getPipelineStats: qt_method!(fn(&self) -> QJsonObject),
+    pub getPlaybackState: qt_method!(fn(&self) -> QJsonObject),
+    pub setNotifyInterval: qt_method!(fn(&mut self, ms: u32)),
+    pub startTrace: qt_method!(fn(&mut self, window_ms: u32)),
+    pub writeTrace: qt_method!(fn(&self, path: QString) -> bool),
     pub setProperty: qt_method!(fn(&mut self, key: QString, value: QString)),
     pub setDefaultProperty: qt_method!(fn(&mut self, key: QString, value: QString)),
 
@@ -91,17 +101,27 @@ pub struct MDKVideoItem {
     pub surfaceSizeUpdated: qt_method!(fn(&mut self, width: u32, height: u32)),
     pub setPlaybackRange: qt_method!(fn(&mut self, from_ms: i64, to_ms: i64)),
 
+    pub generateThumbnails: qt_method!(fn(&mut self, count: u32, width: u32, height: u32)),
+    pub thumbnailReady: qt_signal!(index: i32, timestamp: f64, url: QString),
+
+    pub frameIndexed:     qt_property!(bool; NOTIFY metadataChanged),
+    pub setFrameIndexing: qt_method!(fn(&mut self, scan: bool)),
+    pub frameIndexReady:  qt_method!(fn(&mut self, frameCount: i64)),
+
     m_geometryChanged: bool,
 
     m_player: MDKPlayerWrapper,
 
     m_processPixelsCb: Option<ProcessPixelsCb>,
+    m_processPixelsInPlaceCb: Option<ProcessPixelsInPlaceCb>,
     m_processTextureCb: Option<ProcessTextureCb>,
     m_readyForProcessingCb: Option<ReadyForProcessingCb>,
     m_resizeCb: Option<ResizeCb>
 }
 
 impl MDKVideoItem {
+    /// The buffer returned from the callback is uploaded asynchronously, so it has to stay valid until the next call.
+    /// If the returned size differs from the surface size, the image is kept in its own texture and scaled on the GPU
     pub fn onProcessPixels(&mut self, cb: ProcessPixelsCb) {
         self.m_processPixelsCb = Some(cb);
         let player = &self.m_player;
@@ -109,6 +129,15 @@ impl MDKVideoItem {
             player->mdkplayer->setProcessPixelsCallback(processPixelsCb);
         });
     }
+    /// Zero-copy variant of `onProcessPixels`. The callback modifies the RGBA pixels in place and returns `true` if they should be uploaded back.
+    /// The buffer comes from a fixed pool (see `setReadbackDepth`) and is only valid during the call
+    pub fn onProcessPixelsInPlace(&mut self, cb: ProcessPixelsInPlaceCb) {
+        self.m_processPixelsInPlaceCb = Some(cb);
+        let player = &self.m_player;
+        cpp!(unsafe [player as "MDKPlayerWrapper*"] {
+            player->mdkplayer->setProcessPixelsInPlaceCallback(processPixelsInPlaceCb);
+        });
+    }
     pub fn onProcessTexture(&mut self, cb: ProcessTextureCb) {
         self.m_processTextureCb = Some(cb);
         let player = &self.m_player;
@@ -116,6 +145,8 @@ impl MDKVideoItem {
             player->mdkplayer->setProcessTextureCallback(processTextureCb);
         });
     }
+    /// See `MDKPlayerWrapper::set_vulkan_explicit_sync`
+    pub fn setVulkanExplicitSync(&mut self, enabled: bool) { self.m_player.set_vulkan_explicit_sync(enabled); }
     pub fn readyForProcessing(&mut self, cb: ReadyForProcessingCb) {
         self.m_readyForProcessingCb = Some(cb);
         let player = &self.m_player;
@@ -126,6 +157,19 @@ impl MDKVideoItem {
     pub fn onResize(&mut self, cb: ResizeCb) {
         self.m_resizeCb = Some(cb);
     }
+    /// Keep `depth` frames in flight for the `onProcessPixels` readback instead of waiting for the GPU on every frame.
+    /// The callback then receives older frames (with their own frame number and timestamp), see `getReadbackLatency`
+    pub fn setReadbackDepth(&mut self, depth: i32) { self.m_player.set_readback_depth(depth); }
+    pub fn getReadbackLatency(&self) -> (u32, f64) { self.m_player.get_readback_latency() }
+
+    pub fn setFrameCacheBudget(&mut self, bytes: u64) { self.m_player.set_frame_cache_budget(bytes); }
+    pub fn getFrameCacheStats(&self) -> FrameCacheStats { self.m_player.get_frame_cache_stats() }
+    pub fn getSurfaceStats(&self) -> SurfaceStats { self.m_player.get_surface_stats() }
+    pub fn getRenderPassStats(&self) -> RenderPassStats { self.m_player.get_render_pass_stats() }
+
+    pub fn getMediaSummary(&self) -> Option<MediaSummary> { self.m_player.get_media_summary() }
+    pub fn setFrameIndexing(&mut self, scan: bool) { self.m_player.set_frame_indexing(scan); }
+    pub fn getSeekCost(&self, frame: i64) -> Option<i64> { self.m_player.get_seek_cost(frame) }
 
     pub fn play (&mut self) { self.m_player.play(); }
     pub fn pause(&mut self) { self.m_player.pause(); }
@@ -144,6 +188,7 @@ impl MDKVideoItem {
     pub fn seekToFrame(&mut self, frame: i64, exact: bool) { self.m_player.seek_to_frame(frame, self.currentFrame, exact); self.forceRedraw(); }
     pub fn seekToFrameDelta(&mut self, frame_delta: i64) { self.m_player.seek_to_frame_delta(frame_delta); self.forceRedraw(); }
     pub fn seekToTimestamp(&mut self, timestamp: f64, exact: bool) { self.m_player.seek_to_timestamp(timestamp, exact); self.forceRedraw(); }
+    pub fn setScrubbing(&mut self, scrubbing: bool) { self.m_player.set_scrubbing(scrubbing); self.forceRedraw(); }
 
     pub fn setRotation(&mut self, v: i32) { self.m_player.set_rotation(v); self.forceRedraw(); }
     pub fn getRotation(&self) -> i32 { self.m_player.get_rotation() }
@@ -157,6 +202,23 @@ impl MDKVideoItem {
         self.setMuted(prev_muted);
         self.forceRedraw();
     }
+    pub fn setNextUrl(&mut self, url: QUrl, custom_decoder: QString) {
+        self.m_player.set_next_url(url, custom_decoder);
+    }
+    pub fn setSourceSharing(&mut self, enabled: bool) {
+        self.m_player.set_source_sharing(enabled);
+    }
+    /// Only matters once a budget is set with `MDKPlayerWrapper::set_decode_budget`, which pauses hidden and offscreen items.
+    /// Items playing audio keep playing when hidden, mute them to let them pause
+    pub fn setDecodePriority(&mut self, priority: i32) {
+        self.m_player.set_decode_priority(priority);
+    }
+    pub fn getPipelineStats(&self) -> QJsonObject { self.m_player.get_pipeline_stats_json() }
+    /// Current position and state without waiting for `timestampChanged`, e.g. for a playhead animated at the display rate
+    pub fn getPlaybackState(&self) -> QJsonObject { self.m_player.get_playback_state_json() }
+    pub fn setNotifyInterval(&mut self, ms: u32) { self.m_player.set_notify_interval(ms); }
+    pub fn startTrace(&mut self, window_ms: u32) { self.m_player.start_trace(window_ms); }
+    pub fn writeTrace(&self, path: QString) -> bool { self.m_player.write_trace(&path.to_string()) }
     pub fn setProperty(&mut self, key: QString, value: QString) {
         self.m_player.set_property(key, value);
     }
@@ -184,6 +246,7 @@ impl MDKVideoItem {
     }
 
     fn videoLoaded(&mut self, duration: f64, frameCount: i64, frameRate: f64, width: u32, height: u32) {
+        self.frameIndexed = false;
         self.duration     = duration;
         self.frameCount   = frameCount;
         self.frameRate    = (frameRate * 10000.0).round() / 10000.0;
@@ -192,6 +255,13 @@ impl MDKVideoItem {
 
         self.metadataChanged();
     }
+    fn frameIndexReady(&mut self, frameCount: i64) {
+        // Counted from the decoded frames, more accurate than the container metadata
+        self.frameCount   = frameCount;
+        self.frameIndexed = true;
+
+        self.metadataChanged();
+    }
     fn stateChanged(&mut self, state: i32) {
         self.playing = state == 1;
         self.playingChanged();
@@ -220,6 +290,13 @@ impl MDKVideoItem {
             (width, height, stride, pixels.as_mut_ptr())
         }
     }
+    fn process_pixels_in_place(&mut self, frame: u32, timestamp: f64, width: u32, height: u32, stride: u32, pixels: &mut [u8]) -> bool {
+        if let Some(ref mut proc) = self.m_processPixelsInPlaceCb {
+            proc(frame, timestamp, width, height, stride, pixels)
+        } else {
+            false
+        }
+    }
     fn process_texture(&mut self, frame: u32, timestamp: f64, width: u32, height: u32, backend_id: u32, ptr1: u64, ptr2: u64, ptr3: u64, ptr4: u64, ptr5: u64) -> bool {
         if let Some(ref mut proc) = self.m_processTextureCb {
             proc(frame, timestamp, width, height, backend_id, ptr1, ptr2, ptr3, ptr4, ptr5)
@@ -250,9 +327,36 @@ impl MDKVideoItem {
     pub fn startProcessing<F: FnMut(i32, f64, u32, u32, u32, u32, f64, f64, u32, &mut [u8]) -> bool + 'static>(&mut self, id: usize, width: usize, height: usize, yuv: bool, custom_decoder: &str, ranges_ms: Vec<(usize, usize)>, cb: F) {
         self.m_player.start_processing(id, width, height, custom_decoder, yuv, ranges_ms, cb);
     }
+    pub fn startProcessingWithOptions<F: FnMut(i32, f64, u32, u32, u32, u32, f64, f64, u32, &mut [u8]) -> bool + 'static>(&mut self, id: usize, width: usize, height: usize, yuv: bool, custom_decoder: &str, ranges_ms: Vec<(usize, usize)>, options: ProcessingOptions, cb: F) {
+        self.m_player.start_processing_with_options(id, width, height, custom_decoder, yuv, ranges_ms, options, cb);
+    }
+    pub fn startProcessingNative<F: FnMut(i32, f64, u32, u32, f64, f64, u32, Option<&FramePlanes>) -> bool + 'static>(&mut self, id: usize, custom_decoder: &str, ranges_ms: Vec<(usize, usize)>, options: ProcessingOptions, cb: F) {
+        self.m_player.start_processing_native(id, custom_decoder, ranges_ms, options, cb);
+    }
     pub fn stopProcessing(&mut self, id: usize) {
         self.m_player.stop_processing(id);
     }
+    pub fn getProcessingQueueStats(&self, id: usize) -> Option<ProcessingQueueStats> {
+        self.m_player.get_processing_queue_stats(id)
+    }
+    pub fn getProcessingConverterStats(&self, id: usize) -> Option<ConverterStats> {
+        self.m_player.get_processing_converter_stats(id)
+    }
+
+    /// Filmstrip of `count` thumbnails over the whole video, each one is announced with `thumbnailReady` as soon as it's available.
+    /// `height` 0 keeps the aspect ratio. A new call replaces the previous request
+    pub fn generateThumbnails(&mut self, count: u32, width: u32, height: u32) {
+        let player = &self.m_player;
+        cpp!(unsafe [player as "MDKPlayerWrapper *", count as "uint32_t", width as "uint32_t", height as "uint32_t"] {
+            player->mdkplayer->generateItemThumbnails(count, width, height);
+        });
+    }
+    pub fn generateThumbnailsWithCallback<F: FnMut(i32, f64, f64, u32, u32, &[u8], &str) + 'static>(&mut self, id: usize, timestamps_ms: Vec<f64>, count: u32, width: u32, height: u32, options: ThumbnailOptions, cb: F) {
+        self.m_player.generate_thumbnails(id, timestamps_ms, count, width, height, options, cb);
+    }
+    pub fn stopThumbnails(&mut self, id: usize) {
+        self.m_player.stop_thumbnails(id);
+    }
 
     pub fn get_mdkplayer_mut(&mut self) -> &mut MDKPlayerWrapper {
         &mut self.m_player
@@ -290,6 +394,16 @@ cpp! {{
             qimage_from_parts(vid_item.process_pixels(frame, timestamp, width, height, stride, slice))
         });
     };
+    bool processPixelsInPlaceCb(QQuickItem *item, uint32_t frame, double timestamp, uint32_t width, uint32_t height, uint32_t stride, uint8_t *bits, uint64_t bitsSize) {
+        return rust!(Rust_MDKPlayerItem_processPixelsInPlace [item: *mut std::os::raw::c_void as "QQuickItem *", frame: u32 as "uint32_t", timestamp: f64 as "double", width: u32 as "uint32_t", height: u32 as "uint32_t", stride: u32 as "uint32_t", bitsSize: u64 as "uint64_t", bits: *mut u8 as "uint8_t *"] -> bool as "bool" {
+            let slice = unsafe { std::slice::from_raw_parts_mut(bits, bitsSize as usize) };
+
+            let mut vid_item = MDKVideoItem::get_from_cpp(item);
+            let mut vid_item = unsafe { &mut *vid_item.as_ptr() }; // vid_item.borrow_mut()
+
+            vid_item.process_pixels_in_place(frame, timestamp, width, height, stride, slice)
+        });
+    };
     bool processTextureCb(QQuickItem *item, uint32_t frame, double timestamp, uint32_t width, uint32_t height, uint32_t backend_id, uint64_t ptr1, uint64_t ptr2, uint64_t ptr3, uint64_t ptr4, uint64_t ptr5) {
         return rust!(Rust_MDKPlayerItem_processTexture [item: *mut std::os::raw::c_void as "QQuickItem *", frame: u32 as "uint32_t", timestamp: f64 as "double", width: u32 as "uint32_t", height: u32 as "uint32_t", backend_id: u32 as "uint32_t", ptr1: u64 as "uint64_t", ptr2: u64 as "uint64_t", ptr3: u64 as "uint64_t", ptr4: u64 as "uint64_t", ptr5: u64 as "uint64_t"] -> bool as "bool" {
             let mut vid_item = MDKVideoItem::get_from_cpp(item);
@@ -364,10 +478,13 @@ impl QQuickItem for MDKVideoItem {
                     }
 
                     QSize newSize = QSizeF(item->size() * win->effectiveDevicePixelRatio()).toSize();
+                    bool fixedSize = false;
                     if (w != 0 && h != 0) {
                         newSize = QSize(w, h);
+                        fixedSize = true;
                     }
-                    player->mdkplayer->sync(*image_node, newSize, item);
+                    // Explicit surface sizes apply right away, item resizes are deferred while they're in progress
+                    player->mdkplayer->sync(*image_node, newSize, item, false, !fixedSize);
                     if ((*image_node)->texture()) {
                         (*image_node)->markDirty(QSGImageNode::DirtyMaterial);
                     } else {
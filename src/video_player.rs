@@ -7,8 +7,362 @@ cpp! {{
     #include "src/cpp/VideoTextureNode.cpp"
     #include "src/cpp/MDKPlayer.h"
     #include "src/cpp/MDKPlayer.cpp"
+    #include "src/cpp/FrameConverter.cpp"
+    #include "src/cpp/ProcessingSession.cpp"
+    #include "src/cpp/MediaCache.cpp"
+    #include "src/cpp/ThumbnailGenerator.cpp"
+    #include "src/cpp/FrameCache.cpp"
+    #include "src/cpp/FrameIndex.cpp"
+    #include "src/cpp/MediaProbe.cpp"
+    #include "src/cpp/PlayerPool.cpp"
+    #include "src/cpp/SharedSource.cpp"
+    #include "src/cpp/DecodeScheduler.cpp"
+    #include "src/cpp/PlayerStats.cpp"
+    #include "src/cpp/ReversePlayback.cpp"
+    #include "src/cpp/HeadlessRenderer.h"
+    #include "src/cpp/HeadlessRenderer.cpp"
 }}
 cpp_class! { pub unsafe struct MDKPlayerWrapper as "MDKPlayerWrapper" }
+cpp_class! { pub unsafe struct HeadlessRenderer as "HeadlessRendererWrapper" }
+
+/// Options for `start_processing_with_options`. Must match `ProcessingOptions` in ProcessingSession.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug)]
+pub struct ProcessingOptions {
+    /// Number of decoder instances, each working on its own keyframe aligned part of the requested ranges
+    pub parallel_segments: u32,
+    /// With multiple segments, deliver frames in presentation order. Otherwise frames arrive as soon as they are decoded, with their frame number
+    pub ordered: bool,
+    /// Maximum number of frames held back by the reorder buffer
+    pub reorder_buffer_frames: u32,
+    /// Convert and scale 8 and 10 bit 4:2:0 frames with the built-in SIMD kernels instead of the generic mdk conversion
+    pub builtin_converter: bool,
+    /// 0: RGBA, or YUV420P if `yuv` is set, 1: RGBA, 2: BGRA, 3: GRAY8 (always uses the built-in converter),
+    /// 4: the planes as decoded, without conversion, scaling or copy, see `start_processing_native`.
+    /// Hardware frames are downloaded as NV12, or P010LE when the stream has more than 8 bits
+    pub output_format: u32,
+    /// Built-in converter only. 0: bilinear, 1: area average (better quality when downscaling a lot)
+    pub scale_filter: u32,
+    /// When > 0, decoded frames go through a queue of this many frames and the callback runs on its own thread,
+    /// so decoding doesn't wait for the callback. 0 calls the callback directly from the decoder thread
+    pub queue_depth: u32,
+    /// What to do when the queue is full. 0: block the decoder, 1: drop the oldest queued frame, 2: drop the new frame
+    pub queue_policy: u32,
+    /// Deliver only frames whose number is a multiple of this, e.g. 3 for every third frame. 0 and 1 deliver every frame
+    pub frame_stride: u32,
+    /// Only decode keyframes. Ignored with a custom decoder, add the decoder's own option to its string instead (e.g. `FFmpeg:skip_frame=nokey`)
+    pub keyframes_only: bool,
+    /// Don't decode frames which no other frame references, they are missing from the output. Frame numbers of the others stay correct.
+    /// Ignored with a custom decoder, like `keyframes_only`
+    pub skip_non_reference: bool,
+    /// Decode at a lower resolution when the output size allows it (FFmpeg `lowres`, BRAW and R3D `scale`). Ignored with a custom decoder
+    pub decoder_scale: bool,
+    /// Built-in converter only. Also converts every frame with the generic mdk conversion and compares the two, see `get_processing_converter_stats`.
+    /// Slows processing down, meant for benchmarks and tests
+    pub compare_converter: bool,
+}
+impl Default for ProcessingOptions {
+    fn default() -> Self {
+        Self {
+            parallel_segments: 1,
+            ordered: true,
+            reorder_buffer_frames: 64,
+            builtin_converter: false,
+            output_format: 0,
+            scale_filter: 0,
+            queue_depth: 0,
+            queue_policy: 0,
+            frame_stride: 1,
+            keyframes_only: false,
+            skip_non_reference: false,
+            decoder_scale: false,
+            compare_converter: false,
+        }
+    }
+}
+
+/// Planes of a decoded frame in the decoder's own pixel format, see `start_processing_native`. Must match `FramePlanes` in ProcessingSession.h
+#[repr(C)]
+#[derive(Debug)]
+pub struct FramePlanes {
+    /// `mdk::PixelFormat` value of the frame, e.g. NV12, YUV420P or P010LE for software decoded video
+    pub format: i32,
+    /// Frame size, i.e. the size of the luma plane
+    pub width: u32,
+    pub height: u32,
+    pub plane_count: u32,
+    data: [*const u8; 4],
+    /// In bytes
+    pub stride: [u32; 4],
+    pub plane_height: [u32; 4],
+}
+impl FramePlanes {
+    /// Rows of plane `index` including the stride padding, empty if there's no such plane
+    pub fn plane(&self, index: usize) -> &[u8] {
+        if index >= self.plane_count.min(4) as usize || self.data[index].is_null() {
+            return &[];
+        }
+        unsafe { std::slice::from_raw_parts(self.data[index], self.stride[index] as usize * self.plane_height[index] as usize) }
+    }
+}
+
+/// Statistics of the processing queue, see `ProcessingOptions::queue_depth`. Must match `FrameQueueStats` in FrameQueue.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct ProcessingQueueStats {
+    pub capacity: u64,
+    /// Frames currently waiting for the callback
+    pub occupancy: u64,
+    pub max_occupancy: u64,
+    /// Frames accepted into the queue
+    pub pushed: u64,
+    /// Frames handed to the callback
+    pub popped: u64,
+    /// Queued frames discarded to make room (drop oldest policy)
+    pub dropped_oldest: u64,
+    /// Incoming frames discarded because the queue was full (drop newest policy)
+    pub dropped_newest: u64,
+    /// Average number of queued frames, sampled on every push
+    pub average_occupancy: f64,
+    /// Total time the decoder spent blocked on a full queue
+    pub producer_wait_ms: f64,
+    /// Total time the callback thread spent waiting for frames
+    pub consumer_wait_ms: f64,
+}
+
+/// Built-in converter against the generic mdk conversion of the same frames, see `ProcessingOptions::compare_converter`.
+/// Must match `ConverterStats` in ProcessingSession.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct ConverterStats {
+    /// Frames converted both ways
+    pub frames: u64,
+    /// Total time of the built-in converter
+    pub builtin_ms: f64,
+    /// Total time of the mdk conversion
+    pub mdk_ms: f64,
+    /// Largest difference of a colour channel between the two outputs
+    pub max_diff: u32,
+    /// Average difference per colour channel
+    pub mean_diff: f64,
+}
+
+/// Statistics of the RAM preview, see `set_frame_cache_budget`. Must match `FrameCacheStats` in FrameCache.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct FrameCacheStats {
+    pub budget_bytes: u64,
+    pub used_bytes: u64,
+    pub frames: u64,
+    /// Frames shown from the cache
+    pub hits: u64,
+    /// Frames looked up but not in the cache
+    pub misses: u64,
+    pub evictions: u64,
+}
+
+/// Buffer of the reverse playback, see `set_reverse_buffer_budget`. Must match `ReversePlaybackStats` in ReversePlayback.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct ReversePlaybackStats {
+    pub budget_bytes: u64,
+    pub used_bytes: u64,
+    pub buffered_frames: u64,
+    /// Forward decodes from a keyframe
+    pub passes: u64,
+    pub decoded_frames: u64,
+    /// Decoded but not kept, they didn't fit in the budget and are decoded again by a later pass
+    pub discarded_frames: u64,
+    /// Requested before the decoder got there
+    pub starved_frames: u64,
+}
+
+/// Passed to the process texture callback as `ptr5` with `backend_id` 5, see `set_vulkan_explicit_sync`. Must match `VulkanFrameInfo` in MDKPlayer.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct VulkanFrameInfo {
+    /// `VkInstance`
+    pub instance: u64,
+    /// `VkQueue` the frame's command buffer is submitted to
+    pub queue: u64,
+    /// Increases by one every rendered frame, e.g. as a timeline semaphore value
+    pub frame_number: u64,
+    pub queue_family_index: u32,
+    /// `VkFormat` of the texture
+    pub format: u32,
+    /// `VkImageLayout` of the texture when the callback is called. A callback which transitions the image stores its final layout here
+    pub layout: u32,
+    /// Resources used in this frame can be reused once the same slot comes back
+    pub frame_slot: u32,
+    pub frames_in_flight: u32,
+}
+
+/// See `get_playback_state`. Must match `PlaybackSnapshot` in PlaybackState.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct PlaybackSnapshot {
+    pub timestamp_ms: f64,
+    pub frame: i64,
+    /// Number of position updates so far, changes whenever the position does
+    pub updates: u64,
+    pub playing: bool,
+    pub buffering: bool,
+}
+
+/// See `HeadlessRenderer::get_stats`. Must match `HeadlessStats` in HeadlessRenderer.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct HeadlessStats {
+    pub rendered_frames: u64,
+    /// Delivered to the texture or pixels callback
+    pub processed_frames: u64,
+    pub last_timestamp_ms: f64,
+    /// Moving average of render and processing time per frame
+    pub frame_ms: f64,
+    /// End of the file
+    pub ended: bool,
+}
+
+/// Render texture allocations, see `get_surface_stats`. Must match `SurfaceStats` in MDKPlayer.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct SurfaceStats {
+    /// Render textures created, including the first one
+    pub reallocations: u64,
+    /// Item size changes shown by scaling the current texture while a resize is in progress
+    pub deferred_resizes: u64,
+    /// Current texture size
+    pub width: u32,
+    pub height: u32,
+}
+
+/// See `get_render_pass_stats`. Must match `RenderPassStats` in MDKPlayer.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct RenderPassStats {
+    pub rendered: u64,
+    /// Window repaints without a new video frame, which didn't touch the video texture
+    pub skipped: u64,
+}
+
+/// See `set_decode_budget`. Must match `DecodeSchedulerStats` in DecodeScheduler.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct DecodeSchedulerStats {
+    /// Items with a loaded video and a decoder of their own
+    pub players: u64,
+    pub full: u64,
+    /// Decoding with non-reference frames skipped and a smaller render surface
+    pub reduced: u64,
+    /// Hidden, offscreen or over `max_active`
+    pub paused: u64,
+    /// On-screen pixels of the items which decode
+    pub visible_pixels: u64,
+}
+
+/// Timing of one stage of the frame pipeline, in microseconds. Must match `StageStats` in PlayerStats.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct StageStats {
+    pub count: u64,
+    pub mean_us: f64,
+    /// Percentiles are the upper bounds of power-of-two buckets
+    pub p50_us: f64,
+    pub p95_us: f64,
+    pub p99_us: f64,
+    pub max_us: f64,
+}
+
+/// See `get_pipeline_stats`. Must match `PipelineStats` in PlayerStats.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct PipelineStats {
+    /// `renderVideo()`, or copying the frame from the frame cache
+    pub render: StageStats,
+    /// Waiting for the GPU readback of the texture, with `set_readback_depth` 1
+    pub readback: StageStats,
+    /// From queuing an asynchronous readback until its pixels are delivered, spans several frames. With `set_readback_depth` > 1
+    pub readback_latency: StageStats,
+    pub process_texture: StageStats,
+    /// `process_pixels` or `process_pixels_in_place` callback
+    pub process_pixels: StageStats,
+    /// Uploading the processed pixels back to the texture
+    pub upload: StageStats,
+    /// Time the position notification waited in the GUI thread's queue
+    pub event_latency: StageStats,
+    /// From issuing a seek until the frame it landed on is rendered
+    pub seek: StageStats,
+    pub rendered_frames: u64,
+    /// Frame numbers skipped during playback, and readbacks dropped because the consumer was too slow
+    pub dropped_frames: u64,
+    pub skipped_passes: u64,
+}
+
+/// Typed media info, see `get_media_summary` and `probe_media`. Must match `MediaSummary` in MediaProbe.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct MediaSummary {
+    pub duration_ms: f64,
+    pub start_time_ms: f64,
+    pub bit_rate: i64,
+    pub size: i64,
+    pub streams: u32,
+    /// First video stream, zero if there's none
+    pub width: u32,
+    pub height: u32,
+    pub rotation: i32,
+    pub frame_rate: f64,
+    pub frames: i64,
+    pub video_duration_ms: f64,
+    pub video_bit_rate: i64,
+    /// First audio stream, zero if there's none
+    pub channels: u32,
+    pub sample_rate: u32,
+    pub audio_duration_ms: f64,
+    pub has_video: bool,
+    pub has_audio: bool,
+}
+
+/// Statistics of the players shared by all video items, see `get_player_pool_stats`. Must match `PlayerPoolStats` in PlayerPool.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct PlayerPoolStats {
+    /// Players in use, idle in the pool, or being reset
+    pub alive: u64,
+    pub idle: u64,
+    pub created: u64,
+    /// Players handed out from the pool instead of being created
+    pub reused: u64,
+    pub destroyed: u64,
+    /// Resident memory of the whole process, 0 if unknown
+    pub resident_bytes: u64,
+    /// Highest resident memory of the process so far, 0 if unknown
+    pub peak_resident_bytes: u64,
+}
+
+/// Options for `generate_thumbnails`. Must match `ThumbnailOptions` in ThumbnailGenerator.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug)]
+pub struct ThumbnailOptions {
+    /// Number of decoder instances, each taking a contiguous part of the timestamps
+    pub workers: u32,
+    /// Use the keyframe nearest to each timestamp instead of decoding up to the exact frame. Much faster with long GOPs
+    pub keyframes_only: bool,
+    /// Keep generated thumbnails in memory for the lifetime of the process
+    pub memory_cache: bool,
+    /// Store generated thumbnails in the cache directory, keyed by the file identity and thumbnail size
+    pub disk_cache: bool,
+}
+impl Default for ThumbnailOptions {
+    fn default() -> Self {
+        Self {
+            workers: 3,
+            keyframes_only: true,
+            memory_cache: true,
+            disk_cache: true,
+        }
+    }
+}
 
 impl MDKPlayerWrapper {
     pub fn play (&mut self) { cpp!(unsafe [self as "MDKPlayerWrapper *"] { self->mdkplayer->play();  }) }
@@ -31,6 +385,13 @@ impl MDKPlayerWrapper {
             self->mdkplayer->seekToTimestamp(timestamp, exact);
         })
     }
+    /// While scrubbing (e.g. a slider is held), seeks are coalesced to the latest one and go to keyframes ahead in the drag direction.
+    /// Ending the scrub seeks exactly to the last requested timestamp
+    pub fn set_scrubbing(&mut self, scrubbing: bool) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", scrubbing as "bool"] {
+            self->mdkplayer->setScrubbing(scrubbing);
+        })
+    }
     pub fn seek_to_frame(&mut self, frame: i64, current_frame: i64, exact: bool) {
         cpp!(unsafe [self as "MDKPlayerWrapper *", frame as "int64_t", current_frame as "int64_t", exact as "bool"] {
             self->mdkplayer->seekToFrame(frame, current_frame, exact);
@@ -47,6 +408,53 @@ impl MDKPlayerWrapper {
             self->mdkplayer->setUrl(url, custom_decoder);
         })
     }
+    pub fn set_next_url(&mut self, url: QUrl, custom_decoder: QString) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", url as "QUrl", custom_decoder as "QString"] {
+            self->mdkplayer->setNextUrl(url, custom_decoder);
+        })
+    }
+    /// Players with sharing enabled which open the same url and decoder decode it once, and each renders the frames at its own size.
+    /// Playback control is shared between them. Applies from the next `set_url`
+    pub fn set_source_sharing(&mut self, enabled: bool) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", enabled as "bool"] {
+            self->mdkplayer->setSourceSharing(enabled);
+        })
+    }
+    /// Number of players showing the same shared source as this one, including it. 0 if it doesn't use a shared source
+    pub fn get_shared_source_views(&self) -> usize {
+        cpp!(unsafe [self as "MDKPlayerWrapper *"] -> usize as "size_t" {
+            return self->mdkplayer->sharedSourceViews();
+        })
+    }
+    /// Items with higher priority get the decode budget first. Default 0
+    pub fn set_decode_priority(&mut self, priority: i32) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", priority as "int"] {
+            self->mdkplayer->setDecodePriority(priority);
+        })
+    }
+    /// Process-wide decode budget of the video items. Once a limit is set, hidden and offscreen items are paused. Of the visible ones,
+    /// ordered by priority and on-screen size, only `max_active` decode and the rest is paused. Items which don't fit
+    /// in `pixel_budget` on-screen pixels skip non-reference frames and render at a lower resolution. 0 disables a limit,
+    /// with both disabled (the default) every item decodes in full. Unmuted items with audio are never paused
+    pub fn set_decode_budget(max_active: u32, pixel_budget: u64) {
+        cpp!(unsafe [max_active as "uint32_t", pixel_budget as "uint64_t"] {
+            DecodeScheduler::instance().setBudget(max_active, pixel_budget);
+        })
+    }
+    pub fn get_decode_scheduler_stats() -> DecodeSchedulerStats {
+        let mut stats = DecodeSchedulerStats::default();
+        let stats_ptr = &mut stats as *mut DecodeSchedulerStats;
+        cpp!(unsafe [stats_ptr as "DecodeSchedulerStats *"] {
+            *stats_ptr = DecodeScheduler::instance().stats();
+        });
+        stats
+    }
+    /// Number of decoders currently shared by players with source sharing enabled
+    pub fn active_shared_sources() -> usize {
+        cpp!(unsafe [] -> usize as "size_t" {
+            return SharedSource::activeCount();
+        })
+    }
 
     pub fn set_property(&mut self, key: QString, value: QString) {
         cpp!(unsafe [self as "MDKPlayerWrapper *", key as "QString", value as "QString"] {
@@ -122,6 +530,209 @@ impl MDKPlayerWrapper {
         })
     }
 
+    /// On Vulkan the process texture callback normally runs after waiting for the GPU, with `backend_id` 4.
+    /// With explicit sync it runs without the wait and gets `backend_id` 5: `ptr1` is the `VkImage`, `ptr2` the `VkDevice`,
+    /// `ptr3` the frame's `VkCommandBuffer` (recording, outside of a render pass), `ptr4` the `VkPhysicalDevice` and `ptr5` a `*mut VulkanFrameInfo`.
+    /// The callback records its work into the command buffer, which the scene graph submits after the video's render pass
+    pub fn set_vulkan_explicit_sync(&mut self, enabled: bool) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", enabled as "bool"] {
+            self->mdkplayer->setVulkanExplicitSync(enabled);
+        })
+    }
+    pub fn set_readback_depth(&mut self, depth: i32) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", depth as "int"] {
+            self->mdkplayer->setReadbackDepth(depth);
+        })
+    }
+    /// Index every frame of local files, so frame numbers and `seek_to_frame` are exact with variable frame rate.
+    /// A stored index is always used, `scan` decides whether files without one are scanned in the background
+    pub fn set_frame_indexing(&mut self, scan: bool) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", scan as "bool"] {
+            self->mdkplayer->setFrameIndexing(scan);
+        })
+    }
+    /// Frames decoded by an exact seek to `frame`, starting from the preceding keyframe. `None` until the frame index is ready
+    pub fn get_seek_cost(&self, frame: i64) -> Option<i64> {
+        let cost = cpp!(unsafe [self as "MDKPlayerWrapper *", frame as "int64_t"] -> i64 as "int64_t" {
+            auto index = self->mdkplayer->frameIndex();
+            return index? index->seekCost(frame) : -1;
+        });
+        if cost >= 0 { Some(cost) } else { None }
+    }
+    /// Keep up to `bytes` of rendered frames of the playback range on the GPU, so looping and stepping within the range doesn't decode.
+    /// Playback from the cache has no audio. 0 disables the cache
+    pub fn set_frame_cache_budget(&mut self, bytes: u64) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", bytes as "uint64_t"] {
+            self->mdkplayer->setFrameCacheBudget(bytes);
+        })
+    }
+    pub fn get_frame_cache_stats(&self) -> FrameCacheStats {
+        let mut stats = FrameCacheStats::default();
+        let stats_ptr = &mut stats as *mut FrameCacheStats;
+        cpp!(unsafe [self as "MDKPlayerWrapper *", stats_ptr as "FrameCacheStats *"] {
+            *stats_ptr = self->mdkplayer->frameCacheStats();
+        });
+        stats
+    }
+    /// Negative playback rates decode each GOP forward into a buffer of at most `bytes` and show it backwards,
+    /// while the previous GOP is decoded. Applies from the next time reverse playback starts. Default 512 MB
+    pub fn set_reverse_buffer_budget(&mut self, bytes: u64) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", bytes as "uint64_t"] {
+            self->mdkplayer->setReverseBufferBudget(bytes);
+        })
+    }
+    pub fn get_reverse_playback_stats(&self) -> ReversePlaybackStats {
+        let mut stats = ReversePlaybackStats::default();
+        let stats_ptr = &mut stats as *mut ReversePlaybackStats;
+        cpp!(unsafe [self as "MDKPlayerWrapper *", stats_ptr as "ReversePlaybackStats *"] {
+            *stats_ptr = self->mdkplayer->reversePlaybackStats();
+        });
+        stats
+    }
+    /// While the item is being resized the current texture is scaled, it's reallocated once the size settles or changes by more than 128 px
+    pub fn get_surface_stats(&self) -> SurfaceStats {
+        let mut stats = SurfaceStats::default();
+        let stats_ptr = &mut stats as *mut SurfaceStats;
+        cpp!(unsafe [self as "MDKPlayerWrapper *", stats_ptr as "SurfaceStats *"] {
+            *stats_ptr = self->mdkplayer->surfaceStats();
+        });
+        stats
+    }
+    pub fn get_pipeline_stats(&self) -> PipelineStats {
+        let mut stats = PipelineStats::default();
+        let stats_ptr = &mut stats as *mut PipelineStats;
+        cpp!(unsafe [self as "MDKPlayerWrapper *", stats_ptr as "PipelineStats *"] {
+            *stats_ptr = self->mdkplayer->pipelineStats().snapshot();
+        });
+        stats
+    }
+    /// Latest position and state, read without locking and without waiting for the item's notifications. Can be called from any thread
+    pub fn get_playback_state(&self) -> PlaybackSnapshot {
+        let mut state = PlaybackSnapshot::default();
+        let state_ptr = &mut state as *mut PlaybackSnapshot;
+        cpp!(unsafe [self as "MDKPlayerWrapper *", state_ptr as "PlaybackSnapshot *"] {
+            *state_ptr = self->mdkplayer->playbackState();
+        });
+        state
+    }
+    pub fn get_playback_state_json(&self) -> QJsonObject {
+        cpp!(unsafe [self as "MDKPlayerWrapper *"] -> QJsonObject as "QJsonObject" {
+            const auto state = self->mdkplayer->playbackState();
+            QJsonObject obj;
+            obj.insert("timestamp", state.timestampMs);
+            obj.insert("frame",     qint64(state.frame));
+            obj.insert("updates",   qint64(state.updates));
+            obj.insert("playing",   state.playing);
+            obj.insert("buffering", state.buffering);
+            return obj;
+        })
+    }
+    /// `timestamp`/`currentFrame` notifications of the item are coalesced to at most one per `ms`, e.g. 100 for 10 Hz.
+    /// 0 (the default) delivers the latest position once per event loop iteration
+    pub fn set_notify_interval(&mut self, ms: u32) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", ms as "uint32_t"] {
+            self->mdkplayer->setNotifyInterval(ms);
+        })
+    }
+    /// Same as `get_pipeline_stats`, as a JSON object with a key per stage
+    pub fn get_pipeline_stats_json(&self) -> QJsonObject {
+        cpp!(unsafe [self as "MDKPlayerWrapper *"] -> QJsonObject as "QJsonObject" {
+            return self->mdkplayer->pipelineStats().toJson();
+        })
+    }
+    pub fn reset_pipeline_stats(&mut self) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *"] {
+            self->mdkplayer->pipelineStats().reset();
+        })
+    }
+    /// Records the pipeline stages of the last `window_ms` for `write_trace`. 0 stops recording
+    pub fn start_trace(&mut self, window_ms: u32) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", window_ms as "uint32_t"] {
+            self->mdkplayer->pipelineStats().startTrace(window_ms);
+        })
+    }
+    /// Writes the recorded stages as a Chrome trace, which can be opened in chrome://tracing or Perfetto
+    pub fn write_trace(&self, path: &str) -> bool {
+        let path = QString::from(path);
+        cpp!(unsafe [self as "MDKPlayerWrapper *", path as "QString"] -> bool as "bool" {
+            return self->mdkplayer->pipelineStats().writeTrace(path);
+        })
+    }
+    /// The video is only rendered when the decoder has a new frame, after seeks and after `force_redraw`
+    pub fn get_render_pass_stats(&self) -> RenderPassStats {
+        let mut stats = RenderPassStats::default();
+        let stats_ptr = &mut stats as *mut RenderPassStats;
+        cpp!(unsafe [self as "MDKPlayerWrapper *", stats_ptr as "RenderPassStats *"] {
+            *stats_ptr = self->mdkplayer->renderPassStats();
+        });
+        stats
+    }
+    /// Returns (frames, milliseconds) between queueing a readback and delivering it to the pixel processing callback
+    pub fn get_readback_latency(&self) -> (u32, f64) {
+        let frames = cpp!(unsafe [self as "MDKPlayerWrapper *"] -> u32 as "uint32_t" {
+            return self->mdkplayer->readbackLatencyFrames();
+        });
+        let ms = cpp!(unsafe [self as "MDKPlayerWrapper *"] -> f64 as "double" {
+            return self->mdkplayer->readbackLatencyMs();
+        });
+        (frames, ms)
+    }
+    pub fn get_readback_dropped_frames(&self) -> u64 {
+        cpp!(unsafe [self as "MDKPlayerWrapper *"] -> u64 as "uint64_t" {
+            return self->mdkplayer->readbackDroppedFrames();
+        })
+    }
+
+    /// Region of the image returned from the next pixel processing callback which changed since the previous one.
+    /// Only this part gets uploaded to the GPU
+    pub fn set_processed_dirty_rect(&mut self, x: i32, y: i32, width: i32, height: i32) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", x as "int", y as "int", width as "int", height as "int"] {
+            self->mdkplayer->setProcessedDirtyRect(QRect(x, y, width, height));
+        })
+    }
+
+    /// Media info of the loaded file, `None` until it's loaded
+    pub fn get_media_summary(&self) -> Option<MediaSummary> {
+        let mut summary = MediaSummary::default();
+        let summary_ptr = &mut summary as *mut MediaSummary;
+        let ok = cpp!(unsafe [self as "MDKPlayerWrapper *", summary_ptr as "MediaSummary *"] -> bool as "bool" {
+            auto info = self->mdkplayer->mediaInfo();
+            if (!info) return false;
+            *summary_ptr = info->summary;
+            return true;
+        });
+        if ok { Some(summary) } else { None }
+    }
+
+    /// Media info of any file without loading it into a player. Blocks while the file is probed, unless it's in the probe cache.
+    /// Results are cached in memory and in the cache directory, keyed by the file identity
+    pub fn probe_media(url: QString) -> Option<MediaSummary> {
+        let mut summary = MediaSummary::default();
+        let summary_ptr = &mut summary as *mut MediaSummary;
+        let ok = cpp!(unsafe [url as "QString", summary_ptr as "MediaSummary *"] -> bool as "bool" {
+            auto info = MediaProbe::probe(url.toStdString());
+            if (!info) return false;
+            *summary_ptr = info->summary;
+            return true;
+        });
+        if ok { Some(summary) } else { None }
+    }
+
+    /// Maximum number of idle players kept for reuse when the url of an item changes. 0 disables reuse, default 2
+    pub fn set_player_pool_size(count: usize) {
+        cpp!(unsafe [count as "size_t"] {
+            PlayerPool::instance().setMaxIdle(count);
+        })
+    }
+    pub fn get_player_pool_stats() -> PlayerPoolStats {
+        let mut stats = PlayerPoolStats::default();
+        let stats_ptr = &mut stats as *mut PlayerPoolStats;
+        cpp!(unsafe [stats_ptr as "PlayerPoolStats *"] {
+            *stats_ptr = PlayerPool::instance().stats();
+        });
+        stats
+    }
+
     pub fn set_global_option(key: QString, val: QString) {
         cpp!(unsafe [key as "QString", val as "QString"] {
             SetGlobalOption(qUtf8Printable(key), qUtf8Printable(val));
@@ -152,6 +763,11 @@ impl MDKPlayerWrapper {
     }
 
     pub fn start_processing<F: FnMut(i32, f64, u32, u32, u32, u32, f64, f64, u32, &mut [u8]) -> bool + 'static>(&mut self, id: usize, width: usize, height: usize, custom_decoder: &str, yuv: bool, ranges_ms: Vec<(usize, usize)>, cb: F) {
+        self.start_processing_with_options(id, width, height, custom_decoder, yuv, ranges_ms, ProcessingOptions::default(), cb)
+    }
+    /// With `parallel_segments` > 1 the callback is still never called concurrently, but it may be called from different threads.
+    /// With `queue_depth` > 0 it's always called from the session's own thread
+    pub fn start_processing_with_options<F: FnMut(i32, f64, u32, u32, u32, u32, f64, f64, u32, &mut [u8]) -> bool + 'static>(&mut self, id: usize, width: usize, height: usize, custom_decoder: &str, yuv: bool, ranges_ms: Vec<(usize, usize)>, options: ProcessingOptions, cb: F) {
 
         // assert!(to_ms > from_ms);
         let func: Box<dyn FnMut(i32, f64, u32, u32, u32, u32, f64, f64, u32, &mut [u8]) -> bool> = Box::new(cb);
@@ -162,9 +778,11 @@ impl MDKPlayerWrapper {
         let custom_decoder = std::ffi::CString::new(custom_decoder).unwrap();
         let custom_decoder = custom_decoder.as_ptr();
 
-        cpp!(unsafe [self as "MDKPlayerWrapper *", id as "uint64_t", width as "uint64_t", height as "uint64_t", yuv as "bool", custom_decoder as "const char *", ranges_ptr as "std::pair<uint64_t, uint64_t>*", ranges_len as "uint64_t", cb_ptr as "TraitObject2"] {
+        let options_ptr = &options as *const ProcessingOptions;
+
+        cpp!(unsafe [self as "MDKPlayerWrapper *", id as "uint64_t", width as "uint64_t", height as "uint64_t", yuv as "bool", custom_decoder as "const char *", ranges_ptr as "std::pair<uint64_t, uint64_t>*", ranges_len as "uint64_t", options_ptr as "const ProcessingOptions *", cb_ptr as "TraitObject2"] {
             std::vector<std::pair<uint64_t, uint64_t>> ranges(ranges_ptr, ranges_ptr + ranges_len);
-            self->mdkplayer->initProcessingPlayer(id, width, height, yuv, custom_decoder, ranges, [cb_ptr](int frame, double timestamp, int width, int height, int org_width, int org_height, double fps, double duration_ms, uint32_t frame_count, const uint8_t *bits, uint64_t bitsSize) -> bool {
+            self->mdkplayer->initProcessingPlayer(id, width, height, yuv, custom_decoder, ranges, [cb_ptr](int frame, double timestamp, int width, int height, int org_width, int org_height, double fps, double duration_ms, uint32_t frame_count, const uint8_t *bits, uint64_t bitsSize, const FramePlanes *) -> bool {
                 return rust!(Rust_MDKPlayer_videoProcess [cb_ptr: *mut dyn FnMut(i32, f64, u32, u32, u32, u32, f64, f64, u32, &mut [u8]) -> bool as "TraitObject2", frame: i32 as "int", timestamp: f64 as "double", width: u32 as "uint32_t", height: u32 as "uint32_t", org_width: u32 as "uint32_t", org_height: u32 as "uint32_t", fps: f64 as "double", duration_ms: f64 as "double", frame_count: u32 as "uint32_t", bitsSize: u64 as "uint64_t", bits: *mut u8 as "const uint8_t *"] -> bool as "bool" {
                     let pixels: &mut [u8] = if bits.is_null() || bitsSize == 0 {
                         &mut []
@@ -180,7 +798,36 @@ impl MDKPlayerWrapper {
                     }
                     ok
                 });
-            });
+            }, *options_ptr);
+        })
+    }
+    /// Delivers the decoded planes to the callback without any conversion or copy: `(frame, timestamp_ms, org_width, org_height, fps, duration_ms, frame_count, planes)`.
+    /// The planes are only valid during the callback. `options.output_format` is ignored, the callback gets frame -1 once at the end
+    pub fn start_processing_native<F: FnMut(i32, f64, u32, u32, f64, f64, u32, Option<&FramePlanes>) -> bool + 'static>(&mut self, id: usize, custom_decoder: &str, ranges_ms: Vec<(usize, usize)>, options: ProcessingOptions, cb: F) {
+        let func: Box<dyn FnMut(i32, f64, u32, u32, f64, f64, u32, Option<&FramePlanes>) -> bool> = Box::new(cb);
+
+        let cb_ptr = Box::into_raw(func);
+        let ranges_ptr = ranges_ms.as_ptr();
+        let ranges_len = ranges_ms.len();
+        let custom_decoder = std::ffi::CString::new(custom_decoder).unwrap();
+        let custom_decoder = custom_decoder.as_ptr();
+
+        let options = ProcessingOptions { output_format: 4, ..options };
+        let options_ptr = &options as *const ProcessingOptions;
+
+        cpp!(unsafe [self as "MDKPlayerWrapper *", id as "uint64_t", custom_decoder as "const char *", ranges_ptr as "std::pair<uint64_t, uint64_t>*", ranges_len as "uint64_t", options_ptr as "const ProcessingOptions *", cb_ptr as "TraitObject2"] {
+            std::vector<std::pair<uint64_t, uint64_t>> ranges(ranges_ptr, ranges_ptr + ranges_len);
+            self->mdkplayer->initProcessingPlayer(id, 0, 0, false, custom_decoder, ranges, [cb_ptr](int frame, double timestamp, int, int, int org_width, int org_height, double fps, double duration_ms, uint32_t frame_count, const uint8_t *, uint64_t, const FramePlanes *planes) -> bool {
+                return rust!(Rust_MDKPlayer_videoProcessNative [cb_ptr: *mut dyn FnMut(i32, f64, u32, u32, f64, f64, u32, Option<&FramePlanes>) -> bool as "TraitObject2", frame: i32 as "int", timestamp: f64 as "double", org_width: u32 as "uint32_t", org_height: u32 as "uint32_t", fps: f64 as "double", duration_ms: f64 as "double", frame_count: u32 as "uint32_t", planes: *const FramePlanes as "const FramePlanes *"] -> bool as "bool" {
+                    let mut cb = unsafe { Box::from_raw(cb_ptr) };
+
+                    let ok = cb(frame, timestamp, org_width, org_height, fps, duration_ms, frame_count, unsafe { planes.as_ref() });
+                    if frame >= 0 {
+                        let _ = Box::into_raw(cb); // leak again so it doesn't get deleted here
+                    }
+                    ok
+                });
+            }, *options_ptr);
         })
     }
     pub fn stop_processing(&mut self, id: usize) {
@@ -188,4 +835,164 @@ impl MDKPlayerWrapper {
             self->mdkplayer->stopProcessingPlayer(id);
         })
     }
+    /// Generates RGBA thumbnails of the current file, either at `timestamps_ms` or at `count` points evenly spaced over the duration.
+    /// `height` 0 keeps the aspect ratio. The callback gets `(index, requested_ms, timestamp_ms, width, height, pixels, cached_file)`
+    /// for each thumbnail as soon as it's ready, in no particular order, and index -1 once at the end
+    pub fn generate_thumbnails<F: FnMut(i32, f64, f64, u32, u32, &[u8], &str) + 'static>(&mut self, id: usize, timestamps_ms: Vec<f64>, count: u32, width: u32, height: u32, options: ThumbnailOptions, cb: F) {
+        let func: Box<dyn FnMut(i32, f64, f64, u32, u32, &[u8], &str)> = Box::new(cb);
+        let cb_ptr = Box::into_raw(func);
+
+        let timestamps_ptr = timestamps_ms.as_ptr();
+        let timestamps_len = timestamps_ms.len();
+        let options_ptr = &options as *const ThumbnailOptions;
+
+        #[cfg(any(target_os = "android", all(target_os = "linux", target_arch = "aarch64")))]
+        type TextPtr = *const u8;
+        #[cfg(not(any(target_os = "android", all(target_os = "linux", target_arch = "aarch64"))))]
+        type TextPtr = *mut i8;
+
+        cpp!(unsafe [self as "MDKPlayerWrapper *", id as "uint64_t", timestamps_ptr as "const double *", timestamps_len as "uint64_t", count as "uint32_t", width as "uint32_t", height as "uint32_t", options_ptr as "const ThumbnailOptions *", cb_ptr as "TraitObject2"] {
+            std::vector<double> timestamps(timestamps_ptr, timestamps_ptr + timestamps_len);
+            self->mdkplayer->generateThumbnails(id, timestamps, count, width, height, [cb_ptr](int32_t index, double requested_ms, double timestamp_ms, uint32_t width, uint32_t height, const uint8_t *bits, uint64_t bitsSize, const std::string &cachedFile) {
+                const char *file = cachedFile.c_str();
+                rust!(Rust_MDKPlayer_thumbnail [cb_ptr: *mut dyn FnMut(i32, f64, f64, u32, u32, &[u8], &str) as "TraitObject2", index: i32 as "int32_t", requested_ms: f64 as "double", timestamp_ms: f64 as "double", width: u32 as "uint32_t", height: u32 as "uint32_t", bitsSize: u64 as "uint64_t", bits: *const u8 as "const uint8_t *", file: TextPtr as "const char *"] {
+                    let pixels: &[u8] = if bits.is_null() || bitsSize == 0 {
+                        &[]
+                    } else {
+                        unsafe { std::slice::from_raw_parts(bits, bitsSize as usize) }
+                    };
+                    let file = unsafe { std::ffi::CStr::from_ptr(file) }.to_string_lossy();
+
+                    let mut cb = unsafe { Box::from_raw(cb_ptr) };
+
+                    cb(index, requested_ms, timestamp_ms, width, height, pixels, &file);
+                    if index >= 0 {
+                        let _ = Box::into_raw(cb); // leak again so it doesn't get deleted here
+                    }
+                });
+            }, *options_ptr);
+        })
+    }
+    pub fn stop_thumbnails(&mut self, id: usize) {
+        cpp!(unsafe [self as "MDKPlayerWrapper *", id as "uint64_t"] {
+            self->mdkplayer->stopThumbnails(id);
+        })
+    }
+
+    /// Returns `None` if there's no such session or it doesn't use a queue
+    pub fn get_processing_queue_stats(&self, id: usize) -> Option<ProcessingQueueStats> {
+        let mut stats = ProcessingQueueStats::default();
+        let stats_ptr = &mut stats as *mut ProcessingQueueStats;
+        let ok = cpp!(unsafe [self as "MDKPlayerWrapper *", id as "uint64_t", stats_ptr as "FrameQueueStats *"] -> bool as "bool" {
+            return self->mdkplayer->processingQueueStats(id, *stats_ptr);
+        });
+        if ok { Some(stats) } else { None }
+    }
+
+    /// Returns `None` if there's no such session or it doesn't compare the converters
+    pub fn get_processing_converter_stats(&self, id: usize) -> Option<ConverterStats> {
+        let mut stats = ConverterStats::default();
+        let stats_ptr = &mut stats as *mut ConverterStats;
+        let ok = cpp!(unsafe [self as "MDKPlayerWrapper *", id as "uint64_t", stats_ptr as "ConverterStats *"] -> bool as "bool" {
+            return self->mdkplayer->processingConverterStats(id, *stats_ptr);
+        });
+        if ok { Some(stats) } else { None }
+    }
+}
+
+/// Renders a file into an offscreen texture at a fixed size, without a window, QML item or scene graph, e.g. for exports and CI jobs.
+/// It uses its own OpenGL context on an offscreen surface (software GL works) and a render thread, which calls the processing callbacks.
+/// Requires a `QGuiApplication`, `start` and `stop` must be called on its thread
+impl HeadlessRenderer {
+    /// With `stepping` every frame is rendered and processed once, the decoder waits for the callbacks. Otherwise frames follow the playback clock
+    /// and the ones the renderer didn't get to are dropped. The first frame is rendered right away, `play` starts playback.
+    /// Returns false if OpenGL isn't available
+    pub fn start(&mut self, url: QUrl, width: u32, height: u32, stepping: bool) -> bool {
+        cpp!(unsafe [self as "HeadlessRendererWrapper *", url as "QUrl", width as "uint32_t", height as "uint32_t", stepping as "bool"] -> bool as "bool" {
+            const QString path = url.scheme() == "file"? url.toLocalFile() : QString(url.toEncoded());
+            return self->renderer->start(path.toStdString(), QSize(int(width), int(height)), stepping);
+        })
+    }
+    pub fn stop(&mut self) {
+        cpp!(unsafe [self as "HeadlessRendererWrapper *"] {
+            self->renderer->stop();
+        })
+    }
+    pub fn play(&mut self) {
+        cpp!(unsafe [self as "HeadlessRendererWrapper *"] {
+            self->renderer->play();
+        })
+    }
+    pub fn pause(&mut self) {
+        cpp!(unsafe [self as "HeadlessRendererWrapper *"] {
+            self->renderer->pause();
+        })
+    }
+    pub fn seek(&mut self, timestamp_ms: f64) {
+        cpp!(unsafe [self as "HeadlessRendererWrapper *", timestamp_ms as "double"] {
+            self->renderer->seek(timestamp_ms);
+        })
+    }
+
+    /// `(frame, timestamp_ms, width, height, backend_id, ptr1, ptr2, ptr3, ptr4, ptr5)` as in `MDKVideoItem::onProcessTexture`. On OpenGL `backend_id` is 1,
+    /// `ptr1` the texture and `ptr2` the QOpenGLContext, current during the call. Returning false falls back to the pixels callback
+    pub fn set_process_texture<F: FnMut(u32, f64, u32, u32, u32, u64, u64, u64, u64, u64) -> bool + 'static>(&mut self, cb: F) {
+        let func: Box<dyn FnMut(u32, f64, u32, u32, u32, u64, u64, u64, u64, u64) -> bool> = Box::new(cb);
+        let cb_ptr = Box::into_raw(func);
+
+        cpp!(unsafe [self as "HeadlessRendererWrapper *", cb_ptr as "TraitObject2"] {
+            // The closure is dropped when the renderer releases the callback
+            auto owner = std::shared_ptr<TraitObject2>(new TraitObject2(cb_ptr), [](TraitObject2 *p) {
+                TraitObject2 cb_ptr = *p;
+                delete p;
+                rust!(Rust_HeadlessRenderer_dropProcessTexture [cb_ptr: *mut dyn FnMut(u32, f64, u32, u32, u32, u64, u64, u64, u64, u64) -> bool as "TraitObject2"] {
+                    let _ = unsafe { Box::from_raw(cb_ptr) };
+                });
+            });
+            self->renderer->setProcessTextureCallback([owner](QQuickItem *, uint32_t frame, double timestamp, uint32_t width, uint32_t height, uint32_t backend_id, uint64_t ptr1, uint64_t ptr2, uint64_t ptr3, uint64_t ptr4, uint64_t ptr5) -> bool {
+                TraitObject2 cb_ptr = *owner;
+                return rust!(Rust_HeadlessRenderer_processTexture [cb_ptr: *mut dyn FnMut(u32, f64, u32, u32, u32, u64, u64, u64, u64, u64) -> bool as "TraitObject2", frame: u32 as "uint32_t", timestamp: f64 as "double", width: u32 as "uint32_t", height: u32 as "uint32_t", backend_id: u32 as "uint32_t", ptr1: u64 as "uint64_t", ptr2: u64 as "uint64_t", ptr3: u64 as "uint64_t", ptr4: u64 as "uint64_t", ptr5: u64 as "uint64_t"] -> bool as "bool" {
+                    let cb = unsafe { &mut *cb_ptr };
+                    cb(frame, timestamp, width, height, backend_id, ptr1, ptr2, ptr3, ptr4, ptr5)
+                });
+            });
+        })
+    }
+    /// `(frame, timestamp_ms, width, height, stride, pixels)`, RGBA with the top row first, valid only during the call
+    pub fn set_process_pixels<F: FnMut(u32, f64, u32, u32, u32, &[u8]) + 'static>(&mut self, cb: F) {
+        let func: Box<dyn FnMut(u32, f64, u32, u32, u32, &[u8])> = Box::new(cb);
+        let cb_ptr = Box::into_raw(func);
+
+        cpp!(unsafe [self as "HeadlessRendererWrapper *", cb_ptr as "TraitObject2"] {
+            auto owner = std::shared_ptr<TraitObject2>(new TraitObject2(cb_ptr), [](TraitObject2 *p) {
+                TraitObject2 cb_ptr = *p;
+                delete p;
+                rust!(Rust_HeadlessRenderer_dropProcessPixels [cb_ptr: *mut dyn FnMut(u32, f64, u32, u32, u32, &[u8]) as "TraitObject2"] {
+                    let _ = unsafe { Box::from_raw(cb_ptr) };
+                });
+            });
+            self->renderer->setProcessPixelsInPlaceCallback([owner](QQuickItem *, uint32_t frame, double timestamp, uint32_t width, uint32_t height, uint32_t stride, uint8_t *bits, uint64_t bitsSize) -> bool {
+                TraitObject2 cb_ptr = *owner;
+                rust!(Rust_HeadlessRenderer_processPixels [cb_ptr: *mut dyn FnMut(u32, f64, u32, u32, u32, &[u8]) as "TraitObject2", frame: u32 as "uint32_t", timestamp: f64 as "double", width: u32 as "uint32_t", height: u32 as "uint32_t", stride: u32 as "uint32_t", bitsSize: u64 as "uint64_t", bits: *const u8 as "const uint8_t *"] {
+                    let pixels: &[u8] = if bits.is_null() || bitsSize == 0 {
+                        &[]
+                    } else {
+                        unsafe { std::slice::from_raw_parts(bits, bitsSize as usize) }
+                    };
+                    let cb = unsafe { &mut *cb_ptr };
+                    cb(frame, timestamp, width, height, stride, pixels);
+                });
+                return true;
+            });
+        })
+    }
+
+    pub fn get_stats(&self) -> HeadlessStats {
+        let mut stats = HeadlessStats::default();
+        let stats_ptr = &mut stats as *mut HeadlessStats;
+        cpp!(unsafe [self as "HeadlessRendererWrapper *", stats_ptr as "HeadlessStats *"] {
+            *stats_ptr = self->renderer->stats();
+        });
+        stats
+    }
 }